@@ -0,0 +1,531 @@
+#pragma once
+
+#ifndef _ATOMIC_HASH_MAP_H
+#define _ATOMIC_HASH_MAP_H
+
+#include "common.h"
+#include "HarrisMichaelList.h"
+
+#include <functional>
+
+namespace peloton {
+namespace index {
+
+/*
+ * class AtomicHashMap - A lock-free resizable hash map built on split-ordered
+ *                       lists
+ *
+ * All key-value pairs live in one sorted lock-free linked list, which uses
+ * the logical delete mark and the search loop of HarrisMichaelList. Nodes
+ * are sorted by the bit-reversed hash value of their keys, such that all
+ * nodes in a bucket form a consecutive range of the list, and splitting a
+ * bucket after the bucket array doubles only requires inserting a dummy
+ * node at the split point rather than moving nodes between buckets. The bucket array only
+ * keeps shortcuts into the list (i.e. pointers to dummy nodes), and is
+ * replaced by a larger copy when the load factor is exceeded. Buckets in
+ * the new array are initialized lazily on their first access
+ *
+ * Nodes unlinked from the list and bucket arrays replaced by a larger one
+ * are handed to the epoch manager given in the constructor. Just like
+ * AtomicStack, the caller is responsible for maintaining epoch counters
+ * outside each call (i.e. AnnounceEnter() or JoinEpoch() / LeaveEpoch())
+ *
+ * The EM is passed as a template template argument, and is instanciated
+ * with GarbageType which is the common base class of all objects this map
+ * retires. Both KeyType and ValueType must be default constructable since
+ * dummy nodes also carry a key and a value
+ */
+template <typename KeyType,
+          typename ValueType,
+          template <typename> class EMTemplate,
+          typename KeyHashFunc = std::hash<KeyType>,
+          typename KeyComparator = std::less<KeyType>>
+class AtomicHashMap {
+ public:
+  /*
+   * class GarbageType - Base class of all objects retired through the EM
+   *
+   * The EM frees garbage using operator delete on a pointer to this type,
+   * so the virtual destructor dispatches to nodes and bucket arrays
+   */
+  class GarbageType {
+   public:
+    virtual ~GarbageType() {}
+  };
+
+  // This is the type of EM the caller should construct and pass to us
+  using EMType = EMTemplate<GarbageType>;
+
+  // Average number of items per bucket before the bucket array doubles
+  static constexpr uint64_t MAX_LOAD_FACTOR = 2;
+
+ private:
+
+  /*
+   * class Node - List node that is either a dummy node starting a bucket
+   *              or a node holding a key value pair
+   *
+   * The lowest bit of next_p is the logical delete mark of this node. Once
+   * it is set the node must not be modified, and will be unlinked by
+   * whichever thread sees it first
+   */
+  class Node : public GarbageType {
+   public:
+    // Split order key: bit-reversed hash; dummy nodes have the lowest bit
+    // being 0 and regular nodes have it being 1
+    uint64_t so_key;
+    KeyType key;
+    ValueType value;
+
+    std::atomic<Node *> next_p;
+
+    /*
+     * Constructor - Construct a regular node
+     */
+    Node(uint64_t p_so_key, const KeyType &p_key, const ValueType &p_value) :
+      so_key{p_so_key},
+      key{p_key},
+      value{p_value},
+      next_p{nullptr}
+    {}
+
+    /*
+     * Constructor - Construct a dummy node
+     */
+    Node(uint64_t p_so_key) :
+      so_key{p_so_key},
+      key{},
+      value{},
+      next_p{nullptr}
+    {}
+  };
+
+  /*
+   * class BucketArray - An array of pointers to dummy nodes
+   *
+   * Size of the array is always a power of 2. A nullptr entry means the
+   * bucket has not been initialized yet
+   */
+  class BucketArray : public GarbageType {
+   public:
+    uint64_t size;
+    std::atomic<Node *> *bucket_list_p;
+
+    /*
+     * Constructor - Allocates the array and sets all entries to nullptr
+     */
+    BucketArray(uint64_t p_size) :
+      size{p_size} {
+      bucket_list_p = new std::atomic<Node *>[size];
+
+      for(uint64_t i = 0;i < size;i++) {
+        bucket_list_p[i].store(nullptr);
+      }
+
+      return;
+    }
+
+    /*
+     * Destructor - Frees the array but not the nodes
+     */
+    ~BucketArray() {
+      delete[] bucket_list_p;
+
+      return;
+    }
+  };
+
+  using MarkedList = HarrisMichaelList<Node>;
+  using Cursor = typename MarkedList::Cursor;
+
+  // This is set on the hash value before bit reversal, such that regular
+  // nodes always have the lowest bit set after reversal
+  static constexpr uint64_t REGULAR_KEY_BIT = 0x8000000000000000UL;
+
+  // The current bucket array; replaced with CAS on growth
+  std::atomic<BucketArray *> bucket_array_p;
+
+  // Dummy node of bucket 0 which is also the head of the entire list
+  Node *head_p;
+
+  // Number of key value pairs in the map
+  std::atomic<uint64_t> item_count;
+
+  // All unlinked nodes and old bucket arrays go here
+  EMType *em_p;
+
+  KeyHashFunc key_hash_obj;
+  KeyComparator key_cmp_obj;
+
+ private:
+
+  /*
+   * GetLink() - Returns the next pointer of a node
+   */
+  static inline std::atomic<Node *> &GetLink(Node *node_p) {
+    return node_p->next_p;
+  }
+
+  /*
+   * ReverseBits() - Reverses bits in a 64 bit integer
+   */
+  static inline uint64_t ReverseBits(uint64_t x) {
+    x = ((x >> 1) & 0x5555555555555555UL) | ((x & 0x5555555555555555UL) << 1);
+    x = ((x >> 2) & 0x3333333333333333UL) | ((x & 0x3333333333333333UL) << 2);
+    x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FUL) | ((x & 0x0F0F0F0F0F0F0F0FUL) << 4);
+
+    // Reversing bytes is a single instruction
+    return __builtin_bswap64(x);
+  }
+
+  /*
+   * GetRegularKey() / GetDummyKey() - Computes split order keys
+   */
+  static inline uint64_t GetRegularKey(uint64_t hash) {
+    return ReverseBits(hash | REGULAR_KEY_BIT);
+  }
+
+  static inline uint64_t GetDummyKey(uint64_t bucket) {
+    return ReverseBits(bucket);
+  }
+
+  /*
+   * GetParentBucket() - Returns the bucket that a given bucket is split from
+   *
+   * This is done by clearing the highest 1 bit of the bucket index. Bucket 0
+   * does not have a parent and should not be passed in
+   */
+  static inline uint64_t GetParentBucket(uint64_t bucket) {
+    assert(bucket != 0UL);
+
+    return bucket & ~(0x1UL << (63 - __builtin_clzl(bucket)));
+  }
+
+  /*
+   * CompareNode() - Compares a node with a split order key and a key
+   *
+   * Returns negative if the node is before the search key, 0 if equal and
+   * positive if after. Keys are only compared for regular nodes whose split
+   * order keys are the same (i.e. hash collision)
+   */
+  inline int CompareNode(const Node *node_p,
+                         uint64_t so_key,
+                         const KeyType &key) const {
+    if(node_p->so_key < so_key) {
+      return -1;
+    } else if(node_p->so_key > so_key) {
+      return 1;
+    } else if((so_key & 0x1UL) == 0UL) {
+      // Dummy nodes with the same split order key are equal
+      return 0;
+    } else if(key_cmp_obj(node_p->key, key) == true) {
+      return -1;
+    } else if(key_cmp_obj(key, node_p->key) == true) {
+      return 1;
+    }
+
+    return 0;
+  }
+
+  /*
+   * Search() - Finds the first node that is not before the search key
+   *            starting from a dummy node
+   *
+   * On return, cursor.prev_p points to the next pointer that points to 
+   * cursor.curr_p, which could be nullptr if the end of list is reached.
+   * Return value is true if the node compares equal to the search key
+   *
+   * Marked nodes on the path are unlinked and retired. If CAS fails during
+   * unlinking we restart from the dummy node, since the previous node might
+   * have been deleted
+   */
+  bool Search(Node *start_p,
+              uint64_t so_key,
+              const KeyType &key,
+              Cursor *cursor_p) {
+    return MarkedList::Search(start_p,
+                              &start_p->next_p,
+                              GetLink,
+                              [this, so_key, &key](const Node *node_p) {
+                                return CompareNode(node_p, so_key, key);
+                              },
+                              [this](Node *node_p) {
+                                em_p->AddGarbageNode(node_p);
+                              },
+                              cursor_p);
+  }
+
+  /*
+   * InitializeBucket() - Inserts the dummy node of a bucket and installs it
+   *                      into the given bucket array
+   *
+   * The parent bucket is initialized recursively if it has not been. If the
+   * dummy node has already been inserted by another thread (possibly into
+   * an older bucket array) then we just use the existing one
+   */
+  Node *InitializeBucket(BucketArray *array_p, uint64_t bucket) {
+    uint64_t parent_bucket = GetParentBucket(bucket);
+
+    Node *parent_p = array_p->bucket_list_p[parent_bucket].load();
+    if(parent_p == nullptr) {
+      parent_p = InitializeBucket(array_p, parent_bucket);
+    }
+
+    uint64_t so_key = GetDummyKey(bucket);
+    Node *dummy_p = new Node{so_key};
+
+    while(1) {
+      Cursor cursor;
+
+      if(Search(parent_p, so_key, dummy_p->key, &cursor) == true) {
+        delete dummy_p;
+        dummy_p = cursor.curr_p;
+
+        break;
+      }
+
+      dummy_p->next_p.store(cursor.curr_p);
+      if(cursor.prev_p->compare_exchange_strong(cursor.curr_p,
+                                                dummy_p) == true) {
+        break;
+      }
+    }
+
+    // Dummy nodes are never deleted, so it is fine if more than one thread
+    // writes the same value here
+    array_p->bucket_list_p[bucket].store(dummy_p);
+
+    return dummy_p;
+  }
+
+  /*
+   * GetBucket() - Returns the dummy node of the bucket a hash value maps to
+   */
+  Node *GetBucket(uint64_t hash) {
+    BucketArray *array_p = bucket_array_p.load();
+    uint64_t bucket = hash & (array_p->size - 1);
+
+    Node *dummy_p = array_p->bucket_list_p[bucket].load();
+    if(unlikely(dummy_p == nullptr)) {
+      dummy_p = InitializeBucket(array_p, bucket);
+    }
+
+    return dummy_p;
+  }
+
+  /*
+   * Grow() - Replaces the given bucket array with one that is twice as large
+   *
+   * Initialized buckets are copied into the new array, and buckets that are
+   * initialized in the old array after being copied will be found again by
+   * InitializeBucket() through the list. Only the thread that installs the
+   * new array retires the old one; others just free their copy
+   */
+  void Grow(BucketArray *array_p) {
+    BucketArray *new_array_p = new BucketArray{array_p->size * 2};
+
+    for(uint64_t i = 0;i < array_p->size;i++) {
+      new_array_p->bucket_list_p[i].store(array_p->bucket_list_p[i].load());
+    }
+
+    if(bucket_array_p.compare_exchange_strong(array_p,
+                                              new_array_p) == true) {
+      em_p->AddGarbageNode(array_p);
+    } else {
+      delete new_array_p;
+    }
+
+    return;
+  }
+
+ public:
+
+  /*
+   * Constructor - Initializes the bucket array and bucket 0
+   *
+   * Initial number of buckets is rounded up to a power of 2
+   */
+  AtomicHashMap(EMType *p_em_p, uint64_t initial_bucket_num = 16) :
+    item_count{0},
+    em_p{p_em_p},
+    key_hash_obj{},
+    key_cmp_obj{} {
+    uint64_t size = 1;
+    while(size < initial_bucket_num) {
+      size <<= 1;
+    }
+
+    BucketArray *array_p = new BucketArray{size};
+
+    head_p = new Node{GetDummyKey(0)};
+    array_p->bucket_list_p[0].store(head_p);
+
+    bucket_array_p.store(array_p);
+
+    return;
+  }
+
+  /*
+   * Destructor - Frees all nodes still in the list and the bucket array
+   *
+   * This must be called in single threaded environment. Nodes and arrays
+   * that have been retired are freed by the EM instead
+   */
+  ~AtomicHashMap() {
+    Node *node_p = head_p;
+    while(node_p != nullptr) {
+      Node *next_p = MarkedList::Unmark(node_p->next_p.load());
+      delete node_p;
+
+      node_p = next_p;
+    }
+
+    delete bucket_array_p.load();
+
+    return;
+  }
+
+  // Disallow copying since the map owns its nodes
+  AtomicHashMap(const AtomicHashMap &) = delete;
+  AtomicHashMap &operator=(const AtomicHashMap &) = delete;
+
+  /*
+   * Insert() - Inserts a key value pair into the map
+   *
+   * Returns false if the key already exists in which case nothing is changed
+   */
+  bool Insert(const KeyType &key, const ValueType &value) {
+    uint64_t hash = key_hash_obj(key);
+    uint64_t so_key = GetRegularKey(hash);
+    Node *bucket_p = GetBucket(hash);
+
+    Node *node_p = new Node{so_key, key, value};
+
+    while(1) {
+      Cursor cursor;
+
+      if(Search(bucket_p, so_key, key, &cursor) == true) {
+        // The node was never visible so just delete it
+        delete node_p;
+
+        return false;
+      }
+
+      node_p->next_p.store(cursor.curr_p);
+      if(cursor.prev_p->compare_exchange_strong(cursor.curr_p,
+                                                node_p) == true) {
+        break;
+      }
+    }
+
+    uint64_t count = item_count.fetch_add(1) + 1;
+
+    BucketArray *array_p = bucket_array_p.load();
+    if(unlikely(count > array_p->size * MAX_LOAD_FACTOR)) {
+      Grow(array_p);
+    }
+
+    return true;
+  }
+
+  /*
+   * Delete() - Removes a key from the map
+   *
+   * The node is first logically deleted by setting the mark bit on its next
+   * pointer, which is the linearization point, and then we try to unlink it
+   * physically. If unlinking fails then a Search() is issued to help,
+   * after which the node is guaranteed to be unlinked by some thread
+   *
+   * Returns false if the key does not exist
+   */
+  bool Delete(const KeyType &key) {
+    uint64_t hash = key_hash_obj(key);
+    uint64_t so_key = GetRegularKey(hash);
+    Node *bucket_p = GetBucket(hash);
+
+    while(1) {
+      Cursor cursor;
+
+      if(Search(bucket_p, so_key, key, &cursor) == false) {
+        return false;
+      }
+
+      Node *curr_p = cursor.curr_p;
+      Node *next_p = curr_p->next_p.load();
+
+      // Either being deleted by another thread (next search would unlink it
+      // and return false) or failed to mark; in both cases retry
+      if(MarkedList::IsMarked(next_p) == true) {
+        continue;
+      } else if(curr_p->next_p.compare_exchange_strong(
+                  next_p, MarkedList::Mark(next_p)) == false) {
+        continue;
+      }
+
+      item_count.fetch_sub(1);
+
+      Node *expected_p = curr_p;
+      if(cursor.prev_p->compare_exchange_strong(expected_p, next_p) == true) {
+        em_p->AddGarbageNode(curr_p);
+      } else {
+        Search(bucket_p, so_key, key, &cursor);
+      }
+
+      return true;
+    }
+
+    assert(false);
+    return false;
+  }
+
+  /*
+   * Find() - Looks up a key and copies its value into the reference
+   *
+   * The first access to a bucket initializes it through GetBucket(), which
+   * inserts its dummy node into the list (unlinking marked nodes on the
+   * way) and installs it into the bucket array. Apart from that this
+   * function does not write to shared memory: logically deleted nodes are
+   * skipped rather than unlinked, since epoch protection guarantees that
+   * they are still valid to read
+   *
+   * Returns false if the key does not exist
+   */
+  bool Find(const KeyType &key, ValueType &value) {
+    uint64_t hash = key_hash_obj(key);
+    uint64_t so_key = GetRegularKey(hash);
+
+    int cmp;
+    Node *node_p = MarkedList::Lookup(GetBucket(hash),
+                                      GetLink,
+                                      [this, so_key, &key](const Node *p) {
+                                        return CompareNode(p, so_key, key);
+                                      },
+                                      &cmp);
+    if((node_p == nullptr) || (cmp != 0)) {
+      return false;
+    }
+
+    value = node_p->value;
+
+    return true;
+  }
+
+  /*
+   * GetItemCount() - Returns the number of key value pairs in the map
+   */
+  inline uint64_t GetItemCount() const {
+    return item_count.load();
+  }
+
+  /*
+   * GetBucketNum() - Returns the size of the current bucket array
+   */
+  inline uint64_t GetBucketNum() const {
+    return bucket_array_p.load()->size;
+  }
+};
+
+} // namespace index
+} // namespace peloton
+
+#endif
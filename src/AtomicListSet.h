@@ -0,0 +1,261 @@
+#pragma once
+
+#ifndef _ATOMIC_LIST_SET_H
+#define _ATOMIC_LIST_SET_H
+
+#include "common.h"
+#include "HarrisMichaelList.h"
+
+#include <functional>
+
+namespace peloton {
+namespace index {
+
+/*
+ * class AtomicListSet - A sorted lock-free linked list that implements a set
+ *
+ * This is the Harris-Michael list: the lowest bit of the next pointer of a
+ * node is its logical delete mark, and the search loop is shared with the
+ * hash map and the skiplist through HarrisMichaelList. Delete() first
+ * marks the node, which is the linearization point, and then tries to
+ * unlink it with CAS on the next pointer of its predecessor. Any thread 
+ * that runs into a marked node in Search() also tries to unlink it, and
+ * the thread whose CAS succeeds retires the node through the EM, so each
+ * node is retired exactly once
+ *
+ * Contains() never writes shared memory, and steps over marked nodes which
+ * are still safe to read under epoch protection. The caller is responsible
+ * for maintaining epoch counters outside each call
+ */
+template <typename KeyType,
+          template <typename> class EMTemplate,
+          typename KeyComparator = std::less<KeyType>>
+class AtomicListSet {
+ private:
+
+  /*
+   * class Node - Linked list node
+   */
+  class Node {
+   public:
+    KeyType key;
+    std::atomic<Node *> next_p;
+
+    /*
+     * Constructor
+     */
+    Node(const KeyType &p_key, Node *p_next_p) :
+      key{p_key},
+      next_p{p_next_p}
+    {}
+  };
+
+ public:
+  // The EM should be instanciated with this type
+  using NodeType = Node;
+  using EMType = EMTemplate<NodeType>;
+
+ private:
+  using MarkedList = HarrisMichaelList<Node>;
+  using Cursor = typename MarkedList::Cursor;
+
+  // The first node of the list or nullptr
+  std::atomic<Node *> head_p;
+
+  // Unlinked nodes go here
+  EMType *em_p;
+
+  KeyComparator key_cmp_obj;
+
+ private:
+
+  /*
+   * GetLink() - Returns the next pointer of a node
+   */
+  static inline std::atomic<Node *> &GetLink(Node *node_p) {
+    return node_p->next_p;
+  }
+
+  /*
+   * CompareNode() - Compares the key of a node with the search key
+   *
+   * Returns negative if the node is before the search key, 0 if equal and
+   * positive if after
+   */
+  inline int CompareNode(const Node *node_p, const KeyType &key) const {
+    if(key_cmp_obj(node_p->key, key) == true) {
+      return -1;
+    } else if(key_cmp_obj(key, node_p->key) == true) {
+      return 1;
+    }
+
+    return 0;
+  }
+
+  /*
+   * Search() - Finds the first node whose key is not less than the search key
+   *
+   * On return, cursor.prev_p points to the next pointer (or the head 
+   * pointer) that points to cursor.curr_p, which could be nullptr if the
+   * end of list is reached. Return value is true if the node has the search
+   * key
+   *
+   * Marked nodes on the path are unlinked and retired. If CAS fails during
+   * unlinking we restart from the head, since the previous node might
+   * have been deleted
+   */
+  bool Search(const KeyType &key, Cursor *cursor_p) {
+    return MarkedList::Search(nullptr,
+                              &head_p,
+                              GetLink,
+                              [this, &key](const Node *node_p) {
+                                return CompareNode(node_p, key);
+                              },
+                              [this](Node *node_p) {
+                                em_p->AddGarbageNode(node_p);
+                              },
+                              cursor_p);
+  }
+
+ public:
+
+  /*
+   * Constructor - Initializes an empty list
+   */
+  AtomicListSet(EMType *p_em_p) :
+    head_p{nullptr},
+    em_p{p_em_p},
+    key_cmp_obj{}
+  {}
+
+  /*
+   * Destructor - Frees all nodes still in the list
+   *
+   * This must be called in single threaded environment. Retired nodes are
+   * freed by the EM
+   */
+  ~AtomicListSet() {
+    Node *node_p = head_p.load();
+    while(node_p != nullptr) {
+      Node *next_p = MarkedList::Unmark(node_p->next_p.load());
+      delete node_p;
+
+      node_p = next_p;
+    }
+
+    return;
+  }
+
+  // Disallow copying since the list owns its nodes
+  AtomicListSet(const AtomicListSet &) = delete;
+  AtomicListSet &operator=(const AtomicListSet &) = delete;
+
+  /*
+   * Insert() - Inserts a key into the set
+   *
+   * Returns false if the key already exists
+   */
+  bool Insert(const KeyType &key) {
+    Node *node_p = new Node{key, nullptr};
+
+    while(1) {
+      Cursor cursor;
+
+      if(Search(key, &cursor) == true) {
+        // The node was never visible so just delete it
+        delete node_p;
+
+        return false;
+      }
+
+      node_p->next_p.store(cursor.curr_p);
+      if(cursor.prev_p->compare_exchange_strong(cursor.curr_p,
+                                                node_p) == true) {
+        return true;
+      }
+    }
+
+    assert(false);
+    return false;
+  }
+
+  /*
+   * Delete() - Removes a key from the set
+   *
+   * Returns false if the key does not exist or another thread marked the
+   * same node first
+   */
+  bool Delete(const KeyType &key) {
+    while(1) {
+      Cursor cursor;
+
+      if(Search(key, &cursor) == false) {
+        return false;
+      }
+
+      Node *curr_p = cursor.curr_p;
+      Node *next_p = curr_p->next_p.load();
+
+      // Either being deleted by another thread (next search would unlink it
+      // and return false) or failed to mark; in both cases retry
+      if(MarkedList::IsMarked(next_p) == true) {
+        continue;
+      } else if(curr_p->next_p.compare_exchange_strong(
+                  next_p, MarkedList::Mark(next_p)) == false) {
+        continue;
+      }
+
+      Node *expected_p = curr_p;
+      if(cursor.prev_p->compare_exchange_strong(expected_p, next_p) == true) {
+        em_p->AddGarbageNode(curr_p);
+      } else {
+        Search(key, &cursor);
+      }
+
+      return true;
+    }
+
+    assert(false);
+    return false;
+  }
+
+  /*
+   * Contains() - Returns whether a key is in the set
+   */
+  bool Contains(const KeyType &key) const {
+    int cmp;
+    Node *node_p = MarkedList::Lookup(head_p.load(),
+                                      GetLink,
+                                      [this, &key](const Node *p) {
+                                        return CompareNode(p, key);
+                                      },
+                                      &cmp);
+
+    return (node_p != nullptr) && (cmp == 0);
+  }
+
+  /*
+   * GetSize() - Counts nodes that are not marked
+   *
+   * This walks the entire list, and is only accurate if there is no
+   * concurrent modification
+   */
+  uint64_t GetSize() const {
+    uint64_t count = 0;
+    Node *node_p = head_p.load();
+
+    while(node_p != nullptr) {
+      Node *next_p = node_p->next_p.load();
+      count += (MarkedList::IsMarked(next_p) == false);
+
+      node_p = MarkedList::Unmark(next_p);
+    }
+
+    return count;
+  }
+};
+
+} // namespace index
+} // namespace peloton
+
+#endif
@@ -0,0 +1,2 @@
+
+#include "AtomicSkipList.h"
@@ -0,0 +1,462 @@
+#pragma once
+
+#ifndef _ATOMIC_SKIP_LIST_H
+#define _ATOMIC_SKIP_LIST_H
+
+#include "common.h"
+#include "HarrisMichaelList.h"
+
+#include <functional>
+#include <new>
+#include <utility>
+
+namespace peloton {
+namespace index {
+
+/*
+ * class AtomicSkipList - A lock-free skiplist that maps unique keys to values
+ *                        in key order
+ *
+ * Each node has a tower of next pointers whose height is chosen randomly
+ * with p = 1/2. The lowest bit of each next pointer is the delete mark of
+ * the node on that level, and each level is searched with the loop of
+ * HarrisMichaelList. Delete() marks the tower from the top down to
+ * level 0, and marking level 0 is the linearization point. Marked nodes
+ * are unlinked level by level by any thread that runs into them
+ *
+ * Since Insert() links upper levels after level 0, a node could be linked
+ * on some upper level after it is unlinked on level 0. A node is therefore
+ * not retired on its level 0 unlink, but after all levels it has ever been
+ * linked on are unlinked, which is tracked by link_count. Levels that the
+ * inserter gives up building also count as unlinked
+ *
+ * Find() and Scan() never write shared memory, and just step over marked
+ * nodes which are still safe to read under epoch protection. The caller is
+ * responsible for maintaining epoch counters outside each call. Both
+ * KeyType and ValueType must be default constructable for the head node
+ */
+template <typename KeyType,
+          typename ValueType,
+          template <typename> class EMTemplate,
+          typename KeyComparator = std::less<KeyType>>
+class AtomicSkipList {
+ public:
+  // Height of the head node, which is also the maximum tower height
+  static constexpr int MAX_HEIGHT = 32;
+
+ private:
+
+  /*
+   * class Node - Skiplist node with a variable sized tower
+   *
+   * Nodes must be created with Create(), since the tower is allocated
+   * together with the node after the end of the class. Operator delete is
+   * overloaded such that the EM could free nodes with delete
+   */
+  class Node {
+   public:
+    KeyType key;
+    ValueType value;
+
+    // Number of levels of the tower
+    int height;
+
+    // Number of levels that are still or could still be linked
+    std::atomic<int> link_count;
+
+    // Tower of next pointers; the actual length is height
+    std::atomic<Node *> next_p[0];
+
+    /*
+     * Constructor - Initializes the tower to all nullptr
+     */
+    Node(const KeyType &p_key, const ValueType &p_value, int p_height) :
+      key{p_key},
+      value{p_value},
+      height{p_height},
+      link_count{p_height} {
+      for(int i = 0;i < height;i++) {
+        next_p[i].store(nullptr);
+      }
+
+      return;
+    }
+
+    /*
+     * Create() - Allocates a node with a tower of the given height
+     */
+    static Node *Create(const KeyType &key, const ValueType &value, int height) {
+      void *p = ::operator new(sizeof(Node) +
+                               sizeof(std::atomic<Node *>) * height);
+
+      return new (p) Node{key, value, height};
+    }
+
+    /*
+     * operator delete - Frees memory allocated by Create()
+     */
+    static void operator delete(void *p) {
+      ::operator delete(p);
+    }
+  };
+
+ public:
+  // The EM should be instanciated with this type
+  using NodeType = Node;
+  using EMType = EMTemplate<NodeType>;
+
+  // Type of range scan results
+  using KeyValuePair = std::pair<KeyType, ValueType>;
+
+ private:
+  using MarkedList = HarrisMichaelList<Node>;
+  using Cursor = typename MarkedList::Cursor;
+
+  // Head node has the maximum height and is never deleted
+  Node *head_p;
+
+  // Unlinked nodes go here
+  EMType *em_p;
+
+  KeyComparator key_cmp_obj;
+
+ private:
+
+  /*
+   * CompareNode() - Compares the key of a node with the search key
+   *
+   * Returns negative if the node is before the search key, 0 if equal and
+   * positive if after
+   */
+  inline int CompareNode(const Node *node_p, const KeyType &key) const {
+    if(key_cmp_obj(node_p->key, key) == true) {
+      return -1;
+    } else if(key_cmp_obj(key, node_p->key) == true) {
+      return 1;
+    }
+
+    return 0;
+  }
+
+  /*
+   * GetRandomHeight() - Returns a tower height with geometric distribution
+   *
+   * Each thread keeps its own xorshift state so no cache line is shared
+   */
+  static int GetRandomHeight() {
+    static thread_local uint64_t state = 0UL;
+    if(unlikely(state == 0UL)) {
+      state = std::hash<std::thread::id>{}(std::this_thread::get_id()) | 0x1UL;
+    }
+
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+
+    // Number of trailing 1's plus one, capped at MAX_HEIGHT
+    return __builtin_ctzl(~state | (0x1UL << (MAX_HEIGHT - 1))) + 1;
+  }
+
+  /*
+   * ReleaseLevels() - Counts levels of a node as unlinked, and retires the
+   *                   node if none of its levels could be linked
+   */
+  inline void ReleaseLevels(Node *node_p, int level_num) {
+    if(node_p->link_count.fetch_sub(level_num) == level_num) {
+      em_p->AddGarbageNode(node_p);
+    }
+
+    return;
+  }
+
+  /*
+   * Search() - Finds predecessors and successors of a key on all levels
+   *
+   * On return pred_list[i] is the last node on level i whose key is less
+   * than the search key, and succ_list[i] is the node after it. Return
+   * value is true if succ_list[0] has the search key
+   *
+   * Marked nodes on the path are unlinked. If unlinking fails we restart
+   * from the head since the predecessor might have been deleted
+   */
+  bool Search(const KeyType &key, Node **pred_list, Node **succ_list) {
+    auto cmp_func = [this, &key](const Node *node_p) {
+                      return CompareNode(node_p, key);
+                    };
+    auto retire_func = [this](Node *node_p) {
+                         ReleaseLevels(node_p, 1);
+                       };
+
+    while(1) {
+      bool restart = false;
+      Node *pred_p = head_p;
+      Cursor cursor;
+
+      for(int level = MAX_HEIGHT - 1;level >= 0;level--) {
+        auto link_func = [level](Node *node_p) -> std::atomic<Node *> & {
+                           return node_p->next_p[level];
+                         };
+
+        if(MarkedList::TrySearch(pred_p,
+                                 &pred_p->next_p[level],
+                                 link_func,
+                                 cmp_func,
+                                 retire_func,
+                                 &cursor) == false) {
+          restart = true;
+          break;
+        }
+
+        pred_p = cursor.pred_p;
+
+        pred_list[level] = pred_p;
+        succ_list[level] = cursor.curr_p;
+      } // for level
+
+      if(restart == true) {
+        continue;
+      }
+
+      // The cursor is on level 0
+      return cursor.cmp == 0;
+    } // while(1)
+
+    assert(false);
+    return false;
+  }
+
+  /*
+   * FindGreaterOrEqual() - Returns the first node on level 0 whose key is
+   *                        not less than the search key and is not deleted
+   *
+   * This function is read-only, and returns nullptr if there is no such node
+   */
+  Node *FindGreaterOrEqual(const KeyType &key) const {
+    Node *pred_p = head_p;
+    Node *curr_p = nullptr;
+
+    for(int level = MAX_HEIGHT - 1;level >= 0;level--) {
+      curr_p = MarkedList::Unmark(pred_p->next_p[level].load());
+
+      while(curr_p != nullptr) {
+        Node *succ_p = curr_p->next_p[level].load();
+
+        if(MarkedList::IsMarked(succ_p) == true) {
+          curr_p = MarkedList::Unmark(succ_p);
+        } else if(CompareNode(curr_p, key) < 0) {
+          pred_p = curr_p;
+          curr_p = succ_p;
+        } else {
+          break;
+        }
+      }
+    }
+
+    return curr_p;
+  }
+
+ public:
+
+  /*
+   * Constructor - Creates the head node
+   */
+  AtomicSkipList(EMType *p_em_p) :
+    head_p{Node::Create(KeyType{}, ValueType{}, MAX_HEIGHT)},
+    em_p{p_em_p},
+    key_cmp_obj{}
+  {}
+
+  /*
+   * Destructor - Frees all nodes on level 0 and the head node
+   *
+   * This must be called in single threaded environment after all
+   * operations have returned, at which time no marked node is linked
+   */
+  ~AtomicSkipList() {
+    Node *node_p = head_p;
+    while(node_p != nullptr) {
+      Node *next_p = MarkedList::Unmark(node_p->next_p[0].load());
+      delete node_p;
+
+      node_p = next_p;
+    }
+
+    return;
+  }
+
+  // Disallow copying since the list owns its nodes
+  AtomicSkipList(const AtomicSkipList &) = delete;
+  AtomicSkipList &operator=(const AtomicSkipList &) = delete;
+
+  /*
+   * Insert() - Inserts a key value pair
+   *
+   * The node is first linked on level 0, after which it is visible. Upper
+   * levels are then linked bottom up. We stop building the tower if the
+   * node gets marked in the meantime, and count unbuilt levels as unlinked.
+   *
+   * Returns false if the key already exists
+   */
+  bool Insert(const KeyType &key, const ValueType &value) {
+    Node *pred_list[MAX_HEIGHT];
+    Node *succ_list[MAX_HEIGHT];
+    Node *node_p = nullptr;
+
+    while(1) {
+      if(Search(key, pred_list, succ_list) == true) {
+        // The node was never visible so just delete it
+        delete node_p;
+
+        return false;
+      }
+
+      if(node_p == nullptr) {
+        node_p = Node::Create(key, value, GetRandomHeight());
+      }
+
+      for(int level = 0;level < node_p->height;level++) {
+        node_p->next_p[level].store(succ_list[level]);
+      }
+
+      Node *expected_p = succ_list[0];
+      if(pred_list[0]->next_p[0].compare_exchange_strong(expected_p,
+                                                         node_p) == true) {
+        break;
+      }
+    }
+
+    int level = 1;
+    while(level < node_p->height) {
+      // Only Delete() modifies the tower of a node not yet linked on this
+      // level, and it only sets the mark bit
+      Node *next_p = node_p->next_p[level].load();
+      if((MarkedList::IsMarked(next_p) == true) ||
+         (node_p->next_p[level].compare_exchange_strong(
+            next_p, succ_list[level]) == false)) {
+        break;
+      }
+
+      Node *expected_p = succ_list[level];
+      if(pred_list[level]->next_p[level].compare_exchange_strong(
+           expected_p, node_p) == true) {
+        level++;
+
+        continue;
+      }
+
+      // The node has been deleted (and possibly a new one with the same
+      // key inserted) if it is no longer found on level 0
+      Search(key, pred_list, succ_list);
+      if(succ_list[0] != node_p) {
+        break;
+      }
+    }
+
+    if(level < node_p->height) {
+      ReleaseLevels(node_p, node_p->height - level);
+    }
+
+    // If the node got deleted while we were linking it then the cleanup
+    // Search() in Delete() might have missed levels linked afterwards
+    if(MarkedList::IsMarked(node_p->next_p[0].load()) == true) {
+      Search(key, pred_list, succ_list);
+    }
+
+    return true;
+  }
+
+  /*
+   * Delete() - Removes a key from the skiplist
+   *
+   * Returns false if the key does not exist or another thread deleted the
+   * same node first
+   */
+  bool Delete(const KeyType &key) {
+    Node *pred_list[MAX_HEIGHT];
+    Node *succ_list[MAX_HEIGHT];
+
+    if(Search(key, pred_list, succ_list) == false) {
+      return false;
+    }
+
+    Node *node_p = succ_list[0];
+
+    // Mark upper levels top down; these might be marked by other deleting
+    // threads already
+    for(int level = node_p->height - 1;level >= 1;level--) {
+      Node *next_p = node_p->next_p[level].load();
+      while(MarkedList::IsMarked(next_p) == false) {
+        node_p->next_p[level].compare_exchange_strong(next_p,
+                                                      MarkedList::Mark(next_p));
+      }
+    }
+
+    // Only one thread could mark level 0
+    Node *next_p = node_p->next_p[0].load();
+    while(1) {
+      if(MarkedList::IsMarked(next_p) == true) {
+        return false;
+      }
+
+      if(node_p->next_p[0].compare_exchange_strong(
+           next_p, MarkedList::Mark(next_p)) == true) {
+        break;
+      }
+    }
+
+    // Physically unlink the node from all levels
+    Search(key, pred_list, succ_list);
+
+    return true;
+  }
+
+  /*
+   * Find() - Looks up a key and copies its value into the reference
+   *
+   * Returns false if the key does not exist
+   */
+  bool Find(const KeyType &key, ValueType &value) const {
+    Node *node_p = FindGreaterOrEqual(key);
+
+    if((node_p == nullptr) || (CompareNode(node_p, key) != 0)) {
+      return false;
+    }
+
+    value = node_p->value;
+
+    return true;
+  }
+
+  /*
+   * Scan() - Appends all key value pairs within [low_key, high_key] to the
+   *          result vector in key order
+   *
+   * The scan is not atomic - a key inserted or deleted concurrently may or
+   * may not be seen. Returns the number of pairs appended
+   */
+  uint64_t Scan(const KeyType &low_key,
+                const KeyType &high_key,
+                std::vector<KeyValuePair> &result) const {
+    uint64_t count = 0;
+    Node *node_p = FindGreaterOrEqual(low_key);
+
+    while((node_p != nullptr) &&
+          (CompareNode(node_p, high_key) <= 0)) {
+      Node *next_p = node_p->next_p[0].load();
+
+      if(MarkedList::IsMarked(next_p) == false) {
+        result.emplace_back(node_p->key, node_p->value);
+        count++;
+      }
+
+      node_p = MarkedList::Unmark(next_p);
+    }
+
+    return count;
+  }
+};
+
+} // namespace index
+} // namespace peloton
+
+#endif
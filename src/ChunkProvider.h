@@ -0,0 +1,265 @@
+
+#pragma once
+
+#ifndef _CHUNK_PROVIDER_H
+#define _CHUNK_PROVIDER_H
+
+#include "common.h"
+
+#include <sys/mman.h>
+
+/*
+ * class ChunkProvider - Supplies aligned memory regions to allocators that
+ *                       carve objects out of large chunks
+ *
+ * Alignment is always a power of two. Free() and Decommit() are given the
+ * same size as Allocate()
+ */
+class ChunkProvider {
+ public:
+  virtual ~ChunkProvider() {}
+
+  /*
+   * Allocate() - Returns a region of sz bytes aligned to alignment
+   */
+  virtual void *Allocate(size_t sz, size_t alignment) = 0;
+
+  /*
+   * Free() - Releases a region returned by Allocate()
+   */
+  virtual void Free(void *p, size_t sz) = 0;
+
+  /*
+   * Decommit() - Gives physical memory of a region back to the OS while
+   *              keeping it allocated
+   *
+   * The content is lost and reads as zero afterwards if the provider
+   * supports it. This is a hint and the default does nothing
+   */
+  virtual void Decommit(void *p, size_t sz) {
+    (void)p;
+    (void)sz;
+
+    return;
+  }
+};
+
+/*
+ * class HeapChunkProvider - Allocates chunks from the general heap
+ *
+ * Decommit() only applies to whole pages inside the region, since the
+ * rest of a page could belong to other heap blocks
+ */
+class HeapChunkProvider : public ChunkProvider {
+ public:
+  static constexpr uint64_t PAGE_SIZE = 4096;
+
+  void *Allocate(size_t sz, size_t alignment) override {
+    void *p = nullptr;
+    int ret = posix_memalign(&p, alignment, sz);
+    assert(ret == 0);
+    (void)ret;
+
+    return p;
+  }
+
+  void Free(void *p, size_t sz) override {
+    (void)sz;
+    free(p);
+
+    return;
+  }
+
+  void Decommit(void *p, size_t sz) override {
+    uint64_t start = (reinterpret_cast<uint64_t>(p) + PAGE_SIZE - 1) &
+                     ~(PAGE_SIZE - 1);
+    uint64_t end = (reinterpret_cast<uint64_t>(p) + sz) & ~(PAGE_SIZE - 1);
+
+    if(start < end) {
+      madvise(reinterpret_cast<void *>(start), end - start, MADV_DONTNEED);
+    }
+
+    return;
+  }
+};
+
+/*
+ * class MmapChunkProvider - Maps chunks directly from the OS, optionally
+ *                           backed by huge pages
+ *
+ * Under HugePageMode::MADVISE chunks are hinted with MADV_HUGEPAGE such
+ * that transparent huge pages are used if the kernel allows. Under
+ * HugePageMode::HUGETLB chunks are mapped with MAP_HUGETLB from the
+ * reserved pool, and if that fails (e.g. no page is reserved) it falls back
+ * to MADVISE. Sizes are rounded up to HUGE_PAGE_SIZE in both huge page
+ * modes, so chunks should be a multiple of it to avoid waste. Decommit()
+ * uses MADV_DONTNEED
+ *
+ * Linux only accepts MADV_DONTNEED on MAP_HUGETLB mappings since 5.18, and
+ * older kernels return EINVAL. Since Decommit() is a hint, such a failure
+ * is not fatal: the chunk simply stays committed and keeps its content,
+ * and the failure is counted. munmap() in Free() still returns the pages
+ */
+class MmapChunkProvider : public ChunkProvider {
+ public:
+  static constexpr size_t PAGE_SIZE = 4096;
+  static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+  enum class HugePageMode {
+    NONE,
+    MADVISE,
+    HUGETLB,
+  };
+
+ private:
+  HugePageMode mode;
+
+  // Number of chunks mapped from the huge page pool, and number of chunks
+  // that fall back to normal pages in HUGETLB mode
+  std::atomic<uint64_t> hugetlb_count;
+  std::atomic<uint64_t> fallback_count;
+
+  // Number of Decommit() calls rejected by the kernel
+  std::atomic<uint64_t> decommit_fail_count;
+
+  /*
+   * GetMapSize() - Returns the length of the mapping of a region
+   */
+  inline size_t GetMapSize(size_t sz) const {
+    size_t page_size = PAGE_SIZE;
+    if(mode != HugePageMode::NONE) {
+      page_size = HUGE_PAGE_SIZE;
+    }
+
+    return (sz + page_size - 1) & ~(page_size - 1);
+  }
+
+  /*
+   * MapAligned() - Maps sz bytes aligned to alignment by mapping more and
+   *                trimming both ends
+   *
+   * Returns nullptr if mmap() fails. Both sz and alignment must be
+   * multiples of the page size of the mapping
+   */
+  static void *MapAligned(size_t sz, size_t alignment, int flags) {
+    size_t map_size = sz + alignment;
+
+    void *p = mmap(nullptr,
+                   map_size,
+                   PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | flags,
+                   -1,
+                   0);
+    if(p == MAP_FAILED) {
+      return nullptr;
+    }
+
+    char *base = reinterpret_cast<char *>(p);
+    char *aligned = reinterpret_cast<char *>(
+                      (reinterpret_cast<uint64_t>(base) + alignment - 1) &
+                      ~(alignment - 1));
+
+    if(aligned != base) {
+      munmap(base, aligned - base);
+    }
+
+    char *end = base + map_size;
+    if(aligned + sz != end) {
+      munmap(aligned + sz, end - (aligned + sz));
+    }
+
+    return aligned;
+  }
+
+ public:
+
+  /*
+   * Constructor
+   */
+  MmapChunkProvider(HugePageMode p_mode = HugePageMode::NONE) :
+    mode{p_mode},
+    hugetlb_count{0},
+    fallback_count{0},
+    decommit_fail_count{0}
+  {}
+
+  void *Allocate(size_t sz, size_t alignment) override {
+    sz = GetMapSize(sz);
+
+    if(mode == HugePageMode::NONE) {
+      void *p = MapAligned(sz,
+                           (alignment < PAGE_SIZE) ? PAGE_SIZE : alignment,
+                           0);
+      assert(p != nullptr);
+
+      return p;
+    }
+
+    if(alignment < HUGE_PAGE_SIZE) {
+      alignment = HUGE_PAGE_SIZE;
+    }
+
+    if(mode == HugePageMode::HUGETLB) {
+      void *p = MapAligned(sz, alignment, MAP_HUGETLB);
+      if(p != nullptr) {
+        hugetlb_count.fetch_add(1);
+
+        return p;
+      }
+
+      fallback_count.fetch_add(1);
+    }
+
+    void *p = MapAligned(sz, alignment, 0);
+    assert(p != nullptr);
+
+    // If transparent huge pages are disabled this fails, and we just use
+    // normal pages
+    madvise(p, sz, MADV_HUGEPAGE);
+
+    return p;
+  }
+
+  void Free(void *p, size_t sz) override {
+    int ret = munmap(p, GetMapSize(sz));
+    assert(ret == 0);
+    (void)ret;
+
+    return;
+  }
+
+  void Decommit(void *p, size_t sz) override {
+    int ret = madvise(p, GetMapSize(sz), MADV_DONTNEED);
+    if(ret != 0) {
+      decommit_fail_count.fetch_add(1);
+    }
+
+    return;
+  }
+
+  /*
+   * GetHugeTLBCount() - Returns the number of chunks mapped from the huge
+   *                     page pool
+   */
+  inline uint64_t GetHugeTLBCount() const {
+    return hugetlb_count.load();
+  }
+
+  /*
+   * GetFallbackCount() - Returns the number of chunks that fall back from
+   *                      the huge page pool to normal mappings
+   */
+  inline uint64_t GetFallbackCount() const {
+    return fallback_count.load();
+  }
+
+  /*
+   * GetDecommitFailCount() - Returns the number of Decommit() calls that
+   *                          left the region committed
+   */
+  inline uint64_t GetDecommitFailCount() const {
+    return decommit_fail_count.load();
+  }
+};
+
+#endif
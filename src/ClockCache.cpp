@@ -0,0 +1,2 @@
+
+#include "ClockCache.h"
@@ -0,0 +1,416 @@
+#pragma once
+
+#ifndef _CLOCK_CACHE_H
+#define _CLOCK_CACHE_H
+
+#include "common.h"
+
+#include <functional>
+#include <mutex>
+
+namespace peloton {
+namespace index {
+
+/*
+ * class ClockCache - A concurrent cache using CLOCK replacement whose
+ *                    lookups are lock-free
+ *
+ * Entries are kept in a fixed size hash table whose buckets are singly
+ * linked chains. Lookup() only walks a chain and sets the reference bit of
+ * the entry it hits if the bit is not already set, so the read path does
+ * not issue any atomic RMW and does not write shared memory once an entry
+ * is hot. Entries are never reference counted: when an entry is evicted,
+ * deleted or replaced it is unlinked from its chain and retired through
+ * the EM, and readers that are still on the entry could continue reading
+ * it (including its next pointer) until they leave the epoch
+ *
+ * Writers (Insert() and Delete()) are serialized by a mutex, which also
+ * protects the clock ring. Since writers only run on misses this does not
+ * affect the read path, which is the common case for a cache
+ *
+ * Capacity is expressed as the total charge of all entries. Passing the
+ * default charge of 1 to every Insert() bounds the number of entries, and
+ * passing the size of the value in bytes bounds the memory usage. The
+ * caller is responsible for maintaining epoch counters outside each call
+ */
+template <typename KeyType,
+          typename ValueType,
+          template <typename> class EMTemplate,
+          typename KeyHashFunc = std::hash<KeyType>,
+          typename KeyEqualityChecker = std::equal_to<KeyType>>
+class ClockCache {
+ private:
+
+  /*
+   * class Entry - Hash chain node holding a cached key value pair
+   *
+   * Key, value and charge are never modified after the entry becomes
+   * visible. Updating a key creates a new entry
+   */
+  class Entry {
+   public:
+    KeyType key;
+    ValueType value;
+    uint64_t charge;
+
+    // Set by readers on hit and cleared by the clock hand
+    std::atomic<bool> referenced;
+
+    // Next entry in the same bucket
+    std::atomic<Entry *> next_p;
+
+    // Index into the clock ring; only accessed by writers
+    uint64_t slot;
+
+    /*
+     * Constructor
+     */
+    Entry(const KeyType &p_key,
+          const ValueType &p_value,
+          uint64_t p_charge) :
+      key{p_key},
+      value{p_value},
+      charge{p_charge},
+      referenced{true},
+      next_p{nullptr},
+      slot{0}
+    {}
+  };
+
+ public:
+  // The EM should be instanciated with this type
+  using EntryType = Entry;
+  using EMType = EMTemplate<EntryType>;
+
+ private:
+  // Total charge allowed
+  uint64_t capacity;
+
+  uint64_t bucket_mask;
+  std::atomic<Entry *> *bucket_list;
+
+  // All entries in the cache in no particular order; the clock hand
+  // sweeps over them
+  std::vector<Entry *> ring;
+  uint64_t hand;
+
+  // Sum of charges of all entries
+  uint64_t usage;
+  uint64_t eviction_count;
+
+  // Serializes writers; readers never touch it
+  std::mutex write_lock;
+
+  // Unlinked entries go here
+  EMType *em_p;
+
+  KeyHashFunc key_hash_obj;
+  KeyEqualityChecker key_eq_obj;
+
+ private:
+
+  /*
+   * GetBucket() - Returns the head pointer of the bucket of a key
+   */
+  inline std::atomic<Entry *> *GetBucket(const KeyType &key) const {
+    return &bucket_list[key_hash_obj(key) & bucket_mask];
+  }
+
+  /*
+   * FindPrev() - Returns the pointer that points to the entry with the given
+   *              key, or nullptr if the key is not in the cache
+   *
+   * This is only called by writers with the lock held
+   */
+  std::atomic<Entry *> *FindPrev(const KeyType &key) {
+    std::atomic<Entry *> *prev_p = GetBucket(key);
+    Entry *entry_p = prev_p->load(std::memory_order_relaxed);
+
+    while(entry_p != nullptr) {
+      if(key_eq_obj(entry_p->key, key) == true) {
+        return prev_p;
+      }
+
+      prev_p = &entry_p->next_p;
+      entry_p = prev_p->load(std::memory_order_relaxed);
+    }
+
+    return nullptr;
+  }
+
+  /*
+   * RemoveFromRing() - Removes an entry from the clock ring by moving the
+   *                    last entry into its slot
+   *
+   * This is only called by writers with the lock held
+   */
+  void RemoveFromRing(Entry *entry_p) {
+    uint64_t slot = entry_p->slot;
+    assert(ring[slot] == entry_p);
+
+    ring[slot] = ring.back();
+    ring[slot]->slot = slot;
+    ring.pop_back();
+
+    if(hand >= ring.size()) {
+      hand = 0;
+    }
+
+    return;
+  }
+
+  /*
+   * Unlink() - Unlinks an entry from its chain and the ring, and retires it
+   *
+   * prev_p must point to the entry. This is only called by writers with the
+   * lock held
+   */
+  void Unlink(std::atomic<Entry *> *prev_p) {
+    Entry *entry_p = prev_p->load(std::memory_order_relaxed);
+
+    // The entry keeps its next pointer, so readers on it could still
+    // continue traversing the chain
+    prev_p->store(entry_p->next_p.load(std::memory_order_relaxed),
+                  std::memory_order_release);
+
+    RemoveFromRing(entry_p);
+    usage -= entry_p->charge;
+
+    em_p->AddGarbageNode(entry_p);
+
+    return;
+  }
+
+  /*
+   * Evict() - Advances the clock hand until an entry that is not referenced
+   *           is found, and evicts that entry
+   *
+   * Entries passed by the hand have their reference bit cleared, so this
+   * terminates within two rounds. The pinned entry is always skipped, such
+   * that an entry is not evicted to make room for itself. This is only
+   * called by writers with the lock held
+   */
+  void Evict(Entry *pinned_p) {
+    assert(ring.size() > 1);
+
+    while(1) {
+      Entry *entry_p = ring[hand];
+
+      if((entry_p == pinned_p) ||
+         (entry_p->referenced.load(std::memory_order_relaxed) == true)) {
+        if(entry_p != pinned_p) {
+          entry_p->referenced.store(false, std::memory_order_relaxed);
+        }
+
+        hand++;
+        if(hand == ring.size()) {
+          hand = 0;
+        }
+
+        continue;
+      }
+
+      // The entry at the hand is replaced by the last entry in the ring,
+      // so the hand does not move
+      std::atomic<Entry *> *prev_p = FindPrev(entry_p->key);
+      assert(prev_p != nullptr);
+      assert(prev_p->load(std::memory_order_relaxed) == entry_p);
+
+      Unlink(prev_p);
+      eviction_count++;
+
+      return;
+    }
+
+    assert(false);
+    return;
+  }
+
+ public:
+
+  /*
+   * Constructor - Creates an empty cache
+   *
+   * The number of buckets is rounded up to a power of 2. If it is 0 then
+   * capacity is used, which fits caches whose charges are all 1
+   */
+  ClockCache(EMType *p_em_p,
+             uint64_t p_capacity,
+             uint64_t bucket_num = 0) :
+    capacity{p_capacity},
+    ring{},
+    hand{0},
+    usage{0},
+    eviction_count{0},
+    write_lock{},
+    em_p{p_em_p},
+    key_hash_obj{},
+    key_eq_obj{} {
+    if(bucket_num == 0) {
+      bucket_num = capacity;
+    }
+
+    uint64_t size = 1;
+    while(size < bucket_num) {
+      size <<= 1;
+    }
+
+    bucket_mask = size - 1;
+    bucket_list = new std::atomic<Entry *>[size];
+    for(uint64_t i = 0;i < size;i++) {
+      bucket_list[i].store(nullptr);
+    }
+
+    return;
+  }
+
+  /*
+   * Destructor - Frees all entries still in the cache
+   *
+   * This must be called in single threaded environment. Retired entries
+   * are freed by the EM
+   */
+  ~ClockCache() {
+    for(Entry *entry_p : ring) {
+      delete entry_p;
+    }
+
+    delete[] bucket_list;
+
+    return;
+  }
+
+  // Disallow copying since the cache owns its entries
+  ClockCache(const ClockCache &) = delete;
+  ClockCache &operator=(const ClockCache &) = delete;
+
+  /*
+   * Lookup() - Copies the value of a key into the argument
+   *
+   * Returns false if the key is not in the cache. This is lock-free and only
+   * writes the reference bit on the first hit after the clock hand has
+   * cleared it
+   */
+  bool Lookup(const KeyType &key, ValueType &value) {
+    Entry *entry_p = GetBucket(key)->load(std::memory_order_acquire);
+
+    while(entry_p != nullptr) {
+      if(key_eq_obj(entry_p->key, key) == true) {
+        if(entry_p->referenced.load(std::memory_order_relaxed) == false) {
+          entry_p->referenced.store(true, std::memory_order_relaxed);
+        }
+
+        value = entry_p->value;
+
+        return true;
+      }
+
+      entry_p = entry_p->next_p.load(std::memory_order_acquire);
+    }
+
+    return false;
+  }
+
+  /*
+   * Insert() - Inserts a key value pair, or replaces the value if the key
+   *            already exists
+   *
+   * Other entries are evicted until the total charge fits into the
+   * capacity. The new entry starts with its reference bit set, such that it
+   * survives at least one pass of the hand. Returns false if the charge
+   * alone exceeds the capacity, in which case nothing is changed
+   */
+  bool Insert(const KeyType &key,
+              const ValueType &value,
+              uint64_t charge = 1) {
+    if(charge > capacity) {
+      return false;
+    }
+
+    Entry *new_entry_p = new Entry{key, value, charge};
+
+    std::lock_guard<std::mutex> guard{write_lock};
+
+    std::atomic<Entry *> *prev_p = FindPrev(key);
+    if(prev_p != nullptr) {
+      // Take the position of the old entry such that readers always see
+      // either the old value or the new value
+      Entry *old_entry_p = prev_p->load(std::memory_order_relaxed);
+
+      new_entry_p->next_p.store(
+        old_entry_p->next_p.load(std::memory_order_relaxed),
+        std::memory_order_relaxed);
+      new_entry_p->slot = old_entry_p->slot;
+      ring[new_entry_p->slot] = new_entry_p;
+
+      prev_p->store(new_entry_p, std::memory_order_release);
+
+      usage = usage - old_entry_p->charge + charge;
+      em_p->AddGarbageNode(old_entry_p);
+    } else {
+      std::atomic<Entry *> *bucket_p = GetBucket(key);
+
+      new_entry_p->next_p.store(bucket_p->load(std::memory_order_relaxed),
+                                std::memory_order_relaxed);
+      new_entry_p->slot = ring.size();
+      ring.push_back(new_entry_p);
+
+      bucket_p->store(new_entry_p, std::memory_order_release);
+
+      usage += charge;
+    }
+
+    while(usage > capacity) {
+      Evict(new_entry_p);
+    }
+
+    return true;
+  }
+
+  /*
+   * Delete() - Removes a key from the cache
+   *
+   * Returns false if the key is not in the cache
+   */
+  bool Delete(const KeyType &key) {
+    std::lock_guard<std::mutex> guard{write_lock};
+
+    std::atomic<Entry *> *prev_p = FindPrev(key);
+    if(prev_p == nullptr) {
+      return false;
+    }
+
+    Unlink(prev_p);
+
+    return true;
+  }
+
+  /*
+   * GetCapacity() - Returns the maximum total charge
+   */
+  inline uint64_t GetCapacity() const {
+    return capacity;
+  }
+
+  /*
+   * GetUsage() / GetEntryCount() / GetEvictionCount() - Returns statistics
+   *
+   * These are only accurate if there is no concurrent writer
+   */
+  inline uint64_t GetUsage() const {
+    return usage;
+  }
+
+  inline uint64_t GetEntryCount() const {
+    return ring.size();
+  }
+
+  inline uint64_t GetEvictionCount() const {
+    return eviction_count;
+  }
+};
+
+} // namespace index
+} // namespace peloton
+
+#endif
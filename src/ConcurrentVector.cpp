@@ -0,0 +1,2 @@
+
+#include "ConcurrentVector.h"
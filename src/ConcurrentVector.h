@@ -0,0 +1,349 @@
+#pragma once
+
+#ifndef _CONCURRENT_VECTOR_H
+#define _CONCURRENT_VECTOR_H
+
+#include "common.h"
+
+namespace peloton {
+namespace index {
+
+/*
+ * class ConcurrentVector - A lock-free growable array supporting
+ *                          concurrent PushBack() and indexed access
+ *
+ * Elements live in fixed size segments which never move once allocated,
+ * and a directory (i.e. array of segment pointers) maps an index to its
+ * segment. Segments are allocated lazily: the first thread that touches a
+ * segment allocates it and installs it into its slot of the directory 
+ * with CAS, so a segment is only allocated once. When the directory is 
+ * full a thread allocates a directory twice as large, copies segment 
+ * pointers into it and installs it with CAS. Only pointers are copied, so
+ * threads that lose the CAS waste little work. Empty slots of the old 
+ * directory are filled before copying, such that a segment installed 
+ * into an old directory is never lost. The old directory is retired
+ * through the EM, since readers might still be using it to locate
+ * segments. Since segment pointers are immutable once installed the 
+ * migration never races with element updates, and Set() / 
+ * CompareExchange() on elements are never lost during growth, which is
+ * what mapping tables need
+ *
+ * Readers only do two dependent loads and no RMW. The caller is responsible
+ * for maintaining epoch counters outside each call. Type T is stored in
+ * std::atomic and must be trivially copyable. Slots that are claimed but
+ * not yet written hold T{}
+ */
+template <typename T,
+          template <typename> class EMTemplate>
+class ConcurrentVector {
+ private:
+
+  /*
+   * class Directory - Array of segment pointers
+   *
+   * Segments are shared between directories, so the destructor does not
+   * free them. A slot is nullptr until its segment is installed
+   */
+  class Directory {
+   public:
+    uint64_t segment_num;
+    std::atomic<std::atomic<T> *> *segment_list;
+
+    /*
+     * Constructor
+     */
+    Directory(uint64_t p_segment_num) :
+      segment_num{p_segment_num} {
+      segment_list = new std::atomic<std::atomic<T> *>[segment_num];
+
+      for(uint64_t i = 0;i < segment_num;i++) {
+        segment_list[i].store(nullptr, std::memory_order_relaxed);
+      }
+
+      return;
+    }
+
+    /*
+     * Destructor - Frees the array of pointers but not segments
+     */
+    ~Directory() {
+      delete[] segment_list;
+
+      return;
+    }
+  };
+
+ public:
+  // The EM should be instanciated with this type
+  using DirectoryType = Directory;
+  using EMType = EMTemplate<DirectoryType>;
+
+ private:
+  // Number of elements per segment is 2 ^ segment_shift
+  uint64_t segment_shift;
+  uint64_t segment_mask;
+
+  // Number of indices claimed by PushBack()
+  std::atomic<uint64_t> size;
+
+  std::atomic<Directory *> directory_p;
+
+  // Old directories go here
+  EMType *em_p;
+
+ private:
+
+  /*
+   * AllocateSegment() - Allocates a segment with all elements being T{}
+   */
+  std::atomic<T> *AllocateSegment() const {
+    uint64_t segment_size = segment_mask + 1;
+    std::atomic<T> *segment_p = new std::atomic<T>[segment_size];
+
+    for(uint64_t i = 0;i < segment_size;i++) {
+      segment_p[i].store(T{}, std::memory_order_relaxed);
+    }
+
+    return segment_p;
+  }
+
+  /*
+   * GetSegment() - Returns the segment of a slot of a directory, and 
+   *                installs a new segment if there is none
+   *
+   * If another thread installs a segment first ours is freed, which was
+   * never visible
+   */
+  std::atomic<T> *GetSegment(Directory *dir_p, uint64_t segment_index) {
+    std::atomic<std::atomic<T> *> *slot_p = \
+      dir_p->segment_list + segment_index;
+
+    std::atomic<T> *segment_p = slot_p->load(std::memory_order_acquire);
+    if(likely(segment_p != nullptr)) {
+      return segment_p;
+    }
+
+    std::atomic<T> *new_segment_p = AllocateSegment();
+    if(slot_p->compare_exchange_strong(segment_p,
+                                       new_segment_p,
+                                       std::memory_order_acq_rel,
+                                       std::memory_order_acquire) == true) {
+      return new_segment_p;
+    }
+
+    delete[] new_segment_p;
+
+    return segment_p;
+  }
+
+  /*
+   * Grow() - Doubles the directory if it is still the given one
+   *
+   * Returns the current directory after growing, which is either ours or
+   * installed by another thread. Slots of the old directory are filled 
+   * first, so after that no thread could install a segment into it that
+   * is missing from the copy
+   */
+  Directory *Grow(Directory *old_directory_p) {
+    uint64_t old_segment_num = old_directory_p->segment_num;
+
+    for(uint64_t i = 0;i < old_segment_num;i++) {
+      GetSegment(old_directory_p, i);
+    }
+
+    Directory *new_directory_p = new Directory{old_segment_num * 2};
+
+    for(uint64_t i = 0;i < old_segment_num;i++) {
+      new_directory_p->segment_list[i].store(
+        old_directory_p->segment_list[i].load(std::memory_order_acquire),
+        std::memory_order_relaxed);
+    }
+
+    Directory *expected_p = old_directory_p;
+    if(directory_p.compare_exchange_strong(expected_p,
+                                           new_directory_p,
+                                           std::memory_order_acq_rel,
+                                           std::memory_order_acquire) == true) {
+      em_p->AddGarbageNode(old_directory_p);
+
+      return new_directory_p;
+    }
+
+    // Another thread has grown the directory. Ours only shares segments
+    // with the old directory
+    delete new_directory_p;
+
+    return expected_p;
+  }
+
+  /*
+   * GetDirectory() - Returns the current directory after growing it to
+   *                  cover a segment
+   */
+  Directory *GetDirectory(uint64_t segment_index) {
+    Directory *dir_p = directory_p.load(std::memory_order_acquire);
+
+    while(segment_index >= dir_p->segment_num) {
+      dir_p = Grow(dir_p);
+    }
+
+    return dir_p;
+  }
+
+  /*
+   * GetSlot() - Returns the slot of an index, and installs its segment if
+   *             there is none
+   *
+   * The index must be within the capacity of the current directory
+   */
+  inline std::atomic<T> *GetSlot(uint64_t index) {
+    Directory *dir_p = directory_p.load(std::memory_order_acquire);
+    assert((index >> segment_shift) < dir_p->segment_num);
+
+    return GetSegment(dir_p, index >> segment_shift) + (index & segment_mask);
+  }
+
+ public:
+
+  /*
+   * Constructor - Segment size is rounded up to a power of 2
+   */
+  ConcurrentVector(EMType *p_em_p, uint64_t segment_size = 1024) :
+    segment_shift{0},
+    size{0},
+    em_p{p_em_p} {
+    while((0x1UL << segment_shift) < segment_size) {
+      segment_shift++;
+    }
+
+    segment_mask = (0x1UL << segment_shift) - 1;
+
+    Directory *dir_p = new Directory{1};
+    dir_p->segment_list[0].store(AllocateSegment());
+    directory_p.store(dir_p);
+
+    return;
+  }
+
+  /*
+   * Destructor - Frees all segments and the current directory
+   *
+   * Retired directories are freed by the EM
+   */
+  ~ConcurrentVector() {
+    Directory *dir_p = directory_p.load();
+
+    for(uint64_t i = 0;i < dir_p->segment_num;i++) {
+      delete[] dir_p->segment_list[i].load();
+    }
+
+    delete dir_p;
+
+    return;
+  }
+
+  // Disallow copying since the vector owns its segments
+  ConcurrentVector(const ConcurrentVector &) = delete;
+  ConcurrentVector &operator=(const ConcurrentVector &) = delete;
+
+  /*
+   * Reserve() - Grows the vector until its capacity is at least the given
+   *             number of elements, and allocates segments up to it
+   */
+  void Reserve(uint64_t capacity) {
+    if(capacity == 0) {
+      return;
+    }
+
+    uint64_t segment_num = ((capacity - 1) >> segment_shift) + 1;
+    Directory *dir_p = GetDirectory(segment_num - 1);
+
+    for(uint64_t i = 0;i < segment_num;i++) {
+      GetSegment(dir_p, i);
+    }
+
+    return;
+  }
+
+  /*
+   * PushBack() - Appends an element and returns its index
+   *
+   * Only the segment of the index is allocated if it is missing, so 
+   * threads crossing the capacity at the same time share new segments
+   */
+  uint64_t PushBack(const T &value) {
+    uint64_t index = size.fetch_add(1);
+    uint64_t segment_index = index >> segment_shift;
+
+    Directory *dir_p = GetDirectory(segment_index);
+    std::atomic<T> *segment_p = GetSegment(dir_p, segment_index);
+    segment_p[index & segment_mask].store(value, std::memory_order_release);
+
+    return index;
+  }
+
+  /*
+   * Get() - Returns the element at an index
+   *
+   * An index that has been claimed by PushBack() but not written yet,
+   * whose segment is not allocated yet, or is beyond the capacity, 
+   * returns T{}
+   */
+  inline T Get(uint64_t index) const {
+    Directory *dir_p = directory_p.load(std::memory_order_acquire);
+    if(unlikely((index >> segment_shift) >= dir_p->segment_num)) {
+      return T{};
+    }
+
+    std::atomic<T> *segment_p = \
+      dir_p->segment_list[index >> segment_shift].load(
+        std::memory_order_acquire);
+    if(unlikely(segment_p == nullptr)) {
+      return T{};
+    }
+
+    return segment_p[index & segment_mask].load(std::memory_order_acquire);
+  }
+
+  /*
+   * Set() - Stores an element at an index
+   *
+   * The index must be less than the capacity
+   */
+  inline void Set(uint64_t index, const T &value) {
+    GetSlot(index)->store(value, std::memory_order_release);
+
+    return;
+  }
+
+  /*
+   * CompareExchange() - CAS on the element at an index
+   *
+   * On failure expected is set to the current element
+   */
+  inline bool CompareExchange(uint64_t index, T &expected, const T &desired) {
+    return GetSlot(index)->compare_exchange_strong(expected, desired);
+  }
+
+  /*
+   * GetSize() - Returns the number of elements pushed
+   */
+  inline uint64_t GetSize() const {
+    return size.load();
+  }
+
+  /*
+   * GetCapacity() - Returns the number of elements that could be accessed
+   *                 without growing the directory
+   *
+   * Segments within the capacity could still be allocated on first access
+   */
+  inline uint64_t GetCapacity() const {
+    return directory_p.load()->segment_num << segment_shift;
+  }
+};
+
+} // namespace index
+} // namespace peloton
+
+#endif
@@ -0,0 +1,2 @@
+
+#include "DeferredAllocator.h"
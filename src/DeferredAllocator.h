@@ -0,0 +1,295 @@
+#pragma once
+
+#ifndef _DEFERRED_ALLOCATOR_H
+#define _DEFERRED_ALLOCATOR_H
+
+#include "common.h"
+
+#include <new>
+
+/*
+ * class DeferredFreeBatch - A batch of deferred frees that is retired into
+ *                           the EM as a single garbage node
+ *
+ * Each record carries the pointer and a type-erased deleter (i.e. a plain
+ * function pointer), such that objects of different types could share one
+ * batch. The destructor, which is called by the EM after the epoch has
+ * passed, runs all deleters. Batching amortizes the GarbageNode which the
+ * EM allocates for every AddGarbageNode() call
+ */
+class DeferredFreeBatch {
+ public:
+  // Number of records in a batch
+  static constexpr uint64_t BATCH_SIZE = 128;
+
+  using DeleterType = void (*)(void *);
+
+  /*
+   * class Record - A pointer and the function that frees it
+   */
+  class Record {
+   public:
+    void *ptr;
+    DeleterType deleter;
+  };
+
+  uint64_t count;
+  Record record_list[BATCH_SIZE];
+
+  /*
+   * Constructor
+   */
+  DeferredFreeBatch() :
+    count{0}
+  {}
+
+  /*
+   * Destructor - Frees all pointers in the batch
+   */
+  ~DeferredFreeBatch() {
+    for(uint64_t i = 0;i < count;i++) {
+      record_list[i].deleter(record_list[i].ptr);
+    }
+
+    return;
+  }
+
+  /*
+   * Add() - Adds a record, and returns true if the batch becomes full
+   */
+  inline bool Add(void *ptr, DeleterType deleter) {
+    assert(count < BATCH_SIZE);
+
+    record_list[count].ptr = ptr;
+    record_list[count].deleter = deleter;
+    count++;
+
+    return count == BATCH_SIZE;
+  }
+};
+
+/*
+ * class DeferredFreeContext - Collects deferred frees into batches and
+ *                             retires full batches into an EM
+ *
+ * The current batch is owned by whichever thread takes it with an atomic
+ * exchange, so concurrent callers never write into the same batch. If
+ * another thread installed a batch while we were holding ours, the one we
+ * take back out is retired as it is, even if not full. With a single
+ * writer (which is the common case) this never happens
+ *
+ * The context must be destroyed before the EM, since the destructor
+ * retires the last partial batch
+ */
+template <template <typename> class EMTemplate>
+class DeferredFreeContext {
+ public:
+  // The EM should be instanciated with this type
+  using BatchType = DeferredFreeBatch;
+  using EMType = EMTemplate<BatchType>;
+
+ private:
+  std::atomic<BatchType *> batch_p;
+
+  // Number of records in retired batches
+  std::atomic<uint64_t> deferred_count;
+
+  EMType *em_p;
+
+ private:
+
+  /*
+   * RetireBatch() - Retires a batch into the EM
+   */
+  void RetireBatch(BatchType *p) {
+    deferred_count.fetch_add(p->count);
+    em_p->AddGarbageNode(p);
+
+    return;
+  }
+
+  /*
+   * FreeRaw() - Deleter for memory from ::operator new
+   */
+  static void FreeRaw(void *p) {
+    ::operator delete(p);
+
+    return;
+  }
+
+  /*
+   * DeleteObject() - Deleter for objects allocated with new
+   */
+  template <typename T>
+  static void DeleteObject(void *p) {
+    delete static_cast<T *>(p);
+
+    return;
+  }
+
+ public:
+
+  /*
+   * Constructor
+   */
+  DeferredFreeContext(EMType *p_em_p) :
+    batch_p{nullptr},
+    deferred_count{0},
+    em_p{p_em_p}
+  {}
+
+  /*
+   * Destructor - Retires the current batch
+   */
+  ~DeferredFreeContext() {
+    Flush();
+
+    return;
+  }
+
+  // Disallow copying since allocators point to the context
+  DeferredFreeContext(const DeferredFreeContext &) = delete;
+  DeferredFreeContext &operator=(const DeferredFreeContext &) = delete;
+
+  /*
+   * Defer() - Calls the deleter on a pointer after all threads currently
+   *           in the epoch have left
+   */
+  void Defer(void *ptr, typename BatchType::DeleterType deleter) {
+    BatchType *p = batch_p.exchange(nullptr);
+    if(p == nullptr) {
+      p = new BatchType{};
+    }
+
+    if(p->Add(ptr, deleter) == true) {
+      RetireBatch(p);
+
+      return;
+    }
+
+    p = batch_p.exchange(p);
+    if(p != nullptr) {
+      RetireBatch(p);
+    }
+
+    return;
+  }
+
+  /*
+   * DeferFree() - Defers ::operator delete() on raw memory
+   */
+  inline void DeferFree(void *ptr) {
+    Defer(ptr, &FreeRaw);
+
+    return;
+  }
+
+  /*
+   * Retire() - Defers delete on an object of any type
+   */
+  template <typename T>
+  inline void Retire(T *ptr) {
+    Defer(ptr, &DeleteObject<T>);
+
+    return;
+  }
+
+  /*
+   * Flush() - Retires the current batch even if it is not full
+   */
+  void Flush() {
+    BatchType *p = batch_p.exchange(nullptr);
+    if(p == nullptr) {
+      return;
+    } else if(p->count == 0) {
+      delete p;
+
+      return;
+    }
+
+    RetireBatch(p);
+
+    return;
+  }
+
+  /*
+   * GetDeferredCount() - Returns the number of records retired so far,
+   *                      not including the current batch
+   */
+  inline uint64_t GetDeferredCount() const {
+    return deferred_count.load();
+  }
+};
+
+/*
+ * class DeferredAllocator - A standard allocator whose deallocate() is
+ *                           deferred through the EM
+ *
+ * This could be plugged into standard containers or node-based structures
+ * such that memory released by the writer stays readable by lock-free
+ * readers until they leave the epoch. Note that the allocator only makes
+ * reclamation safe; the container still has to publish changes atomically
+ * for readers to be lock-free. Allocators compare equal if they share the
+ * same context
+ */
+template <typename T,
+          template <typename> class EMTemplate>
+class DeferredAllocator {
+ public:
+  using value_type = T;
+  using ContextType = DeferredFreeContext<EMTemplate>;
+
+  // EMTemplate is a template template argument, so the default rebind of
+  // std::allocator_traits does not apply
+  template <typename U>
+  struct rebind {
+    using other = DeferredAllocator<U, EMTemplate>;
+  };
+
+  ContextType *context_p;
+
+  /*
+   * Constructor
+   */
+  DeferredAllocator(ContextType *p_context_p) :
+    context_p{p_context_p}
+  {}
+
+  /*
+   * Constructor - Rebinding from an allocator of another type
+   */
+  template <typename U>
+  DeferredAllocator(const DeferredAllocator<U, EMTemplate> &other) :
+    context_p{other.context_p}
+  {}
+
+  /*
+   * allocate() - Allocates memory for n objects
+   */
+  T *allocate(size_t n) {
+    return static_cast<T *>(::operator new(n * sizeof(T)));
+  }
+
+  /*
+   * deallocate() - Defers freeing the memory
+   */
+  void deallocate(T *p, size_t) {
+    context_p->DeferFree(p);
+
+    return;
+  }
+};
+
+template <typename T, typename U, template <typename> class EMTemplate>
+inline bool operator==(const DeferredAllocator<T, EMTemplate> &a,
+                       const DeferredAllocator<U, EMTemplate> &b) {
+  return a.context_p == b.context_p;
+}
+
+template <typename T, typename U, template <typename> class EMTemplate>
+inline bool operator!=(const DeferredAllocator<T, EMTemplate> &a,
+                       const DeferredAllocator<U, EMTemplate> &b) {
+  return a.context_p != b.context_p;
+}
+
+#endif
@@ -0,0 +1,2 @@
+
+#include "DeltaChainIndex.h"
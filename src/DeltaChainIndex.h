@@ -0,0 +1,499 @@
+#pragma once
+
+#ifndef _DELTA_CHAIN_INDEX_H
+#define _DELTA_CHAIN_INDEX_H
+
+#include "common.h"
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+namespace peloton {
+namespace index {
+
+/*
+ * class DeltaChainIndex - A compact key value index that reproduces the
+ *                         memory reclamation pattern of BwTree
+ *
+ * Keys are hash partitioned into a fixed number of pages. Each page is a
+ * slot in the mapping table pointing to a delta chain: insert and delete
+ * delta records are prepended to the chain using CAS on the mapping table,
+ * and the chain ends in a base node holding a sorted array of items. Once
+ * a chain grows beyond the consolidation threshold, the thread that made it
+ * so builds a new base node by replaying the chain, installs it with CAS,
+ * and retires the entire old chain to the EM as a single garbage node, just
+ * as BwTree does. There is no split or merge since pages never change
+ *
+ * Every node on a chain owns the rest of the chain, so deleting the head
+ * frees the whole chain. This lets the EM free a retired chain by calling
+ * operator delete on its head. The caller is responsible for maintaining
+ * epoch counters outside each call
+ */
+template <typename KeyType,
+          typename ValueType,
+          template <typename> class EMTemplate,
+          typename KeyComparator = std::less<KeyType>,
+          typename KeyHashFunc = std::hash<KeyType>>
+class DeltaChainIndex {
+ public:
+  // Type of items in base nodes
+  using KeyValuePair = std::pair<KeyType, ValueType>;
+
+  /*
+   * enum class NodeType - Type of nodes on the delta chain
+   */
+  enum class NodeType {
+    BaseNode,
+    InsertDelta,
+    DeleteDelta,
+  };
+
+  /*
+   * class DeltaNode - Common part of all nodes on the delta chain
+   *
+   * depth is the number of delta records from this node to the base node,
+   * which is 0 for base nodes
+   */
+  class DeltaNode {
+   public:
+    NodeType type;
+    int depth;
+    DeltaNode *next_p;
+
+    /*
+     * Constructor
+     */
+    DeltaNode(NodeType p_type, int p_depth, DeltaNode *p_next_p) :
+      type{p_type},
+      depth{p_depth},
+      next_p{p_next_p}
+    {}
+
+    /*
+     * Destructor - Frees the rest of the chain
+     *
+     * The recursion is bounded by the consolidation threshold
+     */
+    virtual ~DeltaNode() {
+      delete next_p;
+    }
+  };
+
+  // The EM should be instanciated with this type
+  using GarbageType = DeltaNode;
+  using EMType = EMTemplate<GarbageType>;
+
+ private:
+
+  /*
+   * class BaseNode - The node at the end of a chain with sorted items
+   */
+  class BaseNode : public DeltaNode {
+   public:
+    std::vector<KeyValuePair> item_list;
+
+    /*
+     * Constructor - Creates an empty base node
+     */
+    BaseNode() :
+      DeltaNode{NodeType::BaseNode, 0, nullptr},
+      item_list{}
+    {}
+  };
+
+  /*
+   * class InsertDelta - Records a key value pair being inserted
+   */
+  class InsertDelta : public DeltaNode {
+   public:
+    KeyType key;
+    ValueType value;
+
+    /*
+     * Constructor
+     */
+    InsertDelta(const KeyType &p_key,
+                const ValueType &p_value,
+                DeltaNode *p_next_p) :
+      DeltaNode{NodeType::InsertDelta, p_next_p->depth + 1, p_next_p},
+      key{p_key},
+      value{p_value}
+    {}
+  };
+
+  /*
+   * class DeleteDelta - Records a key being deleted
+   */
+  class DeleteDelta : public DeltaNode {
+   public:
+    KeyType key;
+
+    /*
+     * Constructor
+     */
+    DeleteDelta(const KeyType &p_key, DeltaNode *p_next_p) :
+      DeltaNode{NodeType::DeleteDelta, p_next_p->depth + 1, p_next_p},
+      key{p_key}
+    {}
+  };
+
+  // Number of slots in the mapping table
+  uint64_t page_num;
+
+  // Chains with this many delta records are consolidated
+  int consolidate_threshold;
+
+  // Each slot points to the head of the delta chain of a page
+  std::atomic<DeltaNode *> *mapping_table;
+
+  // Old chains are retired here
+  EMType *em_p;
+
+  // Number of successful consolidations; only changed on consolidation
+  std::atomic<uint64_t> consolidation_count;
+
+  KeyComparator key_cmp_obj;
+  KeyHashFunc key_hash_obj;
+
+ private:
+
+  /*
+   * KeyCmpLess() / KeyCmpEqual() - Compares keys using the comparator
+   */
+  inline bool KeyCmpLess(const KeyType &key1, const KeyType &key2) const {
+    return key_cmp_obj(key1, key2);
+  }
+
+  inline bool KeyCmpEqual(const KeyType &key1, const KeyType &key2) const {
+    return (key_cmp_obj(key1, key2) == false) &&
+           (key_cmp_obj(key2, key1) == false);
+  }
+
+  /*
+   * GetSlot() - Returns the mapping table slot a key is mapped to
+   */
+  inline std::atomic<DeltaNode *> *GetSlot(const KeyType &key) {
+    return &mapping_table[key_hash_obj(key) % page_num];
+  }
+
+  /*
+   * SearchChain() - Searches a key on a delta chain
+   *
+   * The newest delta record on the key decides the result. If there is
+   * none then we binary search the base node. If the key exists and
+   * value_p is not nullptr then the value is copied into it
+   */
+  bool SearchChain(const DeltaNode *node_p,
+                   const KeyType &key,
+                   ValueType *value_p) const {
+    while(1) {
+      switch(node_p->type) {
+        case NodeType::InsertDelta: {
+          const InsertDelta *insert_p = \
+            static_cast<const InsertDelta *>(node_p);
+
+          if(KeyCmpEqual(insert_p->key, key) == true) {
+            if(value_p != nullptr) {
+              *value_p = insert_p->value;
+            }
+
+            return true;
+          }
+
+          break;
+        }
+        case NodeType::DeleteDelta: {
+          const DeleteDelta *delete_p = \
+            static_cast<const DeleteDelta *>(node_p);
+
+          if(KeyCmpEqual(delete_p->key, key) == true) {
+            return false;
+          }
+
+          break;
+        }
+        case NodeType::BaseNode: {
+          const std::vector<KeyValuePair> &item_list = \
+            static_cast<const BaseNode *>(node_p)->item_list;
+
+          auto it = std::lower_bound(
+            item_list.begin(),
+            item_list.end(),
+            key,
+            [this](const KeyValuePair &item, const KeyType &search_key) {
+              return KeyCmpLess(item.first, search_key);
+            });
+
+          if((it == item_list.end()) ||
+             (KeyCmpEqual(it->first, key) == false)) {
+            return false;
+          }
+
+          if(value_p != nullptr) {
+            *value_p = it->second;
+          }
+
+          return true;
+        }
+        default:
+          assert(false);
+      } // switch type
+
+      node_p = node_p->next_p;
+    } // while(1)
+
+    assert(false);
+    return false;
+  }
+
+  /*
+   * Consolidate() - Replays a delta chain into a new base node and installs
+   *                 it into the given slot
+   *
+   * Delta records are collected from the newest to the oldest, such that
+   * only the newest record on each key is kept. They are then sorted and
+   * merged with the items of the base node
+   *
+   * If CAS fails then another thread has changed the chain, and we just
+   * give up since the next modification will try again
+   */
+  void Consolidate(std::atomic<DeltaNode *> *slot_p, DeltaNode *head_p) {
+    // The second component is nullptr for delete delta
+    std::vector<std::pair<KeyType, const ValueType *>> delta_list{};
+    delta_list.reserve(head_p->depth);
+
+    const DeltaNode *node_p = head_p;
+    while(node_p->type != NodeType::BaseNode) {
+      const KeyType *key_p;
+      const ValueType *value_p;
+
+      if(node_p->type == NodeType::InsertDelta) {
+        const InsertDelta *insert_p = static_cast<const InsertDelta *>(node_p);
+        key_p = &insert_p->key;
+        value_p = &insert_p->value;
+      } else {
+        key_p = &static_cast<const DeleteDelta *>(node_p)->key;
+        value_p = nullptr;
+      }
+
+      // Chains are short, so linear search is fine
+      bool seen = false;
+      for(const auto &delta : delta_list) {
+        if(KeyCmpEqual(delta.first, *key_p) == true) {
+          seen = true;
+          break;
+        }
+      }
+
+      if(seen == false) {
+        delta_list.emplace_back(*key_p, value_p);
+      }
+
+      node_p = node_p->next_p;
+    }
+
+    std::sort(delta_list.begin(),
+              delta_list.end(),
+              [this](const std::pair<KeyType, const ValueType *> &a,
+                     const std::pair<KeyType, const ValueType *> &b) {
+                return KeyCmpLess(a.first, b.first);
+              });
+
+    const std::vector<KeyValuePair> &old_item_list = \
+      static_cast<const BaseNode *>(node_p)->item_list;
+
+    BaseNode *base_p = new BaseNode{};
+    base_p->item_list.reserve(old_item_list.size() + delta_list.size());
+
+    auto old_it = old_item_list.begin();
+    auto delta_it = delta_list.begin();
+
+    while((old_it != old_item_list.end()) || (delta_it != delta_list.end())) {
+      if((delta_it == delta_list.end()) ||
+         ((old_it != old_item_list.end()) &&
+          (KeyCmpLess(old_it->first, delta_it->first) == true))) {
+        base_p->item_list.push_back(*old_it);
+        old_it++;
+
+        continue;
+      }
+
+      // The delta overrides the item with the same key in the base node
+      if((old_it != old_item_list.end()) &&
+         (KeyCmpEqual(old_it->first, delta_it->first) == true)) {
+        old_it++;
+      }
+
+      if(delta_it->second != nullptr) {
+        base_p->item_list.emplace_back(delta_it->first, *delta_it->second);
+      }
+
+      delta_it++;
+    }
+
+    if(slot_p->compare_exchange_strong(head_p, base_p) == true) {
+      // The whole chain is freed when the head is freed
+      em_p->AddGarbageNode(head_p);
+
+      consolidation_count.fetch_add(1);
+    } else {
+      delete base_p;
+    }
+
+    return;
+  }
+
+  /*
+   * InstallDelta() - Prepends a delta record to the chain of the slot
+   *
+   * Before each CAS we check whether the key exists on the chain we are
+   * about to prepend to, and give up if it does not match expected_exist.
+   * Returns true if the delta is installed
+   */
+  bool InstallDelta(std::atomic<DeltaNode *> *slot_p,
+                    DeltaNode *delta_p,
+                    const KeyType &key,
+                    bool expected_exist) {
+    DeltaNode *head_p = slot_p->load();
+
+    while(1) {
+      if(SearchChain(head_p, key, nullptr) != expected_exist) {
+        // The chain must not be freed with the delta
+        delta_p->next_p = nullptr;
+        delete delta_p;
+
+        return false;
+      }
+
+      delta_p->next_p = head_p;
+      delta_p->depth = head_p->depth + 1;
+
+      if(slot_p->compare_exchange_strong(head_p, delta_p) == true) {
+        break;
+      }
+    }
+
+    if(delta_p->depth >= consolidate_threshold) {
+      Consolidate(slot_p, delta_p);
+    }
+
+    return true;
+  }
+
+ public:
+
+  /*
+   * Constructor - Creates page_num empty pages
+   */
+  DeltaChainIndex(EMType *p_em_p,
+                  uint64_t p_page_num,
+                  int p_consolidate_threshold = 8) :
+    page_num{p_page_num},
+    consolidate_threshold{p_consolidate_threshold},
+    em_p{p_em_p},
+    consolidation_count{0},
+    key_cmp_obj{},
+    key_hash_obj{} {
+    assert(page_num > 0);
+    assert(consolidate_threshold > 0);
+
+    mapping_table = new std::atomic<DeltaNode *>[page_num];
+    for(uint64_t i = 0;i < page_num;i++) {
+      mapping_table[i].store(new BaseNode{});
+    }
+
+    return;
+  }
+
+  /*
+   * Destructor - Frees all chains in the mapping table
+   *
+   * This must be called in single threaded environment. Retired chains
+   * are freed by the EM
+   */
+  ~DeltaChainIndex() {
+    for(uint64_t i = 0;i < page_num;i++) {
+      delete mapping_table[i].load();
+    }
+
+    delete[] mapping_table;
+
+    return;
+  }
+
+  // Disallow copying since the index owns its chains
+  DeltaChainIndex(const DeltaChainIndex &) = delete;
+  DeltaChainIndex &operator=(const DeltaChainIndex &) = delete;
+
+  /*
+   * Insert() - Inserts a key value pair
+   *
+   * Returns false if the key already exists
+   */
+  bool Insert(const KeyType &key, const ValueType &value) {
+    std::atomic<DeltaNode *> *slot_p = GetSlot(key);
+
+    return InstallDelta(slot_p,
+                        new InsertDelta{key, value, slot_p->load()},
+                        key,
+                        false);
+  }
+
+  /*
+   * Delete() - Deletes a key
+   *
+   * Returns false if the key does not exist
+   */
+  bool Delete(const KeyType &key) {
+    std::atomic<DeltaNode *> *slot_p = GetSlot(key);
+
+    return InstallDelta(slot_p,
+                        new DeleteDelta{key, slot_p->load()},
+                        key,
+                        true);
+  }
+
+  /*
+   * GetValue() - Looks up a key and copies its value into the reference
+   *
+   * Returns false if the key does not exist
+   */
+  bool GetValue(const KeyType &key, ValueType &value) {
+    return SearchChain(GetSlot(key)->load(), key, &value);
+  }
+
+  /*
+   * GetConsolidationCount() - Returns the number of chains that have been
+   *                           consolidated and retired
+   */
+  inline uint64_t GetConsolidationCount() const {
+    return consolidation_count.load();
+  }
+
+  /*
+   * GetItemCount() - Consolidates every page and counts items in base nodes
+   *
+   * This must be called in single threaded environment, and is only used
+   * for testing
+   */
+  uint64_t GetItemCount() {
+    uint64_t count = 0;
+
+    for(uint64_t i = 0;i < page_num;i++) {
+      DeltaNode *head_p = mapping_table[i].load();
+      if(head_p->type != NodeType::BaseNode) {
+        Consolidate(&mapping_table[i], head_p);
+      }
+
+      count += static_cast<BaseNode *>(mapping_table[i].load())->item_list.size();
+    }
+
+    return count;
+  }
+};
+
+} // namespace index
+} // namespace peloton
+
+#endif
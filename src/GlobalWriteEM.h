@@ -17,7 +17,7 @@
 template<typename GarbageType>
 class GlobalWriteEM {
  public:
-  // Garbage collection interval (milliseconds)
+  // Default garbage collection interval (milliseconds)
   constexpr static int GC_INTERVAL = 50;
 
   /*
@@ -96,6 +96,10 @@ class GlobalWriteEM {
   // Otherwise it points to a thread created by EpochManager internally
   std::thread *thread_p;
 
+  // Number of milliseconds the GC thread sleeps between two epochs, which
+  // defaults to GC_INTERVAL
+  uint64_t gc_interval;
+
   // These two do not have to be hidden from benchmark since they are modified
   // in relative long time intervals
   size_t epoch_created;
@@ -134,6 +138,8 @@ class GlobalWriteEM {
     // This is used to notify the cleaner thread that it has ended
     exited_flag.store(false);
 
+    gc_interval = GC_INTERVAL;
+
     // It is not 0UL since we create an initial epoch on initialization
     epoch_created = 1UL;
     epoch_freed = 0UL;
@@ -247,7 +253,7 @@ class GlobalWriteEM {
    * NOTE: This function is called by worker threads so it has
    * to consider race conditions
    */
-  void AddGarbageNode(const GarbageType *node_p) {
+  void AddGarbageNode(GarbageType *node_p) {
     // We need to keep a copy of current epoch node
     // in case that this pointer is increased during
     // the execution of this function
@@ -439,7 +445,7 @@ class GlobalWriteEM {
   }
 
   /*
-   * ThreadFunc() - The cleaner thread executes this every GC_INTERVAL ms
+   * ThreadFunc() - The cleaner thread executes this every gc_interval ms
    *
    * This function exits when exit flag is set to true
    */
@@ -448,8 +454,8 @@ class GlobalWriteEM {
     while(HasExited() == false) {
       PerformGarbageCollection();
 
-      // Sleep for 50 ms
-      std::chrono::milliseconds duration{GC_INTERVAL};
+      // Sleep for gc_interval ms
+      std::chrono::milliseconds duration{gc_interval};
       std::this_thread::sleep_for(duration);
     }
 
@@ -468,6 +474,24 @@ class GlobalWriteEM {
     return;
   }
   
+  /*
+   * SetGCInterval() - Sets the number of milliseconds between two epochs
+   *
+   * This should be called before StartGCThread()
+   */
+  inline void SetGCInterval(uint64_t interval) {
+    gc_interval = interval;
+
+    return;
+  }
+
+  /*
+   * GetGCInterval() - As name suggests
+   */
+  inline uint64_t GetGCInterval() const {
+    return gc_interval;
+  }
+  
   /*
    * SignalExit() - Stop GC thread by writing to the boolean atomic variable
    */
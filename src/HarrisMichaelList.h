@@ -0,0 +1,192 @@
+#pragma once
+
+#ifndef _HARRIS_MICHAEL_LIST_H
+#define _HARRIS_MICHAEL_LIST_H
+
+#include "common.h"
+
+namespace peloton {
+namespace index {
+
+/*
+ * class HarrisMichaelList - Delete marks and the search loop of the
+ *                           Harris-Michael lock-free linked list
+ *
+ * The lowest bit of the next pointer of a node is its logical delete mark.
+ * This class only has static functions that operate on lists of a given
+ * node type, and is shared by AtomicListSet, AtomicHashMap (all nodes are
+ * on one split-ordered list) and AtomicSkipList (each level is a list).
+ * Since nodes and their links differ between them, the link of a node is
+ * given by link_func(node_p) which returns a reference to an atomic next
+ * pointer, and the position of a node relative to the search key is given
+ * by cmp_func(node_p), which returns negative if the node is before the
+ * search key, 0 if equal and positive if after
+ */
+template <typename NodeType>
+class HarrisMichaelList {
+ public:
+
+  /*
+   * class Cursor - The position found by TrySearch() and Search()
+   */
+  class Cursor {
+   public:
+    // The node owning prev_p, or the start node if prev_p is the start
+    // link
+    NodeType *pred_p;
+    // The link that points to curr_p
+    std::atomic<NodeType *> *prev_p;
+    // The first node not before the search key, or nullptr if the end of
+    // the list is reached
+    NodeType *curr_p;
+    // Result of cmp_func on curr_p, or 1 at the end of the list
+    int cmp;
+  };
+
+  /*
+   * IsMarked() / Mark() / Unmark() - Manipulates the delete mark bit which
+   *                                  is the lowest bit of the next pointer
+   */
+  static inline bool IsMarked(NodeType *p) {
+    return (reinterpret_cast<uint64_t>(p) & 0x1UL) != 0UL;
+  }
+
+  static inline NodeType *Mark(NodeType *p) {
+    return reinterpret_cast<NodeType *>(reinterpret_cast<uint64_t>(p) | 0x1UL);
+  }
+
+  static inline NodeType *Unmark(NodeType *p) {
+    return reinterpret_cast<NodeType *>(
+             reinterpret_cast<uint64_t>(p) & ~0x1UL);
+  }
+
+  /*
+   * TrySearch() - Walks the list from a start link to the first unmarked
+   *               node that is not before the search key
+   *
+   * start_node_p is the node owning the start link, and could be nullptr
+   * if the link is not in a node (e.g. the head pointer of a list).
+   * Marked nodes on the path are unlinked, and the thread whose CAS
+   * succeeds passes the node to retire_func(node_p), so each unlink is
+   * retired exactly once
+   *
+   * Returns false if the walk must be restarted, since the previous node
+   * has been marked or changed or unlinking failed. The caller decides
+   * where to restart from
+   */
+  template <typename LinkFunc, typename CmpFunc, typename RetireFunc>
+  static bool TrySearch(NodeType *start_node_p,
+                        std::atomic<NodeType *> *start_p,
+                        const LinkFunc &link_func,
+                        const CmpFunc &cmp_func,
+                        const RetireFunc &retire_func,
+                        Cursor *cursor_p) {
+    NodeType *pred_p = start_node_p;
+    std::atomic<NodeType *> *prev_p = start_p;
+    NodeType *curr_p = Unmark(prev_p->load());
+
+    while(1) {
+      if(curr_p == nullptr) {
+        *cursor_p = Cursor{pred_p, prev_p, nullptr, 1};
+
+        return true;
+      }
+
+      NodeType *next_p = link_func(curr_p).load();
+
+      // If the previous node is marked or has been changed then its next
+      // pointer will not equal curr_p, and we just restart
+      if(prev_p->load() != curr_p) {
+        return false;
+      }
+
+      if(IsMarked(next_p) == false) {
+        int cmp = cmp_func(curr_p);
+        if(cmp >= 0) {
+          *cursor_p = Cursor{pred_p, prev_p, curr_p, cmp};
+
+          return true;
+        }
+
+        pred_p = curr_p;
+        prev_p = &link_func(curr_p);
+        curr_p = next_p;
+      } else {
+        // Help unlinking the logically deleted node
+        NodeType *expected_p = curr_p;
+        next_p = Unmark(next_p);
+
+        if(prev_p->compare_exchange_strong(expected_p, next_p) == false) {
+          return false;
+        }
+
+        retire_func(curr_p);
+        curr_p = next_p;
+      }
+    } // while(1)
+
+    assert(false);
+    return false;
+  }
+
+  /*
+   * Search() - Same as TrySearch(), except that it restarts from the start
+   *            link until it succeeds
+   *
+   * The start link must be one that is never marked, e.g. the head pointer
+   * or the link of a node that is never deleted. Returns true if the node
+   * found compares equal to the search key
+   */
+  template <typename LinkFunc, typename CmpFunc, typename RetireFunc>
+  static bool Search(NodeType *start_node_p,
+                     std::atomic<NodeType *> *start_p,
+                     const LinkFunc &link_func,
+                     const CmpFunc &cmp_func,
+                     const RetireFunc &retire_func,
+                     Cursor *cursor_p) {
+    while(TrySearch(start_node_p,
+                    start_p,
+                    link_func,
+                    cmp_func,
+                    retire_func,
+                    cursor_p) == false) {}
+
+    return cursor_p->cmp == 0;
+  }
+
+  /*
+   * Lookup() - Walks the list from a node to the first unmarked node that
+   *            is not before the search key without writing shared memory
+   *
+   * Marked nodes are stepped over since they are still safe to read under
+   * epoch protection. Returns nullptr if there is no such node, and
+   * otherwise *cmp_p is the result of cmp_func on the node returned
+   */
+  template <typename LinkFunc, typename CmpFunc>
+  static NodeType *Lookup(NodeType *node_p,
+                          const LinkFunc &link_func,
+                          const CmpFunc &cmp_func,
+                          int *cmp_p) {
+    while(node_p != nullptr) {
+      NodeType *next_p = link_func(node_p).load();
+
+      if(IsMarked(next_p) == false) {
+        int cmp = cmp_func(node_p);
+        if(cmp >= 0) {
+          *cmp_p = cmp;
+
+          return node_p;
+        }
+      }
+
+      node_p = Unmark(next_p);
+    }
+
+    return nullptr;
+  }
+};
+
+} // namespace index
+} // namespace peloton
+
+#endif
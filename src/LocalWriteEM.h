@@ -5,8 +5,6 @@
 #define _LOCAL_WRITE_EM_H
 
 #include "common.h" 
- 
-static const size_t CACHE_LINE_SIZE = 64;
 
 template<typename GarbageType>
 class LocalWriteEMFactory;
@@ -74,6 +72,15 @@ class PaddedData {
  *
  * The template argument is the type of garbage node. We keep a 
  * pointer type to GarbageType in the garbage node.
+ *
+ * Per-core counters assume that an operation stays on the core it has
+ * announced until it finishes. For user-level tasks that could yield in the
+ * middle of an operation and resume on another worker thread, the EM also
+ * maintains a fixed number of task slots. A task acquires a TaskHandle,
+ * and brackets each critical section with AnnounceTaskEnter() and
+ * AnnounceTaskLeave() on its handle. The epoch stays pinned by the handle
+ * rather than by a core, so the task could migrate freely in between.
+ * Idle task slots do not hold back GC
  */
 template<typename GarbageType>
 class LocalWriteEM {
@@ -84,6 +91,21 @@ class LocalWriteEM {
   // This is a padded version of epoch counter
   using ElementType = PaddedData<std::atomic<CounterType>, CACHE_LINE_SIZE>;
   
+  // Value of a task slot not in a critical section
+  static constexpr CounterType IDLE_EPOCH = UINT64_MAX;
+  
+  /*
+   * class TaskHandle - Identifies the epoch slot owned by a user-level task
+   *
+   * The handle should be kept by the task (e.g. in its control block) and
+   * used by whichever thread the task is currently running on
+   */
+  class TaskHandle {
+   public:
+    // Index into the counter array; task slots follow per-core counters
+    uint64_t slot;
+  };
+  
  private:
 
   /*
@@ -140,6 +162,12 @@ class LocalWriteEM {
   // Number of cores this structure mainatains
   uint64_t core_num;
   
+  // Number of task slots after per-core counters
+  uint64_t task_num;
+  
+  // Whether a task slot has been acquired by a handle
+  std::atomic<bool> *task_used_list;
+  
   // This is the address we should call free() on
   void *alloc_p;
 
@@ -189,6 +217,12 @@ class LocalWriteEM {
   // This defaults to 50ms
   uint64_t gc_interval;
   
+  // Number of garbage nodes still in the garbage chain after the most
+  // recent DoGC(). It is only written by the GC thread, and read by others
+  // for statistical purposes, so it is not kept up-to-date by
+  // AddGarbageNode() which would add another contended counter
+  std::atomic<uint64_t> pending_node_count;
+  
   #ifndef NDEBUG
   // Under debug mode we keep a counter to record how many times 
   // FreeGarbageNode() is called by the GC thread
@@ -228,13 +262,14 @@ class LocalWriteEM {
    * prevent construction on unaligned address. Please use WriteLocalEMFactory 
    * class to allocate it in a cache aligned manner
    */
-  LocalWriteEM(uint64_t p_core_num) :
-    core_num{p_core_num} {
+  LocalWriteEM(uint64_t p_core_num, uint64_t p_task_num = 0) :
+    core_num{p_core_num},
+    task_num{p_task_num} {
     dbg_printf("C'tor for %lu cores called\n", core_num);
     
     // Store this for memory free
     // Allocate one more slot for alignment
-    alloc_p = malloc((core_num + 1) * CACHE_LINE_SIZE);
+    alloc_p = malloc((core_num + task_num + 1) * CACHE_LINE_SIZE);
     assert(alloc_p != nullptr);
     
     // Must align it to cache line boundary (64 byte typically)
@@ -245,6 +280,13 @@ class LocalWriteEM {
     for(size_t i = 0;i < core_num;i++) {
       per_core_counter_list_p[i]->store(0);
     }
+    
+    // Task slots start idle such that they do not block GC
+    task_used_list = new std::atomic<bool>[task_num];
+    for(size_t i = 0;i < task_num;i++) {
+      per_core_counter_list_p[core_num + i]->store(IDLE_EPOCH);
+      task_used_list[i].store(false);
+    }
 
     // Also set the current epoch to be 0
     epoch_counter->store(0);
@@ -260,6 +302,8 @@ class LocalWriteEM {
     
     gc_interval = 50;
     
+    pending_node_count.store(0);
+    
     #ifndef NDEBUG
     node_freed_count = 0;
     node_left_count = 0;
@@ -301,6 +345,8 @@ class LocalWriteEM {
     // aligned pointer
     free(alloc_p);
     
+    delete[] task_used_list;
+    
     return;
   }
   
@@ -400,6 +446,17 @@ class LocalWriteEM {
     return gc_interval;
   }
   
+  /*
+   * GetPendingNodeCount() - Returns the number of garbage nodes that are
+   *                         not yet freed after the most recent DoGC()
+   *
+   * Garbage added after that DoGC() is not counted. This is mainly used 
+   * to observe how long running worker threads delay reclamation
+   */
+  inline uint64_t GetPendingNodeCount() const {
+    return pending_node_count.load();
+  }
+  
   
   #ifndef NDEBUG
   
@@ -444,6 +501,83 @@ class LocalWriteEM {
     return;
   }
   
+  /*
+   * AcquireTaskHandle() - Claims an unused task slot for a user-level task
+   *
+   * Returns false if all task slots have been claimed
+   */
+  bool AcquireTaskHandle(TaskHandle &handle) {
+    for(uint64_t i = 0;i < task_num;i++) {
+      bool expected = false;
+      
+      if(task_used_list[i].load() == false && 
+         task_used_list[i].compare_exchange_strong(expected, true) == true) {
+        handle.slot = core_num + i;
+        
+        return true;
+      }
+    }
+    
+    return false;
+  }
+  
+  /*
+   * ReleaseTaskHandle() - Returns the task slot such that it could be
+   *                       claimed by another task
+   *
+   * The task must not be inside a critical section
+   */
+  void ReleaseTaskHandle(const TaskHandle &handle) {
+    assert(handle.slot >= core_num && handle.slot < core_num + task_num);
+    assert(per_core_counter_list_p[handle.slot]->load() == IDLE_EPOCH);
+    
+    task_used_list[handle.slot - core_num].store(false);
+    
+    return;
+  }
+  
+  /*
+   * AnnounceTaskEnter() - Pins the current epoch for a task
+   *
+   * Unlike per-core counters, a task slot goes from idle to the current
+   * epoch, so the GC thread might have read the idle value just before our
+   * store and computed a minimum epoch newer than ours. In that case the
+   * epoch counter must have been increased before the GC thread read our
+   * slot, so we read the epoch counter again after the store and announce
+   * the newer epoch until it is stable, after which anything we read could
+   * only be retired in an epoch the GC thread has not passed
+   */
+  inline void AnnounceTaskEnter(const TaskHandle &handle) {
+    assert(handle.slot >= core_num && handle.slot < core_num + task_num);
+    
+    std::atomic<CounterType> &counter = per_core_counter_list_p[handle.slot].data;
+    CounterType epoch = epoch_counter->load();
+    
+    while(1) {
+      counter.store(epoch);
+      
+      CounterType current_epoch = epoch_counter->load();
+      if(current_epoch == epoch) {
+        break;
+      }
+      
+      epoch = current_epoch;
+    }
+    
+    return;
+  }
+  
+  /*
+   * AnnounceTaskLeave() - Unpins the epoch of a task
+   */
+  inline void AnnounceTaskLeave(const TaskHandle &handle) {
+    assert(handle.slot >= core_num && handle.slot < core_num + task_num);
+    
+    per_core_counter_list_p[handle.slot]->store(IDLE_EPOCH);
+    
+    return;
+  }
+  
   /*
    * AddGarbageNode() - Adds a node whose deallocation will be delayed
    *
@@ -504,6 +638,33 @@ class LocalWriteEM {
     return epoch_counter->load();
   }
   
+  /*
+   * GetMinEpoch() - Returns the minimum epoch announced by all cores and
+   *                 tasks in critical sections
+   *
+   * Anything retired in an epoch less than the returned value could no
+   * longer be accessed by any thread. This is also used by components that
+   * stamp their own garbage with GetCurrentEpochCounter() instead of
+   * calling AddGarbageNode()
+   */
+  CounterType GetMinEpoch() const {
+    // We use this to remember the minimum number of cores
+    // If all counters are idle task slots then everything could be freed
+    CounterType min_epoch = IDLE_EPOCH;
+    
+    // Loop through counters for each core and each task slot and pick the 
+    // smaller one everytime
+    for(uint64_t i = 0;i < core_num + task_num;i++) {
+      CounterType counter = per_core_counter_list_p[i]->load();
+      
+      if(counter < min_epoch) {
+        min_epoch = counter; 
+      }
+    }
+    
+    return min_epoch;
+  }
+  
   /*
    * DoGC() - This is the main function for doing garbage collection
    *
@@ -520,18 +681,7 @@ class LocalWriteEM {
    * epoch counter increases could optionally differ from the GC pace
    */
   void DoGC() {
-    // We use this to remember the minimum number of cores
-    uint64_t min_epoch = per_core_counter_list_p[0]->load();
-    
-    // If there are more than 1 core then we just loop through
-    // counters for each core and pick the smaller one everytime
-    for(uint64_t i = 1;i < core_num;i++) {
-      uint64_t counter = per_core_counter_list_p[i]->load();
-      
-      if(counter < min_epoch) {
-        min_epoch = counter; 
-      }
-    }
+    uint64_t min_epoch = GetMinEpoch();
        
     // Now we have the miminum epoch which is the time <= the earlist thread
     // entering the system
@@ -540,11 +690,16 @@ class LocalWriteEM {
     // Load the head of the linked list
     GarbageNode *current_node_p = garbage_head_p.load();
     if(current_node_p == nullptr) {
+      pending_node_count.store(0);
+      
       return; 
     }
     
     GarbageNode *next_node_p = current_node_p->next_p;
     
+    // The head node is never freed in this function
+    uint64_t pending_count = 1;
+    
     while(next_node_p != nullptr) {
       CounterType next_counter = next_node_p->deleted_epoch;
       
@@ -565,9 +720,13 @@ class LocalWriteEM {
         // and check its next node
         current_node_p = next_node_p;
         next_node_p = next_node_p->next_p;  
+        
+        pending_count++;
       }
     }
     
+    pending_node_count.store(pending_count);
+    
     return;
   }
   
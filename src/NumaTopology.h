@@ -0,0 +1,254 @@
+
+#pragma once
+
+#ifndef _NUMA_TOPOLOGY_H
+#define _NUMA_TOPOLOGY_H
+
+#include "common.h"
+
+#include <fstream>
+#include <string>
+
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+/*
+ * class NumaTopology - Maps CPUs to NUMA nodes and binds memory to nodes
+ *
+ * The mapping is read from sysfs without libnuma. If sysfs does not have
+ * it, all CPUs are on node 0. Memory binding uses the mbind() system call
+ * with MPOL_PREFERRED, which only affects pages faulted in afterwards and
+ * falls back to other nodes when the preferred one is full
+ *
+ * Node IDs of the OS need not be contiguous (e.g. with offline or memory
+ * only nodes), so nodes are numbered densely from 0 in the order of their
+ * IDs, and all nodes in the interface are such indices. Only mbind() uses
+ * the ID of a node
+ */
+class NumaTopology {
+ public:
+  // The policy number from <numaif.h>
+  static constexpr int MPOL_PREFERRED_POLICY = 1;
+  static constexpr uint64_t PAGE_SIZE = 4096;
+
+ private:
+  uint64_t node_num;
+  std::vector<uint64_t> cpu_to_node;
+  // OS node ID of each node index
+  std::vector<uint64_t> node_id_list;
+  // Whether the topology is not read from the machine
+  bool simulated_flag;
+
+  /*
+   * ParseList() - Parses a sysfs list such as "0-3,8-11" into the numbers
+   *               in it in ascending order
+   */
+  static std::vector<uint64_t> ParseList(const std::string &list) {
+    std::vector<uint64_t> number_list{};
+
+    size_t start = 0;
+    while(start < list.size()) {
+      size_t end = list.find(',', start);
+      if(end == std::string::npos) {
+        end = list.size();
+      }
+
+      std::string range = list.substr(start, end - start);
+      size_t dash = range.find('-');
+
+      uint64_t first = std::stoul(range.substr(0, dash));
+      uint64_t last = first;
+      if(dash != std::string::npos) {
+        last = std::stoul(range.substr(dash + 1));
+      }
+
+      for(uint64_t i = first;i <= last;i++) {
+        number_list.push_back(i);
+      }
+
+      start = end + 1;
+    }
+
+    return number_list;
+  }
+
+  /*
+   * ReadList() - Reads a sysfs list file, and returns an empty list if it
+   *              does not exist or is empty
+   */
+  static std::vector<uint64_t> ReadList(const std::string &path) {
+    std::ifstream file{path};
+    if(file.good() == false) {
+      return std::vector<uint64_t>{};
+    }
+
+    std::string list;
+    std::getline(file, list);
+
+    return ParseList(list);
+  }
+
+ public:
+
+  /*
+   * Constructor - Reads the topology of the machine
+   *
+   * Nodes are listed by the "online" file under node_path, or "possible"
+   * if that does not exist. node_path is only changed for testing
+   */
+  NumaTopology(const std::string &node_path = "/sys/devices/system/node") :
+    node_num{0},
+    cpu_to_node{},
+    node_id_list{},
+    simulated_flag{false} {
+    node_id_list = ReadList(node_path + "/online");
+    if(node_id_list.empty() == true) {
+      node_id_list = ReadList(node_path + "/possible");
+    }
+
+    for(uint64_t node = 0;node < node_id_list.size();node++) {
+      std::vector<uint64_t> cpu_list = \
+        ReadList(node_path + "/node" +
+                 std::to_string(node_id_list[node]) +
+                 "/cpulist");
+
+      for(uint64_t cpu : cpu_list) {
+        if(cpu >= cpu_to_node.size()) {
+          cpu_to_node.resize(cpu + 1, 0);
+        }
+
+        cpu_to_node[cpu] = node;
+      }
+    }
+
+    node_num = node_id_list.size();
+    if(node_num == 0) {
+      node_num = 1;
+      node_id_list.push_back(0);
+    }
+
+    return;
+  }
+
+  /*
+   * Constructor - Simulates a topology where CPU i is on node
+   *               cpu_to_node[i]
+   *
+   * This is used for testing on machines with fewer nodes. Memory is not
+   * bound to simulated nodes
+   */
+  NumaTopology(const std::vector<uint64_t> &p_cpu_to_node) :
+    node_num{0},
+    cpu_to_node{p_cpu_to_node},
+    node_id_list{},
+    simulated_flag{true} {
+    for(uint64_t node : cpu_to_node) {
+      if(node + 1 > node_num) {
+        node_num = node + 1;
+      }
+    }
+
+    if(node_num == 0) {
+      node_num = 1;
+    }
+
+    for(uint64_t node = 0;node < node_num;node++) {
+      node_id_list.push_back(node);
+    }
+
+    return;
+  }
+
+  /*
+   * GetNodeNum() - Returns the number of nodes
+   */
+  inline uint64_t GetNodeNum() const {
+    return node_num;
+  }
+
+  /*
+   * GetNodeID() - Returns the OS node ID of a node
+   */
+  inline uint64_t GetNodeID(uint64_t node) const {
+    assert(node < node_num);
+
+    return node_id_list[node];
+  }
+
+  /*
+   * GetNode() - Returns the node of a CPU
+   */
+  inline uint64_t GetNode(uint64_t cpu) const {
+    if(cpu >= cpu_to_node.size()) {
+      return 0;
+    }
+
+    return cpu_to_node[cpu];
+  }
+
+  /*
+   * GetCurrentNode() - Returns the node of the CPU the caller runs on
+   *
+   * sched_getcpu() goes through the vDSO, so this does not enter the
+   * kernel. The thread could be migrated right after this returns, which
+   * only affects locality
+   */
+  inline uint64_t GetCurrentNode() const {
+    if(node_num == 1) {
+      return 0;
+    }
+
+    int cpu = sched_getcpu();
+    if(cpu < 0) {
+      return 0;
+    }
+
+    return GetNode(static_cast<uint64_t>(cpu));
+  }
+
+  /*
+   * BindToNode() - Prefers a node for pages of a memory region that are
+   *                not faulted in yet
+   *
+   * Only whole pages inside the region are bound. Nothing is done with a
+   * single node or a simulated topology. Returns false if mbind() fails,
+   * which is not an error for callers since the memory is still usable
+   */
+  bool BindToNode(void *p, size_t sz, uint64_t node) const {
+    assert(node < node_num);
+
+    if((node_num == 1) || (simulated_flag == true)) {
+      return true;
+    }
+
+    uint64_t start = (reinterpret_cast<uint64_t>(p) + PAGE_SIZE - 1) &
+                     ~(PAGE_SIZE - 1);
+    uint64_t end = (reinterpret_cast<uint64_t>(p) + sz) & ~(PAGE_SIZE - 1);
+    if(start >= end) {
+      return true;
+    }
+
+    // One bit per node ID
+    uint64_t node_id = node_id_list[node];
+    unsigned long node_mask[4] = {0, 0, 0, 0};
+    static constexpr uint64_t bit_num = sizeof(unsigned long) * 8;
+    if(node_id >= 4 * bit_num) {
+      return false;
+    }
+
+    node_mask[node_id / bit_num] = 1UL << (node_id % bit_num);
+
+    long ret = syscall(SYS_mbind,
+                       start,
+                       end - start,
+                       MPOL_PREFERRED_POLICY,
+                       node_mask,
+                       4 * bit_num + 1,
+                       0);
+
+    return ret == 0;
+  }
+};
+
+#endif
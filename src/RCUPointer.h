@@ -0,0 +1,146 @@
+#pragma once
+
+#ifndef _RCU_POINTER_H
+#define _RCU_POINTER_H
+
+#include "common.h"
+
+namespace peloton {
+namespace index {
+
+/*
+ * class RCUPointer - An atomic pointer to a read-mostly object whose old
+ *                    versions are reclaimed by the EM
+ *
+ * This is meant for objects that are read very frequently and replaced
+ * rarely (e.g. configurations and schemas). Unlike std::shared_ptr there
+ * is no reference count: Load() is a single acquire load, and the returned
+ * pointer stays valid as long as the caller stays in the epoch it entered
+ * before calling Load(). Writers never modify the object in place. Instead
+ * they install a new object with Store() or CompareExchange(), and the
+ * replaced object is retired through the EM. The caller is responsible for
+ * maintaining epoch counters around both readers and writers
+ *
+ * The pointer owns the object it points to, and all objects must be
+ * allocated with new
+ */
+template <typename T,
+          template <typename> class EMTemplate>
+class RCUPointer {
+ public:
+  // The EM should be instanciated with this type
+  using EMType = EMTemplate<T>;
+
+ private:
+  std::atomic<T *> ptr;
+
+  // Replaced objects go here
+  EMType *em_p;
+
+ public:
+
+  /*
+   * Constructor - Takes ownership of the initial object, which could be
+   *               nullptr
+   */
+  RCUPointer(EMType *p_em_p, T *p_ptr = nullptr) :
+    ptr{p_ptr},
+    em_p{p_em_p}
+  {}
+
+  /*
+   * Destructor - Frees the current object
+   *
+   * This must be called in single threaded environment. Replaced objects
+   * are freed by the EM
+   */
+  ~RCUPointer() {
+    delete ptr.load();
+
+    return;
+  }
+
+  // Disallow copying since the pointer owns the object
+  RCUPointer(const RCUPointer &) = delete;
+  RCUPointer &operator=(const RCUPointer &) = delete;
+
+  /*
+   * Load() - Returns the current object
+   *
+   * The object must not be modified, and must not be accessed after the
+   * caller leaves the epoch
+   */
+  inline T *Load() const {
+    return ptr.load(std::memory_order_acquire);
+  }
+
+  /*
+   * Store() - Installs a new object and retires the old one
+   */
+  void Store(T *new_p) {
+    T *old_p = ptr.exchange(new_p, std::memory_order_acq_rel);
+
+    if(old_p != nullptr) {
+      em_p->AddGarbageNode(old_p);
+    }
+
+    return;
+  }
+
+  /*
+   * CompareExchange() - Installs a new object if the current object is
+   *                     the expected one
+   *
+   * On success the expected object is retired and true is returned. On
+   * failure expected_p is set to the current object, and the new object is
+   * still owned by the caller
+   */
+  bool CompareExchange(T *&expected_p, T *new_p) {
+    T *old_p = expected_p;
+
+    if(ptr.compare_exchange_strong(expected_p,
+                                   new_p,
+                                   std::memory_order_acq_rel,
+                                   std::memory_order_acquire) == false) {
+      return false;
+    }
+
+    if(old_p != nullptr) {
+      em_p->AddGarbageNode(old_p);
+    }
+
+    return true;
+  }
+
+  /*
+   * Update() - Read-copy-update loop
+   *
+   * update_func takes a const pointer to the current object (which could
+   * be nullptr) and returns a new object allocated with new. If another
+   * writer installs an object in the meantime the new object is deleted,
+   * and update_func is called again on the latest object
+   */
+  template <typename UpdateFunc>
+  void Update(UpdateFunc &&update_func) {
+    T *old_p = Load();
+
+    while(1) {
+      T *new_p = update_func(static_cast<const T *>(old_p));
+
+      if(CompareExchange(old_p, new_p) == true) {
+        return;
+      }
+
+      // The object was never visible so just delete it
+      delete new_p;
+    }
+
+    assert(false);
+    return;
+  }
+};
+
+} // namespace index
+} // namespace peloton
+
+#endif
@@ -5,10 +5,75 @@
 #define _VAR_LEN_POOL_H
 
 #include "common.h"
+#include "LocalWriteEM.h"
+#include "ChunkProvider.h"
+#include "NumaTopology.h"
+
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
 
 /*
  * class VarLenPool - A memory allocator that groups smaller allocations
  *                    
+ * Allocations are bump allocated from the chunk at the appending tail. When
+ * a new chunk is appended the old tail is sealed, such that its reference
+ * count could only decrease from then on. Once a sealed chunk has no live
+ * allocation it is stamped with the current epoch of the EM, and
+ * ReclaimChunks() (called by the GC thread if there is one) walks the chunk
+ * list from scanning_head_p and frees stamped chunks whose epoch is older
+ * than all threads. Threads must announce their epochs on the EM around
+ * Allocate(), since a stale tail pointer could be used to allocate from a
+ * chunk that is being retired
+ *
+ * If the pool is constructed with thread slots, Allocate(sz, thread_id)
+ * bump allocates from a chunk owned by the slot without any atomic
+ * instruction. The owner counts its allocations privately and only adds
+ * them to the shared reference count when it seals the chunk, so the
+ * shared header is only touched on chunk exhaustion and by Free(). Owned
+ * chunks are linked in a per-slot list that is also walked by
+ * ReclaimChunks()
+ *
+ * Allocation sizes up to MAX_CLASS_SIZE are rounded up to size classes.
+ * Free(p, sz, thread_id) puts a block on a free list of the slot instead
+ * of decreasing the reference count, and Allocate(sz, thread_id) reuses
+ * blocks from it in place. The current epoch is recorded next to a freed
+ * block, outside of its memory, and the block is only reused after all 
+ * threads have left that epoch, since readers could still be reading it
+ * as with chunk reclamation
+ *
+ * Chunks are aligned to chunk_size so allocations carry no header. An
+ * allocation larger than half of a chunk gets a dedicated chunk of its own
+ *
+ * Reclaimed chunks of the standard size are kept in a bounded cache and
+ * handed out again before asking the provider for more memory. Chunks idle
+ * in the cache for a number of ReclaimChunks() rounds are decommitted
+ *
+ * There is one shared chunk list per NUMA node, and Allocate(sz) appends
+ * to the list of the node the caller runs on. Every chunk remembers its
+ * node and its memory is bound to it, including owned and large chunks.
+ * The cache hands out chunks of the same node first
+ *
+ * AllocateAligned() pads the bump offset to larger alignments, and New()
+ * and Delete() construct and destroy typed objects in the pool. Retire()
+ * destroys an object only after all threads have left the current epoch
+ *
+ * Reallocate() resizes the most recent allocation of a chunk in place by
+ * moving the bump offset, and allocates and copies otherwise
+ *
+ * If the pool is constructed with stats enabled, allocations and frees are
+ * counted in relaxed counters of thread slots, or of stripes shared by 
+ * threads using the shared list, which GetStats() sums up. Otherwise the
+ * hot path does not touch any counter. ScanChunks() walks all chunk lists
+ * for detailed diagnostics
+ *
+ * AllocateRegion() bump allocates objects that die together into chunks
+ * of the region of a thread slot. The region is tagged with the epoch it
+ * is started in. When it is released, either explicitly or by the next
+ * AllocateRegion() in a later epoch, its chunks are retired at once 
+ * without any per-object Free()
  */
 class VarLenPool {
  private:
@@ -19,9 +84,20 @@ class VarLenPool {
    * Reference count records how many chunks are allocated in this chunk
    * and offset records the next base address offset from the base of this
    * chunk for fast stack allocation 
+   *
+   * For an owned chunk the reference count wraps around below zero when
+   * other threads free memory before the owner seals the chunk, and it
+   * becomes exact again after sealing
    */
   class ChunkHeader {
    public:
+    // The offset of a chunk that is no longer the appending tail; no
+    // allocation could succeed after this is set
+    static constexpr uint32_t SEALED_OFFSET = UINT32_MAX;
+    // The offset of a chunk owned by a thread slot; the owner keeps the
+    // actual offset privately
+    static constexpr uint32_t OWNED_OFFSET = UINT32_MAX - 1;
+    
     uint32_t ref_count;
     uint32_t offset;
     
@@ -44,24 +120,14 @@ class VarLenPool {
     }
   };
   
-  class Chunk;
-  
-  /*
-   * class Mem - Represents the memory we actually allocate to caller
-   *
-   * We need to keep a backward reference to the chunk header in order to 
-   * decrease the reference count when it is freed
-   */
-  class Mem {
-   public:
-    Chunk *chunk_p;
-    // This points to the next available byte
-    char data[0]; 
-  };
-  
   /*
    * class Chunk - A consecutive memory region that is allocated in a 
    *               lock-free manner
+   *
+   * The chunk object is placed at the base of its region, which is aligned
+   * to chunk_size, and data follows right after it. Since every allocation
+   * starts within chunk_size bytes from the base, Free() finds the chunk by
+   * masking the pointer instead of reading a back pointer
    */
   class Chunk {
    public:
@@ -73,8 +139,10 @@ class VarLenPool {
     // The epoch that this chunk is deleted; this is the first epoch
     // when this chunk is safe for reclamation
     // Only valid if reference count == 0 and this chunk is not the most
-    // recent in the queue
-    uint64_t delete_epoch;
+    // recent in the queue. Chunks that are not deleted have UINT64_MAX
+    std::atomic<uint64_t> delete_epoch;
+    // The NUMA node the memory is bound to
+    uint64_t node;
     
     // Actual data being allocated
     char *data;
@@ -83,21 +151,50 @@ class VarLenPool {
     
     /*
      * Constructor
+     *
+     * sz is the size of the data region after the chunk object
      */
-    Chunk(size_t sz) :
-      header{ChunkHeader{0, 0}},
-      next_p{nullptr} {
-      data = new char[sz];
-      assert(data != nullptr);
+    Chunk(size_t sz, ChunkHeader p_header, uint64_t p_node) :
+      header{p_header},
+      next_p{nullptr},
+      node{p_node} {
+      data = reinterpret_cast<char *>(this + 1);
       
       // The end pointer
       end_data = data + sz;
       
-      delete_epoch = static_cast<decltype(delete_epoch)>(-1);
+      delete_epoch.store(UINT64_MAX);
       
       return;
     }
     
+    /*
+     * Seal() - Prevents further allocation from this chunk
+     *
+     * This is called by the thread that appended the next chunk, or by the
+     * owner of the chunk which passes the number of allocations it has made.
+     * Returns true if there is no live allocation in the chunk when it is
+     * sealed, in which case the caller should retire the chunk. Otherwise
+     * the last Free() retires it
+     */
+    bool Seal(uint32_t owned_count = 0) {
+      ChunkHeader expected_header = header.load();
+      
+      while(1) {
+        assert(expected_header.offset != ChunkHeader::SEALED_OFFSET);
+        
+        uint32_t ref_count = expected_header.ref_count + owned_count;
+        ChunkHeader new_header{ref_count, ChunkHeader::SEALED_OFFSET};
+        
+        if(header.compare_exchange_strong(expected_header, new_header) == true) {
+          return ref_count == 0;
+        }
+      }
+      
+      assert(false);
+      return false;
+    }
+    
     /*
      * Allocate() - Allocate a memory of size sz from this chunk
      *
@@ -105,15 +202,29 @@ class VarLenPool {
      * allocate from this chunk. Return the base address and increase 
      * ref count if it succeeds; o.w. it returns nullptr and nothing is changed
      *
-     * Note that sz already contains the 8 byte back ref pointer field
+     * The base address is padded to align, which is a power of two
      */
-    void *Allocate(size_t sz) {
+    void *Allocate(size_t sz, size_t align = ALIGNMENT) {
       ChunkHeader expected_header = header.load();
       
       // Either out of memory in this chunk or succeed
       while(1) {
-        // Note that sz already contains the 8 byte back ref pointer
-        uint32_t new_offset = expected_header.offset + sz;
+        // Another thread has appended a new chunk after this one
+        if(expected_header.offset == ChunkHeader::SEALED_OFFSET) {
+          return nullptr;
+        }
+        
+        // Owned chunks are never on the shared list
+        assert(expected_header.offset != ChunkHeader::OWNED_OFFSET);
+        
+        char *base = data + expected_header.offset;
+        if(align > ALIGNMENT) {
+          base = reinterpret_cast<char *>(
+                   (reinterpret_cast<uint64_t>(base) + align - 1) & 
+                   ~(align - 1));
+        }
+        
+        uint32_t new_offset = (base - data) + sz;
         
         // This is the base address for next allocation
         // This could not be larger than the end address + 1 of the
@@ -134,165 +245,2059 @@ class VarLenPool {
         
         // If the allocation is successful just return the address
         if(ret == true) {
-          // If CAS succeeds then we have reserved the space, and could
-          // use the header content just read from the chunk
-          Mem *mem_p = reinterpret_cast<Mem *>(data + expected_header.offset);
-          // Set the chunk backward pointer
-          mem_p->chunk_p = this;
-          
-          return reinterpret_cast<void *>(mem_p->data);
+          // If CAS succeeds then we have reserved the space
+          return reinterpret_cast<void *>(base);
         }
       } // while(1)
       
       assert(false);
       return nullptr;
     }
+    
+    /*
+     * Resize() - Moves the offset from old_offset to new_offset if the
+     *            allocation ending at old_offset is still the most recent
+     *
+     * Returns false if another allocation has been made after it, the
+     * chunk is sealed or owned, or new_offset does not fit. The reference
+     * count is not changed
+     */
+    bool Resize(uint32_t old_offset, uint32_t new_offset) {
+      if(data + new_offset > end_data) {
+        return false;
+      }
+      
+      ChunkHeader expected_header = header.load();
+      while(expected_header.offset == old_offset) {
+        ChunkHeader new_header{expected_header.ref_count, new_offset};
+        
+        // Only frees could have changed the header if this fails
+        if(header.compare_exchange_strong(expected_header, 
+                                          new_header) == true) {
+          return true;
+        }
+      }
+      
+      return false;
+    }
+  };
+  
+  /*
+   * class CachedChunk - The memory of a reclaimed chunk in the cache
+   */
+  class CachedChunk {
+   public:
+    void *p;
+    // The ReclaimChunks() round this chunk is cached
+    uint64_t round;
+    bool decommitted;
+    uint64_t node;
+  };
+  
+  /*
+   * class NodeList - The shared chunk list of a NUMA node
+   */
+  class NodeList {
+   public:
+    // This is the tail we append chunk to
+    std::atomic<Chunk *> appending_tail_p;
+    // This is the head we start scanning; only modified by ReclaimChunks()
+    Chunk *scanning_head_p;
   };
   
+  using NodeListType = PaddedData<NodeList, CACHE_LINE_SIZE>;
+  
   /*
-   * AllocateChunk() - Allocate a chunk of size at least sz, usually much
-   *                   more larger to amortize memory allocation cost
+   * PopCachedChunk() - Takes a chunk out of the cache for a node, or returns
+   *                    nullptr
    *
-   * This function allocates a chunk of size at least sz + 8 (one extra
-   * pointer for the extra backward reference), but if sz is lower than a
-   * threshold it falls back to malloc()
+   * A chunk of the node is preferred, the most recent one first since it
+   * is the least likely to have been decommitted. Otherwise a decommitted
+   * chunk of another node is taken and rebound, since its pages are faulted
+   * in again on the new node. Chunks of other nodes with resident pages
+   * are left for their own nodes
+   */
+  void *PopCachedChunk(uint64_t node) {
+    std::lock_guard<std::mutex> guard{cache_lock};
+    
+    for(size_t i = chunk_cache.size();i > 0;i--) {
+      if(chunk_cache[i - 1].node == node) {
+        void *p = chunk_cache[i - 1].p;
+        chunk_cache.erase(chunk_cache.begin() + (i - 1));
+        
+        return p;
+      }
+    }
+    
+    for(size_t i = 0;i < chunk_cache.size();i++) {
+      if(chunk_cache[i].decommitted == true) {
+        void *p = chunk_cache[i].p;
+        chunk_cache.erase(chunk_cache.begin() + i);
+        
+        topology_p->BindToNode(p, chunk_size, node);
+        
+        return p;
+      }
+    }
+    
+    return nullptr;
+  }
+  
+  /*
+   * NewChunk() - Allocates a chunk aligned to chunk_size whose data region
+   *              is sz bytes, and whose memory is bound to a node
+   */
+  Chunk *NewChunk(size_t sz, ChunkHeader header, uint64_t node) {
+    void *p = nullptr;
+    
+    if(sizeof(Chunk) + sz == chunk_size) {
+      p = PopCachedChunk(node);
+    }
+    
+    if(p == nullptr) {
+      p = provider_p->Allocate(sizeof(Chunk) + sz, chunk_size);
+      assert(p != nullptr);
+      
+      topology_p->BindToNode(p, sizeof(Chunk) + sz, node);
+    }
+    
+    reserved_bytes.fetch_add(sizeof(Chunk) + sz);
+    
+    return new (p) Chunk{sz, header, node};
+  }
+  
+  /*
+   * DeleteChunk() - Frees a chunk allocated by NewChunk()
+   */
+  void DeleteChunk(Chunk *chunk_p) {
+    size_t sz = sizeof(Chunk) + (chunk_p->end_data - chunk_p->data);
+    uint64_t node = chunk_p->node;
+    
+    reserved_bytes.fetch_sub(sz);
+    chunk_p->~Chunk();
+    
+    if(sz == chunk_size) {
+      std::lock_guard<std::mutex> guard{cache_lock};
+      
+      if(chunk_cache.size() < chunk_cache_size) {
+        chunk_cache.push_back(
+          CachedChunk{chunk_p, reclaim_round, false, node});
+        
+        return;
+      }
+    }
+    
+    provider_p->Free(chunk_p, sz);
+    
+    return;
+  }
+  
+  /*
+   * DecommitIdleChunks() - Starts a new round, and decommits cached chunks 
+   *                        that have been idle for at least decommit_round
+   *                        rounds
+   */
+  void DecommitIdleChunks() {
+    std::lock_guard<std::mutex> guard{cache_lock};
+    
+    reclaim_round++;
+    for(CachedChunk &cached_chunk : chunk_cache) {
+      if((cached_chunk.decommitted == false) && 
+         (reclaim_round - cached_chunk.round >= decommit_round)) {
+        provider_p->Decommit(cached_chunk.p, chunk_size);
+        cached_chunk.decommitted = true;
+        
+        decommit_count++;
+      }
+    }
+    
+    return;
+  }
+  
+  /*
+   * GetChunk() - Returns the chunk an allocation is from
+   */
+  inline Chunk *GetChunk(void *p) const {
+    return reinterpret_cast<Chunk *>(
+             reinterpret_cast<uint64_t>(p) & ~(chunk_size - 1));
+  }
+  
+  /*
+   * AllocateChunk() - Allocate a chunk of chunk_size and append it to the
+   *                   shared list of a node
    *
    * If CAS fails to append a Chunk object to the end of the delta chain then
    * return nullptr, and the caller thread should try to retry reloading the
    * appending head chunk pointer and then retry allocation. Otherwise
    * the newly allocated chunk pointer is returned as an indication of success
+   *
+   * tail_p is the appending tail the caller failed to allocate from, which
+   * is sealed after the new chunk becomes the tail
    */
-  Chunk *AllocateChunk(size_t sz) {
-    if(sz <= chunk_size) {
-      // This is the normal chunk size for any allocation size smaller
-      // than the chunk size
-      sz = chunk_size; 
-    }
-    
+  Chunk *AllocateChunk(Chunk *tail_p, uint64_t node) {
     // Allocate a new chunk object
-    Chunk *chunk_p = new Chunk{sz};
-    assert(chunk_p != nullptr);
+    Chunk *chunk_p = NewChunk(chunk_size - sizeof(Chunk), 
+                              ChunkHeader{0, 0}, 
+                              node);
     
     Chunk *expected_chunk = nullptr;
     
     // CAS. If it fails then some thread has already appended a new chunk
     // so instead we just retry
     bool ret = \
-      appending_tail_p.load()->next_p.compare_exchange_strong(expected_chunk, 
-                                                              chunk_p);
+      tail_p->next_p.compare_exchange_strong(expected_chunk, chunk_p);
     if(ret == false) {
-      delete chunk_p;
+      DeleteChunk(chunk_p);
       
       return nullptr;
     } 
     
+    chunk_count.fetch_add(1);
+    
     // This does not matter since we always CAS with expected being nullptr
     // before we change this pointer the CAS through appending_tail_p
     // would always fail
-    appending_tail_p.store(chunk_p);
+    node_list_p[node]->appending_tail_p.store(chunk_p);
+    
+    // Only the appending tail could be allocated from
+    if(tail_p->Seal() == true) {
+      RetireChunk(tail_p);
+    }
     
     return chunk_p;
   }
   
- public:
-  static const size_t ALIGNMENT = 8;
-   
+  class FreeList;
+  class Region;
+  class StatsBlock;
+  
   /*
-   * Allocate() - Allocates a 8 byte aligned memory with little alloc/free
-   *              overhead
+   * class ThreadSlot - The chunk owned by a thread and its private bump
+   *                    allocation state
    */
-  void *Allocate(size_t sz) {
-    // Promote it to the nearest 8 byte boundary
-    sz = (sz + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
-    assert((sz % ALIGNMENT == 0));
+  class ThreadSlot {
+   public:
+    // The chunk being allocated from; nullptr if there is none. This and
+    // the two counters below are only accessed by the owner
+    Chunk *chunk_p;
+    // Next allocation offset in the chunk
+    uint32_t offset;
+    // Number of allocations not yet added to the reference count
+    uint32_t alloc_count;
     
-    // For every chunk there is a 8 byte field pointer to
-    // the chunk it is from
-    sz += 8;
+    // The most recent chunk owned by this slot. Older chunks are linked
+    // through next_p and only unlinked by ReclaimChunks()
+    std::atomic<Chunk *> head_p;
     
-    // After this all allocation sizes are aligned and extended to hold
-    // the 8 byte pointer
+    // Free lists of all size classes and the minimum epoch they are
+    // checked against. Computing it scans all cores, so it is refreshed
+    // when the chunk is exhausted or after every REFRESH_INTERVAL times
+    // the head of a free list is not ready
+    FreeList *free_list_p;
+    uint64_t min_epoch;
+    uint64_t miss_count;
     
-    Chunk *chunk_p = appending_tail_p.load(); 
-    while(1) {
-      void *p = chunk_p->Allocate(sz);
-      if(p == nullptr) {
-        chunk_p = AllocateChunk(sz);
-        // If allocating new chunk failed - some thread must have
-        // already done that, so we just retry
-        if(chunk_p == nullptr) {
-          chunk_p = appending_tail_p.load();  
-        }
-        
-        continue;
-      }
-      
-      return p; 
+    // Chunks of the current region
+    Region *region_p;
+  };
+  
+  using SlotType = PaddedData<ThreadSlot, CACHE_LINE_SIZE>;
+  
+  /*
+   * AllocateLarge() - Allocates a dedicated chunk for an allocation larger
+   *                   than large_size
+   *
+   * The chunk is born sealed with one reference, so the Free() of the
+   * allocation retires it. It is pushed to large_head_p with CAS, and as
+   * with lists of thread slots ReclaimChunks() never unlinks the head
+   */
+  void *AllocateLarge(size_t sz) {
+    Chunk *chunk_p = NewChunk(sz, 
+                              ChunkHeader{1, ChunkHeader::SEALED_OFFSET},
+                              topology_p->GetCurrentNode());
+    
+    Chunk *head_p = large_head_p.load();
+    do {
+      chunk_p->next_p.store(head_p);
+    } while(large_head_p.compare_exchange_strong(head_p, chunk_p) == false);
+    
+    chunk_count.fetch_add(1);
+    
+    return reinterpret_cast<void *>(chunk_p->data);
+  }
+  
+  /*
+   * GetSizeClass() - Returns the size class of an allocation size, or
+   *                  CLASS_NUM if it is larger than all classes
+   */
+  static inline uint64_t GetSizeClass(size_t sz) {
+    // Class of sizes in 8 byte units
+    static const uint8_t class_list[MAX_CLASS_SIZE / ALIGNMENT + 1] = {
+      0, 0, 0, 1, 2, 3, 3, 4, 4, 
+      5, 5, 5, 5, 6, 6, 6, 6, 
+      7, 7, 7, 7, 7, 7, 7, 7, 
+      8, 8, 8, 8, 8, 8, 8, 8
+    };
+    
+    if(sz > MAX_CLASS_SIZE) {
+      return CLASS_NUM;
     }
     
-    assert(false);
-    return nullptr;
+    return class_list[(sz + ALIGNMENT - 1) / ALIGNMENT];
   }
   
   /*
-   * Free() - Frees a chunk of memory previously allocated
+   * GetAllocSize() - Returns the number of bytes taken from a chunk for
+   *                  an allocation
+   */
+  static inline size_t GetAllocSize(size_t sz) {
+    static const uint32_t class_size_list[CLASS_NUM] = {
+      16, 24, 32, 48, 64, 96, 128, 192, 256
+    };
+    
+    uint64_t size_class = GetSizeClass(sz);
+    if(size_class == CLASS_NUM) {
+      // Promote it to the nearest 8 byte boundary
+      sz = (sz + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    } else {
+      sz = class_size_list[size_class];
+    }
+    
+    assert((sz % ALIGNMENT == 0));
+    
+    return sz;
+  }
+  
+  /*
+   * class FreeEntry - A block on a free list and the epoch it is freed in
    *
-   * This function does lazy free - it could not directly reclaim memory
-   * but instead it decreases the reference count of the chunk this pointer
-   * lies in, and let the GC thread to compress unused chunks
+   * The entry is kept outside of the block, since readers that entered
+   * before the block is freed could still be reading it. The block is 
+   * still counted as allocated by its chunk while it is on the list
    */
-  void Free(void *p) {
-    // Go to the actual starting address of the allocated memory piece
-    Mem *mem_p = reinterpret_cast<Mem *>(p) - 1;
-    // Load the chunk header field at the header of the chunk
-    ChunkHeader header = mem_p->chunk_p->header.load();
+  class FreeEntry {
+   public:
+    void *p;
+    uint64_t free_epoch;
+  };
+  
+  /*
+   * class FreeList - A FIFO ring of freed blocks of one size class
+   *
+   * Blocks are appended at the tail, so their epochs never decrease from
+   * head to tail. The ring is only accessed by the owner of the slot. Its
+   * capacity is a power of two, starting from FREE_LIST_MIN_SIZE on the
+   * first free and doubling up to FREE_LIST_LIMIT
+   */
+  class FreeList {
+   public:
+    FreeEntry *entry_list_p;
+    uint64_t capacity;
+    // Index of the oldest entry
+    uint64_t head;
+    uint64_t count;
+  };
+  
+  /*
+   * GrowFreeList() - Doubles the capacity of a free list, and moves its 
+   *                  entries to the start of the new ring
+   */
+  static void GrowFreeList(FreeList *list_p) {
+    uint64_t capacity = list_p->capacity * 2;
+    if(capacity == 0) {
+      capacity = FREE_LIST_MIN_SIZE;
+    }
     
-    // This must succeed - either the chunk becomes full and some thread
-    // creates a new chunk, st. no thread could modify the header causing
-    // CAS to fail, or it succeeds
-    while(1) {
-      // Decrease the ref count until succees
-      // If return false then header is updated to reflect the newest
-      // and we just retry always with ref_count - 1
-      bool ret = \
-        mem_p->chunk_p->header.compare_exchange_strong(header, 
-                                                       {header.ref_count - 1, 
-                                                        header.offset});
-      if(ret == true) {
-        // TODO: Refresh delete epoch here
-        //mem_p->chunk_p->delete_epoch = ...
+    FreeEntry *entry_list_p = new FreeEntry[capacity];
+    for(uint64_t i = 0;i < list_p->count;i++) {
+      entry_list_p[i] = \
+        list_p->entry_list_p[(list_p->head + i) & (list_p->capacity - 1)];
+    }
+    
+    delete[] list_p->entry_list_p;
+    list_p->entry_list_p = entry_list_p;
+    list_p->capacity = capacity;
+    list_p->head = 0;
+    
+    return;
+  }
+  
+  /*
+   * class Region - Chunks allocated to a thread slot for objects that are
+   *                released together
+   *
+   * Chunks of a region are linked through next_p in a private list, and
+   * are only put on the list of the slot when the region is released
+   */
+  class Region {
+   public:
+    // The most recent chunk of the region
+    Chunk *head_p;
+    // The chunk being bump allocated from, which is the most recent chunk
+    // of the standard size
+    Chunk *chunk_p;
+    uint64_t offset;
+    // The epoch the region is started in
+    uint64_t epoch;
+    // Number of objects allocated since the region is started, which are
+    // counted as freed when it is released
+    uint64_t object_count;
+  };
+  
+  /*
+   * NewRegionChunk() - Allocates a chunk whose data region is sz bytes and
+   *                    pushes it into a region
+   *
+   * The reference count is never used, since region chunks are retired
+   * without checking it
+   */
+  Chunk *NewRegionChunk(Region *region_p, size_t sz) {
+    Chunk *chunk_p = NewChunk(sz, 
+                              ChunkHeader{0, ChunkHeader::OWNED_OFFSET},
+                              topology_p->GetCurrentNode());
+    
+    chunk_p->next_p.store(region_p->head_p);
+    region_p->head_p = chunk_p;
+    
+    chunk_count.fetch_add(1);
+    
+    return chunk_p;
+  }
+  
+  /*
+   * RetireRegion() - Retires chunks of the region of a slot and moves them
+   *                  to the list of the slot
+   *
+   * The chunk being bump allocated from is carried into the next region,
+   * since the rest of it has never been handed out. Objects of the old
+   * region in it are just kept for longer. Retired chunks are linked 
+   * before they are published as the new head, so ReclaimChunks() always
+   * sees a complete list
+   */
+  void RetireRegion(ThreadSlot *slot_p, StatsBlock *stats_p) {
+    Region *region_p = slot_p->region_p;
+    
+    if(stats_flag == true) {
+      AddCounter(stats_p->free_count, region_p->object_count, true);
+    }
+    
+    region_p->object_count = 0;
+    
+    Chunk *retired_head_p = nullptr;
+    Chunk *retired_tail_p = nullptr;
+    
+    Chunk *chunk_p = region_p->head_p;
+    while(chunk_p != nullptr) {
+      Chunk *next_p = chunk_p->next_p.load();
+      
+      if(chunk_p != region_p->chunk_p) {
+        RetireChunk(chunk_p);
         
-        break; 
+        if(retired_tail_p == nullptr) {
+          retired_head_p = chunk_p;
+        } else {
+          retired_tail_p->next_p.store(chunk_p);
+        }
+        
+        retired_tail_p = chunk_p;
       }
-    } // while not successful
+      
+      chunk_p = next_p;
+    }
+    
+    region_p->head_p = region_p->chunk_p;
+    if(region_p->head_p != nullptr) {
+      region_p->head_p->next_p.store(nullptr);
+    }
+    
+    if(retired_head_p == nullptr) {
+      return;
+    }
+    
+    retired_tail_p->next_p.store(slot_p->head_p.load());
+    slot_p->head_p.store(retired_head_p);
     
     return;
   }
   
   /*
-   * Constructor
+   * PopFreeBlock() - Removes the head of a free list if all threads have
+   *                  left the epoch it is freed in, or returns nullptr
    */
-  VarLenPool(size_t p_chunk_size) :
-    chunk_size{p_chunk_size} {
-    // Allocate a chunk of standard size
-    scanning_head_p = new Chunk{chunk_size};
-    assert(scanning_head_p != nullptr);
+  static inline void *PopFreeBlock(ThreadSlot *slot_p, uint64_t size_class) {
+    FreeList *list_p = slot_p->free_list_p + size_class;
     
-    // This is the pointer to do CAS
-    appending_tail_p.store(scanning_head_p);  
+    if(list_p->count == 0) {
+      return nullptr;
+    }
+    
+    FreeEntry *entry_p = list_p->entry_list_p + list_p->head;
+    if(entry_p->free_epoch >= slot_p->min_epoch) {
+      slot_p->miss_count++;
       
-    return;
+      return nullptr;
+    }
+    
+    list_p->head = (list_p->head + 1) & (list_p->capacity - 1);
+    list_p->count--;
+    
+    return entry_p->p;
   }
-
- private:  
-  // This is the size of each chunk if the requested allocation size is
-  // less than this
-  uint64_t chunk_size;
   
-  // This is the tail we append chunk to
-  std::atomic<Chunk *> appending_tail_p;
-  // This is the head we start scanning
-  Chunk *scanning_head_p;
+  /*
+   * GetMinEpoch() - Returns the minimum epoch of all threads, or UINT64_MAX
+   *                 without an EM
+   */
+  inline uint64_t GetMinEpoch() {
+    if(em_p == nullptr) {
+      return UINT64_MAX;
+    }
+    
+    return em_p->GetMinEpoch();
+  }
+  
+  /*
+   * AllocateOwnedChunk() - Seals the current chunk of a slot if any, and
+   *                        pushes a new chunk into the slot
+   *
+   * Only the owner of the slot calls this, so the list head is updated
+   * with a plain store rather than CAS. The chunk is bound to the node the
+   * owner runs on
+   */
+  Chunk *AllocateOwnedChunk(ThreadSlot *slot_p) {
+    SealOwnedChunk(slot_p);
+    
+    Chunk *chunk_p = NewChunk(chunk_size - sizeof(Chunk), 
+                              ChunkHeader{0, ChunkHeader::OWNED_OFFSET},
+                              topology_p->GetCurrentNode());
+    
+    chunk_p->next_p.store(slot_p->head_p.load());
+    slot_p->head_p.store(chunk_p);
+    
+    slot_p->chunk_p = chunk_p;
+    slot_p->offset = 0;
+    slot_p->alloc_count = 0;
+    
+    chunk_count.fetch_add(1);
+    
+    return chunk_p;
+  }
+  
+  /*
+   * SealOwnedChunk() - Publishes the private allocation count of the
+   *                    current chunk of a slot and seals it
+   */
+  void SealOwnedChunk(ThreadSlot *slot_p) {
+    Chunk *chunk_p = slot_p->chunk_p;
+    if(chunk_p == nullptr) {
+      return;
+    }
+    
+    if(chunk_p->Seal(slot_p->alloc_count) == true) {
+      RetireChunk(chunk_p);
+    }
+    
+    slot_p->chunk_p = nullptr;
+    
+    return;
+  }
+  
+  /*
+   * ReclaimList() - Frees retired chunks in a list except the head
+   *
+   * The head is not freed since it could be read by the thread pushing
+   * a new chunk
+   */
+  uint64_t ReclaimList(Chunk *prev_p, uint64_t min_epoch) {
+    uint64_t freed_count = 0;
+    
+    Chunk *chunk_p = prev_p->next_p.load();
+    while(chunk_p != nullptr) {
+      Chunk *next_p = chunk_p->next_p.load();
+      
+      if(chunk_p->delete_epoch.load() < min_epoch) {
+        prev_p->next_p.store(next_p);
+        
+        DeleteChunk(chunk_p);
+        freed_count++;
+      } else {
+        prev_p = chunk_p;
+      }
+      
+      chunk_p = next_p;
+    }
+    
+    return freed_count;
+  }
+  
+  /*
+   * RetireChunk() - Stamps a sealed chunk without live allocation with the
+   *                 current epoch
+   *
+   * This is called exactly once for each chunk, either by Seal() or by the
+   * last Free(). Without an EM the chunk is stamped with epoch 0
+   */
+  void RetireChunk(Chunk *chunk_p) {
+    if(em_p == nullptr) {
+      chunk_p->delete_epoch.store(0);
+    } else {
+      chunk_p->delete_epoch.store(em_p->GetCurrentEpochCounter());
+    }
+    
+    return;
+  }
+  
+  /*
+   * ThreadFunc() - Body of the GC thread that reclaims chunks periodically
+   */
+  static void ThreadFunc(VarLenPool *pool_p) {
+    while(pool_p->exited_flag.load() == false) {
+      pool_p->ReclaimChunks();
+      
+      std::this_thread::sleep_for(std::chrono::milliseconds{pool_p->gc_interval});
+    }
+    
+    return;
+  }
+  
+ public:
+  static const size_t ALIGNMENT = 8;
+  
+  // Sizes larger than this are not rounded to size classes, and are never
+  // put on free lists
+  static const size_t MAX_CLASS_SIZE = 256;
+  static const uint64_t CLASS_NUM = 9;
+  
+  // Default maximum number of reclaimed chunks kept for reuse, and the
+  // default number of ReclaimChunks() rounds before a cached chunk is
+  // decommitted
+  static const uint64_t DEFAULT_CHUNK_CACHE_SIZE = 16;
+  static const uint64_t DEFAULT_DECOMMIT_ROUND = 20;
+  
+  // Maximum number of blocks on a free list. Further blocks are freed as
+  // with Free(p) such that a thread that only frees does not pin chunks
+  // forever. This should cover blocks freed by a thread in a few epochs,
+  // otherwise most allocations miss the list while it pins old chunks
+  static const uint64_t FREE_LIST_LIMIT = 16384;
+  
+  // Initial capacity of a free list, which must be a power of two as is
+  // FREE_LIST_LIMIT
+  static const uint64_t FREE_LIST_MIN_SIZE = 64;
+  
+  // Number of times the head of a free list is found not ready before the
+  // cached minimum epoch is refreshed
+  static const uint64_t REFRESH_INTERVAL = 64;
+  
+  // Number of counter stripes for threads that do not use thread slots.
+  // A thread claims one on its first allocation and gives it back when it
+  // exits. Threads beyond that share one block
+  static const uint64_t STATS_STRIPE_NUM = 64;
+  
+  // Number of buckets of the reference count histogram of ScanChunks()
+  static const uint64_t REF_HISTOGRAM_SIZE = 16;
+  
+  /*
+   * class Stats - Totals of counters returned by GetStats()
+   *
+   * Counters are summed without stopping other threads, so they could be
+   * slightly out of date with each other
+   */
+  class Stats {
+   public:
+    uint64_t alloc_count;
+    uint64_t free_count;
+    // Allocations not yet freed, including objects in regions not yet
+    // released
+    uint64_t live_count;
+    // Sum of sizes passed to allocation functions, and of sizes taken
+    // from chunks after rounding
+    uint64_t requested_bytes;
+    uint64_t allocated_bytes;
+    // Bytes of chunks not yet reclaimed, and of chunks in the cache
+    uint64_t reserved_bytes;
+    uint64_t cached_bytes;
+    uint64_t chunk_count;
+    // Allocations of each size class, and larger ones in the last entry
+    uint64_t class_count[CLASS_NUM + 1];
+  };
+  
+  /*
+   * class ChunkStats - The state of chunks found by ScanChunks()
+   *
+   * Chunks of regions not yet released are not on any list and are not
+   * included
+   */
+  class ChunkStats {
+   public:
+    // Shared tails and owned chunks not yet sealed
+    uint64_t active_chunk_count;
+    // Sealed chunks with live allocations, which are pinned by them
+    uint64_t sealed_chunk_count;
+    // Chunks waiting for the epoch to pass
+    uint64_t retired_chunk_count;
+    // Dedicated chunks of large allocations not yet retired
+    uint64_t large_chunk_count;
+    // Live allocations of sealed chunks and shared tails. Owned chunks 
+    // are not counted since their reference counts are not exact before
+    // sealing
+    uint64_t live_count;
+    // Bytes bump allocated from shared tails
+    uint64_t tail_used_bytes;
+    // Entry i is the number of sealed chunks whose live allocation count
+    // is within [2^i, 2^(i + 1)), and the last entry includes all larger
+    uint64_t ref_count_histogram[REF_HISTOGRAM_SIZE];
+  };
+  
+  // The EM whose epochs are used to stamp chunks. The EM itself never sees
+  // any chunk; this type is chosen only such that it is distinct from EMs
+  // used for other purposes
+  using ChunkType = Chunk;
+  using EMType = LocalWriteEM<ChunkType>;
+   
+  /*
+   * Allocate() - Allocates a 8 byte aligned memory with little alloc/free
+   *              overhead
+   *
+   * The memory comes from the shared list of the node the caller runs on
+   */
+  void *Allocate(size_t sz) {
+    // After this all allocation sizes are aligned
+    size_t alloc_sz = GetAllocSize(sz);
+    if(stats_flag == true) {
+      uint64_t stripe = GetStripe();
+      CountAllocation(stats_list_p + thread_num + stripe, 
+                      sz, 
+                      alloc_sz, 
+                      stripe != STATS_STRIPE_NUM);
+    }
+    
+    if(alloc_sz > large_size) {
+      return AllocateLarge(alloc_sz);
+    }
+    
+    return AllocateShared(alloc_sz, ALIGNMENT);
+  }
+  
+  /*
+   * AllocateAligned() - Allocates a memory aligned to align from the shared
+   *                     list of the node the caller runs on
+   *
+   * align must be a power of two no larger than half of a chunk. The size
+   * is rounded to its size class as in Allocate(), so the block could be
+   * passed to Reallocate() and the sized Free() of slots. Note that 
+   * Reallocate() only keeps ALIGNMENT alignment if the block moves
+   */
+  void *AllocateAligned(size_t sz, size_t align) {
+    assert((align & (align - 1)) == 0);
+    assert(align <= large_size);
+    
+    if(align <= ALIGNMENT) {
+      return Allocate(sz);
+    }
+    
+    size_t requested_sz = sz;
+    sz = GetAllocSize(sz);
+    if(stats_flag == true) {
+      uint64_t stripe = GetStripe();
+      CountAllocation(stats_list_p + thread_num + stripe, 
+                      requested_sz, 
+                      sz, 
+                      stripe != STATS_STRIPE_NUM);
+    }
+    
+    // Data of a chunk is at least ALIGNMENT aligned, so this is the most
+    // padding an allocation needs
+    if(sz + align - ALIGNMENT > large_size) {
+      return AlignLarge(sz, align);
+    }
+    
+    return AllocateShared(sz, align);
+  }
+  
+  /*
+   * AllocateAligned() - Allocates a memory aligned to align from the chunk
+   *                     owned by a thread slot
+   *
+   * This bumps the private offset as Allocate(sz, thread_id), but never
+   * reuses blocks on free lists. The same restrictions as AllocateAligned()
+   * of the shared list apply
+   */
+  void *AllocateAligned(size_t sz, size_t align, uint64_t thread_id) {
+    assert(thread_id < thread_num);
+    assert((align & (align - 1)) == 0);
+    assert(align <= large_size);
+    
+    if(align <= ALIGNMENT) {
+      return Allocate(sz, thread_id);
+    }
+    
+    size_t requested_sz = sz;
+    sz = GetAllocSize(sz);
+    if(stats_flag == true) {
+      CountAllocation(stats_list_p + thread_id, requested_sz, sz, true);
+    }
+    
+    if(sz + align - ALIGNMENT > large_size) {
+      return AlignLarge(sz, align);
+    }
+    
+    ThreadSlot *slot_p = &thread_slot_list_p[thread_id].data;
+    
+    Chunk *chunk_p = slot_p->chunk_p;
+    uint64_t padding = 0;
+    if(chunk_p != nullptr) {
+      padding = GetPadding(chunk_p->data + slot_p->offset, align);
+    }
+    
+    if((chunk_p == nullptr) || 
+       (chunk_p->data + slot_p->offset + padding + sz > chunk_p->end_data)) {
+      chunk_p = AllocateOwnedChunk(slot_p);
+      padding = GetPadding(chunk_p->data, align);
+    }
+    
+    slot_p->offset += padding;
+    void *p = reinterpret_cast<void *>(chunk_p->data + slot_p->offset);
+    
+    slot_p->offset += sz;
+    slot_p->alloc_count++;
+    
+    return p;
+  }
+  
+  /*
+   * New() - Allocates and constructs an object from the shared list
+   *
+   * The object is aligned to alignof(T), and must be destroyed with 
+   * Delete() or Retire()
+   */
+  template <typename T, typename... Args>
+  T *New(Args&&... args) {
+    void *p = AllocateAligned(sizeof(T), alignof(T));
+    
+    return new (p) T(std::forward<Args>(args)...);
+  }
+  
+  /*
+   * Delete() - Destroys an object created by New() and frees its memory
+   *
+   * The caller must guarantee no other thread is using the object
+   */
+  template <typename T>
+  void Delete(T *p) {
+    p->~T();
+    Free(p);
+    
+    return;
+  }
+  
+  /*
+   * Retire() - Destroys an object created by New() after all threads have
+   *            left the current epoch
+   *
+   * The object must already be unreachable by threads that enter later.
+   * Freed memory is only reused after the epoch it is freed in, so objects
+   * without a destructor are freed right away. Otherwise a record is put 
+   * on the retired list and ReclaimChunks() destroys the object once the
+   * epoch has passed. Without an EM that happens on the next call to
+   * ReclaimChunks()
+   */
+  template <typename T>
+  void Retire(T *p) {
+    if(std::is_trivially_destructible<T>::value == true) {
+      Free(p);
+      
+      return;
+    }
+    
+    // Records are not counted as allocations of the user
+    RetiredObject *object_p = static_cast<RetiredObject *>(
+      AllocateShared(GetAllocSize(sizeof(RetiredObject)), ALIGNMENT));
+    
+    object_p->p = p;
+    object_p->destroy_func = &DestroyObject<T>;
+    if(em_p == nullptr) {
+      object_p->retire_epoch = 0;
+    } else {
+      object_p->retire_epoch = em_p->GetCurrentEpochCounter();
+    }
+    
+    RetiredObject *head_p = retired_head_p.load();
+    do {
+      object_p->next_p = head_p;
+    } while(retired_head_p.compare_exchange_strong(head_p, object_p) == false);
+    
+    return;
+  }
+  
+ private:
+  
+  /*
+   * class StatsBlock - Counters of a thread slot or a stripe
+   *
+   * Counters only grow. Blocks of thread slots and stripes are only 
+   * written by their owners with relaxed loads and stores, and the shared
+   * block after stripes with relaxed fetch_add. Each block takes two cache
+   * lines of its own
+   */
+  class StatsBlock {
+   public:
+    std::atomic<uint64_t> alloc_count;
+    std::atomic<uint64_t> free_count;
+    std::atomic<uint64_t> requested_bytes;
+    std::atomic<uint64_t> allocated_bytes;
+    std::atomic<uint64_t> class_count[CLASS_NUM + 1];
+    
+   private:
+    char padding[2 * CACHE_LINE_SIZE - (4 + CLASS_NUM + 1) * 8];
+  };
+  
+  /*
+   * AddCounter() - Adds to a counter of a stats block
+   *
+   * The owner of a thread slot is the only writer, so it does not need an
+   * atomic read-modify-write
+   */
+  static inline void AddCounter(std::atomic<uint64_t> &counter, 
+                                uint64_t value, 
+                                bool owned_flag) {
+    if(owned_flag == true) {
+      counter.store(counter.load(std::memory_order_relaxed) + value,
+                    std::memory_order_relaxed);
+    } else {
+      counter.fetch_add(value, std::memory_order_relaxed);
+    }
+    
+    return;
+  }
+  
+  /*
+   * class StripeOwner - Claims a stripe for the thread it belongs to, and
+   *                     gives it back when the thread exits
+   *
+   * The same stripe is used in all pools. stripe is STATS_STRIPE_NUM if
+   * all stripes are taken
+   */
+  class StripeOwner {
+   public:
+    uint64_t stripe;
+    
+    /*
+     * Constructor
+     */
+    StripeOwner() {
+      for(stripe = 0;stripe < STATS_STRIPE_NUM;stripe++) {
+        if(GetStripeFlagList()[stripe].exchange(true) == false) {
+          break;
+        }
+      }
+      
+      return;
+    }
+    
+    /*
+     * Destructor
+     */
+    ~StripeOwner() {
+      if(stripe != STATS_STRIPE_NUM) {
+        GetStripeFlagList()[stripe].store(false);
+      }
+      
+      return;
+    }
+  };
+  
+  /*
+   * GetStripeFlagList() - Returns flags of stripes that are claimed
+   */
+  static std::atomic<bool> *GetStripeFlagList() {
+    static std::atomic<bool> flag_list[STATS_STRIPE_NUM];
+    
+    return flag_list;
+  }
+  
+  /*
+   * GetStripe() - Returns the stripe of the calling thread
+   */
+  static inline uint64_t GetStripe() {
+    static thread_local StripeOwner owner{};
+    
+    return owner.stripe;
+  }
+  
+  /*
+   * CountAllocation() - Counts an allocation in a stats block
+   */
+  static inline void CountAllocation(StatsBlock *stats_p, 
+                                     size_t requested_sz, 
+                                     size_t allocated_sz,
+                                     bool owned_flag) {
+    AddCounter(stats_p->alloc_count, 1, owned_flag);
+    AddCounter(stats_p->requested_bytes, requested_sz, owned_flag);
+    AddCounter(stats_p->allocated_bytes, allocated_sz, owned_flag);
+    AddCounter(stats_p->class_count[GetSizeClass(requested_sz)], 
+               1, 
+               owned_flag);
+    
+    return;
+  }
+  
+  /*
+   * AllocateShared() - Allocates sz bytes aligned to align from the shared
+   *                    list of the node the caller runs on
+   *
+   * sz plus the most padding must fit into an empty chunk
+   */
+  void *AllocateShared(size_t sz, size_t align) {
+    uint64_t node = topology_p->GetCurrentNode();
+    std::atomic<Chunk *> &appending_tail_p = \
+      node_list_p[node]->appending_tail_p;
+    
+    Chunk *chunk_p = appending_tail_p.load(); 
+    while(1) {
+      void *p = chunk_p->Allocate(sz, align);
+      if(p == nullptr) {
+        // If another thread has appended a new chunk then just retry on
+        // that chunk
+        Chunk *tail_p = appending_tail_p.load();
+        if(tail_p != chunk_p) {
+          chunk_p = tail_p;
+          
+          continue;
+        }
+        
+        chunk_p = AllocateChunk(tail_p, node);
+        // If allocating new chunk failed - some thread must have
+        // already done that, so we just retry
+        if(chunk_p == nullptr) {
+          chunk_p = appending_tail_p.load();  
+        }
+        
+        continue;
+      }
+      
+      return p; 
+    }
+    
+    assert(false);
+    return nullptr;
+  }
+  
+  /*
+   * AlignLarge() - Allocates a dedicated chunk with enough padding for an
+   *                aligned allocation
+   *
+   * align is no larger than large_size, so the result is still within
+   * chunk_size bytes from the base and GetChunk() works on it
+   */
+  void *AlignLarge(size_t sz, size_t align) {
+    char *p = reinterpret_cast<char *>(AllocateLarge(sz + align - ALIGNMENT));
+    
+    return reinterpret_cast<void *>(p + GetPadding(p, align));
+  }
+  
+  /*
+   * GetPadding() - Returns the number of bytes from an address to the next
+   *                address aligned to align
+   */
+  static inline uint64_t GetPadding(char *p, size_t align) {
+    uint64_t address = reinterpret_cast<uint64_t>(p);
+    
+    return ((address + align - 1) & ~(align - 1)) - address;
+  }
+  
+  /*
+   * class RetiredObject - An object whose destruction is deferred
+   *
+   * Records are allocated from the pool itself
+   */
+  class RetiredObject {
+   public:
+    void *p;
+    void (*destroy_func)(void *);
+    uint64_t retire_epoch;
+    RetiredObject *next_p;
+  };
+  
+  /*
+   * DestroyObject() - Runs the destructor of a retired object
+   */
+  template <typename T>
+  static void DestroyObject(void *p) {
+    static_cast<T *>(p)->~T();
+    
+    return;
+  }
+  
+  /*
+   * DestroyRetiredObjects() - Destroys and frees retired objects whose 
+   *                           epoch is less than min_epoch
+   *
+   * Newly retired objects are moved to the private pending list first. 
+   * Only the thread calling ReclaimChunks() calls this. Returns the number
+   * of objects destroyed
+   */
+  uint64_t DestroyRetiredObjects(uint64_t min_epoch) {
+    RetiredObject *object_p = retired_head_p.exchange(nullptr);
+    while(object_p != nullptr) {
+      RetiredObject *next_p = object_p->next_p;
+      
+      object_p->next_p = pending_head_p;
+      pending_head_p = object_p;
+      pending_count++;
+      
+      object_p = next_p;
+    }
+    
+    uint64_t destroyed_count = 0;
+    
+    RetiredObject **prev_p = &pending_head_p;
+    object_p = pending_head_p;
+    while(object_p != nullptr) {
+      RetiredObject *next_p = object_p->next_p;
+      
+      if(object_p->retire_epoch < min_epoch) {
+        *prev_p = next_p;
+        
+        object_p->destroy_func(object_p->p);
+        Free(object_p->p);
+        ReleaseBlock(object_p);
+        
+        destroyed_count++;
+      } else {
+        prev_p = &object_p->next_p;
+      }
+      
+      object_p = next_p;
+    }
+    
+    pending_count -= destroyed_count;
+    
+    return destroyed_count;
+  }
+  
+ public:
+  
+  /*
+   * Allocate() - Allocates from the chunk owned by a thread slot
+   *
+   * Only one thread could use a thread_id at a time, which is the same
+   * requirement as AnnounceEnter() of the EM. The fast path is either 
+   * reusing a block from the free list of the size class, or a plain bump
+   * of the private offset
+   */
+  void *Allocate(size_t sz, uint64_t thread_id) {
+    assert(thread_id < thread_num);
+    
+    ThreadSlot *slot_p = &thread_slot_list_p[thread_id].data;
+    
+    size_t requested_sz = sz;
+    sz = GetAllocSize(sz);
+    if(stats_flag == true) {
+      CountAllocation(stats_list_p + thread_id, requested_sz, sz, true);
+    }
+    
+    uint64_t size_class = GetSizeClass(requested_sz);
+    if(size_class != CLASS_NUM) {
+      void *p = PopFreeBlock(slot_p, size_class);
+      if(p != nullptr) {
+        return p;
+      }
+    }
+    
+    if(sz > large_size) {
+      return AllocateLarge(sz);
+    }
+    
+    Chunk *chunk_p = slot_p->chunk_p;
+    
+    if((chunk_p == nullptr) || 
+       (chunk_p->data + slot_p->offset + sz > chunk_p->end_data) ||
+       (slot_p->miss_count >= REFRESH_INTERVAL)) {
+      // Blocks freed since the last refresh might be reusable now
+      slot_p->min_epoch = GetMinEpoch();
+      slot_p->miss_count = 0;
+      
+      if(size_class != CLASS_NUM) {
+        void *p = PopFreeBlock(slot_p, size_class);
+        if(p != nullptr) {
+          return p;
+        }
+      }
+      
+      if((chunk_p == nullptr) || 
+         (chunk_p->data + slot_p->offset + sz > chunk_p->end_data)) {
+        chunk_p = AllocateOwnedChunk(slot_p);
+      }
+    }
+    
+    void *p = reinterpret_cast<void *>(chunk_p->data + slot_p->offset);
+    
+    slot_p->offset += sz;
+    slot_p->alloc_count++;
+    
+    return p;
+  }
+  
+  /*
+   * AllocateRegion() - Allocates from the region of a thread slot
+   *
+   * The memory must not be freed. It stays valid until the region is 
+   * released, and after that at least until all threads have left the 
+   * epoch it is released in. If the region was started in an earlier 
+   * epoch it is released here and a new region is started, so objects 
+   * allocated in one epoch must not be used after the thread announces a
+   * later epoch. The same thread_id requirement as Allocate(sz, thread_id)
+   * applies
+   */
+  void *AllocateRegion(size_t sz, uint64_t thread_id) {
+    assert(thread_id < thread_num);
+    
+    ThreadSlot *slot_p = &thread_slot_list_p[thread_id].data;
+    Region *region_p = slot_p->region_p;
+    
+    uint64_t epoch = 0;
+    if(em_p != nullptr) {
+      epoch = em_p->GetCurrentEpochCounter();
+    }
+    
+    if(region_p->epoch != epoch) {
+      RetireRegion(slot_p, stats_list_p + thread_id);
+      region_p->epoch = epoch;
+    }
+    
+    size_t requested_sz = sz;
+    sz = (sz + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    if(stats_flag == true) {
+      CountAllocation(stats_list_p + thread_id, requested_sz, sz, true);
+    }
+    region_p->object_count++;
+    
+    if(sz > large_size) {
+      return reinterpret_cast<void *>(NewRegionChunk(region_p, sz)->data);
+    }
+    
+    Chunk *chunk_p = region_p->chunk_p;
+    if((chunk_p == nullptr) || 
+       (chunk_p->data + region_p->offset + sz > chunk_p->end_data)) {
+      chunk_p = NewRegionChunk(region_p, chunk_size - sizeof(Chunk));
+      
+      region_p->chunk_p = chunk_p;
+      region_p->offset = 0;
+    }
+    
+    void *p = reinterpret_cast<void *>(chunk_p->data + region_p->offset);
+    region_p->offset += sz;
+    
+    return p;
+  }
+  
+  /*
+   * ReleaseRegion() - Releases the region of a thread slot in bulk
+   *
+   * This should be called by the owner when objects of the current region
+   * are no longer needed, e.g. at the end of a batch. The next 
+   * AllocateRegion() starts a new region
+   */
+  void ReleaseRegion(uint64_t thread_id) {
+    assert(thread_id < thread_num);
+    
+    RetireRegion(&thread_slot_list_p[thread_id].data, 
+                 stats_list_p + thread_id);
+    
+    return;
+  }
+  
+  /*
+   * ReleaseThreadChunk() - Seals the chunk owned by a thread slot such that
+   *                        it could be reclaimed once its memory is freed
+   *
+   * This should be called by the owner before it stops allocating from
+   * the pool for a long time. Blocks on free lists of the slot are given
+   * back to their chunks. The slot gets a new chunk on the next allocation
+   */
+  void ReleaseThreadChunk(uint64_t thread_id) {
+    assert(thread_id < thread_num);
+    
+    ThreadSlot *slot_p = &thread_slot_list_p[thread_id].data;
+    
+    for(uint64_t i = 0;i < CLASS_NUM;i++) {
+      FreeList *list_p = slot_p->free_list_p + i;
+      
+      for(uint64_t j = 0;j < list_p->count;j++) {
+        // The block is already counted as freed
+        ReleaseBlock(
+          list_p->entry_list_p[(list_p->head + j) & (list_p->capacity - 1)].p);
+      }
+      
+      list_p->head = 0;
+      list_p->count = 0;
+    }
+    
+    SealOwnedChunk(slot_p);
+    
+    return;
+  }
+  
+  /*
+   * Free() - Frees a block of a known size into the free list of a thread
+   *          slot such that it is reused by later allocations of the slot
+   *
+   * sz must be the size passed to Allocate(). The block could come from
+   * any slot or the shared tail. If sz does not fall into a size class or
+   * the free list is full this is the same as Free(p)
+   */
+  void Free(void *p, size_t sz, uint64_t thread_id) {
+    assert(thread_id < thread_num);
+    
+    if(stats_flag == true) {
+      AddCounter(stats_list_p[thread_id].free_count, 1, true);
+    }
+    
+    uint64_t size_class = GetSizeClass(sz);
+    if(size_class == CLASS_NUM) {
+      ReleaseBlock(p);
+      
+      return;
+    }
+    
+    ThreadSlot *slot_p = &thread_slot_list_p[thread_id].data;
+    FreeList *list_p = slot_p->free_list_p + size_class;
+    if(list_p->count == FREE_LIST_LIMIT) {
+      ReleaseBlock(p);
+      
+      return;
+    }
+    
+    if(list_p->count == list_p->capacity) {
+      GrowFreeList(list_p);
+    }
+    
+    FreeEntry *entry_p = \
+      list_p->entry_list_p + 
+      ((list_p->head + list_p->count) & (list_p->capacity - 1));
+    entry_p->p = p;
+    if(em_p == nullptr) {
+      entry_p->free_epoch = 0;
+    } else {
+      entry_p->free_epoch = em_p->GetCurrentEpochCounter();
+    }
+    
+    list_p->count++;
+    
+    return;
+  }
+  
+  /*
+   * Free() - Frees a chunk of memory previously allocated
+   *
+   * This function does lazy free - it could not directly reclaim memory
+   * but instead it decreases the reference count of the chunk this pointer
+   * lies in, and let the GC thread to compress unused chunks
+   */
+  void Free(void *p) {
+    if(stats_flag == true) {
+      uint64_t stripe = GetStripe();
+      AddCounter(stats_list_p[thread_num + stripe].free_count, 
+                 1, 
+                 stripe != STATS_STRIPE_NUM);
+    }
+    
+    ReleaseBlock(p);
+    
+    return;
+  }
+  
+ private:
+  
+  /*
+   * ReleaseBlock() - Decreases the reference count of the chunk of a block
+   *                  without counting it as a free
+   */
+  void ReleaseBlock(void *p) {
+    Chunk *chunk_p = GetChunk(p);
+    // Load the chunk header field at the header of the chunk
+    ChunkHeader header = chunk_p->header.load();
+    
+    // This must succeed - either the chunk becomes full and some thread
+    // creates a new chunk, st. no thread could modify the header causing
+    // CAS to fail, or it succeeds
+    while(1) {
+      // Decrease the ref count until succees
+      // If return false then header is updated to reflect the newest
+      // and we just retry always with ref_count - 1
+      bool ret = \
+        chunk_p->header.compare_exchange_strong(header, 
+                                                {header.ref_count - 1, 
+                                                 header.offset});
+      if(ret == true) {
+        // The last allocation in a sealed chunk is freed. No allocation 
+        // could happen on the chunk afterwards so retire it. Owned chunks
+        // are only checked after sealing when their count is exact
+        if((header.ref_count == 1) && 
+           (header.offset == ChunkHeader::SEALED_OFFSET)) {
+          RetireChunk(chunk_p);
+        }
+        
+        break; 
+      }
+    } // while not successful
+    
+    return;
+  }
+  
+  /*
+   * ScanList() - Adds the state of chunks in a list to stats
+   *
+   * A sealed chunk without live allocation is counted as retired, since 
+   * it is either retired or about to be
+   */
+  void ScanList(Chunk *chunk_p, ChunkStats *stats_p, bool large_flag) {
+    while(chunk_p != nullptr) {
+      ChunkHeader header = chunk_p->header.load();
+      
+      if((chunk_p->delete_epoch.load() != UINT64_MAX) || 
+         ((header.offset == ChunkHeader::SEALED_OFFSET) && 
+          (header.ref_count == 0))) {
+        stats_p->retired_chunk_count++;
+      } else if(large_flag == true) {
+        stats_p->large_chunk_count++;
+        stats_p->live_count += header.ref_count;
+      } else if(header.offset == ChunkHeader::OWNED_OFFSET) {
+        stats_p->active_chunk_count++;
+      } else if(header.offset != ChunkHeader::SEALED_OFFSET) {
+        stats_p->active_chunk_count++;
+        stats_p->live_count += header.ref_count;
+        stats_p->tail_used_bytes += header.offset;
+      } else {
+        stats_p->sealed_chunk_count++;
+        stats_p->live_count += header.ref_count;
+        
+        uint64_t bucket = 0;
+        while((bucket < REF_HISTOGRAM_SIZE - 1) && 
+              ((header.ref_count >> (bucket + 1)) != 0)) {
+          bucket++;
+        }
+        
+        stats_p->ref_count_histogram[bucket]++;
+      }
+      
+      chunk_p = chunk_p->next_p.load();
+    }
+    
+    return;
+  }
+  
+ public:
+  
+  /*
+   * Reallocate() - Resizes an allocation from the shared list
+   *
+   * old_sz must be the size the memory is allocated or last reallocated
+   * with, since allocations carry no header. If p is the most recent 
+   * allocation of the appending tail it is grown or shrunk in place with 
+   * a CAS on the offset. Otherwise a shrink returns p unchanged, and a 
+   * growth allocates new memory, copies old_sz bytes and frees p. Returns
+   * the new address. Blocks from AllocateAligned() are rounded the same 
+   * way, but a moved block is only ALIGNMENT aligned
+   */
+  void *Reallocate(void *p, size_t old_sz, size_t new_sz) {
+    if(p == nullptr) {
+      return Allocate(new_sz);
+    }
+    
+    size_t old_alloc_sz = GetAllocSize(old_sz);
+    size_t new_alloc_sz = GetAllocSize(new_sz);
+    if(new_alloc_sz <= large_size) {
+      Chunk *chunk_p = GetChunk(p);
+      uint32_t offset = reinterpret_cast<char *>(p) - chunk_p->data;
+      
+      if(chunk_p->Resize(offset + old_alloc_sz, 
+                         offset + new_alloc_sz) == true) {
+        if((stats_flag == true) && (new_alloc_sz > old_alloc_sz)) {
+          uint64_t stripe = GetStripe();
+          StatsBlock *stats_p = stats_list_p + thread_num + stripe;
+          AddCounter(stats_p->requested_bytes, 
+                     new_sz - old_sz, 
+                     stripe != STATS_STRIPE_NUM);
+          AddCounter(stats_p->allocated_bytes, 
+                     new_alloc_sz - old_alloc_sz, 
+                     stripe != STATS_STRIPE_NUM);
+        }
+        
+        return p;
+      }
+    }
+    
+    if(new_alloc_sz <= old_alloc_sz) {
+      return p;
+    }
+    
+    void *new_p = Allocate(new_sz);
+    memcpy(new_p, p, old_sz);
+    Free(p);
+    
+    return new_p;
+  }
+  
+  /*
+   * Reallocate() - Resizes an allocation from a thread slot
+   *
+   * This is the same as Reallocate() of the shared list, except that 
+   * memory is resized in place only if it is the most recent allocation 
+   * of the chunk owned by the slot, which needs no atomic instruction. A 
+   * block moved out of is freed as with Free(p, old_sz, thread_id)
+   */
+  void *Reallocate(void *p, 
+                   size_t old_sz, 
+                   size_t new_sz, 
+                   uint64_t thread_id) {
+    assert(thread_id < thread_num);
+    
+    if(p == nullptr) {
+      return Allocate(new_sz, thread_id);
+    }
+    
+    ThreadSlot *slot_p = &thread_slot_list_p[thread_id].data;
+    Chunk *chunk_p = slot_p->chunk_p;
+    
+    size_t old_alloc_sz = GetAllocSize(old_sz);
+    size_t new_alloc_sz = GetAllocSize(new_sz);
+    if((chunk_p != nullptr) && 
+       (new_alloc_sz <= large_size) &&
+       (GetChunk(p) == chunk_p) &&
+       (reinterpret_cast<char *>(p) + old_alloc_sz == 
+        chunk_p->data + slot_p->offset) &&
+       (reinterpret_cast<char *>(p) + new_alloc_sz <= chunk_p->end_data)) {
+      slot_p->offset = (reinterpret_cast<char *>(p) - chunk_p->data) + 
+                       new_alloc_sz;
+      
+      if((stats_flag == true) && (new_alloc_sz > old_alloc_sz)) {
+        StatsBlock *stats_p = stats_list_p + thread_id;
+        AddCounter(stats_p->requested_bytes, new_sz - old_sz, true);
+        AddCounter(stats_p->allocated_bytes, 
+                   new_alloc_sz - old_alloc_sz, 
+                   true);
+      }
+      
+      return p;
+    }
+    
+    if(new_alloc_sz <= old_alloc_sz) {
+      return p;
+    }
+    
+    void *new_p = Allocate(new_sz, thread_id);
+    memcpy(new_p, p, old_sz);
+    Free(p, old_sz, thread_id);
+    
+    return new_p;
+  }
+  
+  /*
+   * ReclaimChunks() - Frees retired chunks whose delete epoch is less than
+   *                   the minimum epoch of all threads
+   *
+   * This walks the chunk list of each node from scanning_head_p and 
+   * unlinks chunks in place. Only the appending tail is modified by other
+   * threads, and the tail is never retired, so this is safe while other
+   * threads allocate and free. Lists of thread slots and the list of large
+   * chunks are walked the same way, except that the head of each list is
+   * kept. It must not be called by more than one thread at a time.
+   * Without an EM this must only be called when no thread is inside 
+   * Allocate(). Returns the number of chunks freed
+   *
+   * Retired objects whose epoch has passed are destroyed first, and their
+   * chunks are reclaimed in a later call. ScanChunks() is blocked while
+   * this runs
+   */
+  uint64_t ReclaimChunks() {
+    std::lock_guard<std::mutex> guard{reclaim_lock};
+    
+    uint64_t min_epoch = GetMinEpoch();
+    
+    DestroyRetiredObjects(min_epoch);
+    
+    uint64_t freed_count = 0;
+    
+    for(uint64_t i = 0;i < node_num;i++) {
+      NodeList *list_p = &node_list_p[i].data;
+      
+      Chunk *prev_p = nullptr;
+      Chunk *chunk_p = list_p->scanning_head_p;
+      while(chunk_p != nullptr) {
+        Chunk *next_p = chunk_p->next_p.load();
+        
+        if(chunk_p->delete_epoch.load() < min_epoch) {
+          // Retired chunks are sealed so they could not be the tail
+          assert(next_p != nullptr);
+          
+          if(prev_p == nullptr) {
+            list_p->scanning_head_p = next_p;
+          } else {
+            prev_p->next_p.store(next_p);
+          }
+          
+          DeleteChunk(chunk_p);
+          freed_count++;
+        } else {
+          prev_p = chunk_p;
+        }
+        
+        chunk_p = next_p;
+      }
+    }
+    
+    for(uint64_t i = 0;i < thread_num;i++) {
+      Chunk *head_p = thread_slot_list_p[i]->head_p.load();
+      if(head_p != nullptr) {
+        freed_count += ReclaimList(head_p, min_epoch);
+      }
+    }
+    
+    Chunk *head_p = large_head_p.load();
+    if(head_p != nullptr) {
+      freed_count += ReclaimList(head_p, min_epoch);
+    }
+    
+    chunk_count.fetch_sub(freed_count);
+    
+    DecommitIdleChunks();
+    
+    return freed_count;
+  }
+  
+  /*
+   * Constructor
+   *
+   * If em is nullptr then chunks are only reclaimed by explicitly calling 
+   * ReclaimChunks() when no thread is allocating, or in the destructor.
+   * thread_num is the number of slots for Allocate(sz, thread_id)
+   *
+   * chunk_size must be a power of two, and it includes the chunk object at
+   * the base of each chunk. Chunk memory comes from provider, or from the
+   * heap if it is nullptr. The provider must outlive the pool
+   *
+   * Chunks are placed on NUMA nodes according to topology, or the topology
+   * of the machine if it is nullptr. The topology must outlive the pool
+   *
+   * Allocations and frees are only counted for GetStats() if stats_flag
+   * is true, since counting costs time on every call
+   */
+  VarLenPool(size_t p_chunk_size, 
+             EMType *p_em_p = nullptr, 
+             uint64_t p_thread_num = 0,
+             ChunkProvider *p_provider_p = nullptr,
+             const NumaTopology *p_topology_p = nullptr,
+             bool p_stats_flag = false) :
+    chunk_size{p_chunk_size},
+    large_size{(p_chunk_size - sizeof(Chunk)) / 2},
+    heap_provider{},
+    provider_p{p_provider_p},
+    machine_topology{},
+    topology_p{p_topology_p},
+    em_p{p_em_p},
+    thread_num{p_thread_num},
+    reserved_bytes{0},
+    stats_flag{p_stats_flag},
+    reclaim_lock{},
+    cache_lock{},
+    chunk_cache{},
+    chunk_cache_size{DEFAULT_CHUNK_CACHE_SIZE},
+    reclaim_round{0},
+    decommit_round{DEFAULT_DECOMMIT_ROUND},
+    decommit_count{0},
+    retired_head_p{nullptr},
+    pending_head_p{nullptr},
+    pending_count{0},
+    exited_flag{false},
+    gc_thread_p{nullptr},
+    gc_interval{50} {
+    assert((chunk_size & (chunk_size - 1)) == 0);
+    assert(chunk_size > sizeof(Chunk));
+    
+    if(provider_p == nullptr) {
+      provider_p = &heap_provider;
+    }
+    
+    if(topology_p == nullptr) {
+      topology_p = &machine_topology;
+    }
+    
+    node_num = topology_p->GetNodeNum();
+    chunk_count.store(node_num);
+    
+    // As with thread slots, allocate one more list for alignment
+    node_alloc_p = malloc((node_num + 1) * CACHE_LINE_SIZE);
+    assert(node_alloc_p != nullptr);
+    
+    node_list_p = reinterpret_cast<NodeListType *>(
+                    (reinterpret_cast<uint64_t>(node_alloc_p) + 
+                     (CACHE_LINE_SIZE - 1)) & ~(CACHE_LINE_SIZE - 1));
+    
+    for(uint64_t i = 0;i < node_num;i++) {
+      // Allocate a chunk of standard size for each node
+      Chunk *chunk_p = NewChunk(chunk_size - sizeof(Chunk), 
+                                ChunkHeader{0, 0},
+                                i);
+      
+      // This is the pointer to do CAS
+      node_list_p[i]->scanning_head_p = chunk_p;
+      node_list_p[i]->appending_tail_p.store(chunk_p);
+    }
+    
+    large_head_p.store(nullptr);
+    
+    // Thread slots first, then stripes and the shared block, plus one block
+    // for alignment
+    stats_alloc_p = malloc((thread_num + STATS_STRIPE_NUM + 2) * 
+                           sizeof(StatsBlock));
+    assert(stats_alloc_p != nullptr);
+    
+    stats_list_p = reinterpret_cast<StatsBlock *>(
+                     (reinterpret_cast<uint64_t>(stats_alloc_p) + 
+                      (CACHE_LINE_SIZE - 1)) & ~(CACHE_LINE_SIZE - 1));
+    
+    for(uint64_t i = 0;i < thread_num + STATS_STRIPE_NUM + 1;i++) {
+      new (stats_list_p + i) StatsBlock{};
+    }
+    
+    // Allocate one more slot for alignment
+    slot_alloc_p = malloc((thread_num + 1) * CACHE_LINE_SIZE);
+    assert(slot_alloc_p != nullptr);
+    
+    thread_slot_list_p = reinterpret_cast<SlotType *>(
+                           (reinterpret_cast<uint64_t>(slot_alloc_p) + 
+                            (CACHE_LINE_SIZE - 1)) & ~(CACHE_LINE_SIZE - 1));
+    
+    for(uint64_t i = 0;i < thread_num;i++) {
+      thread_slot_list_p[i]->chunk_p = nullptr;
+      thread_slot_list_p[i]->offset = 0;
+      thread_slot_list_p[i]->alloc_count = 0;
+      thread_slot_list_p[i]->head_p.store(nullptr);
+      
+      thread_slot_list_p[i]->free_list_p = new FreeList[CLASS_NUM]{};
+      thread_slot_list_p[i]->min_epoch = GetMinEpoch();
+      thread_slot_list_p[i]->miss_count = 0;
+      
+      thread_slot_list_p[i]->region_p = new Region{nullptr, nullptr, 0, 0, 0};
+    }
+      
+    return;
+  }
+  
+  /*
+   * Destructor - Stops the GC thread and frees all chunks
+   *
+   * Memory allocated from the pool is no longer valid after this
+   */
+  ~VarLenPool() {
+    if(gc_thread_p != nullptr) {
+      exited_flag.store(true);
+      gc_thread_p->join();
+      
+      delete gc_thread_p;
+    }
+    
+    // Retired objects could still own resources outside of the pool
+    DestroyRetiredObjects(UINT64_MAX);
+    assert(pending_head_p == nullptr);
+    
+    Chunk *chunk_p = nullptr;
+    for(uint64_t i = 0;i < node_num;i++) {
+      chunk_p = node_list_p[i]->scanning_head_p;
+      while(chunk_p != nullptr) {
+        Chunk *next_p = chunk_p->next_p.load();
+        DeleteChunk(chunk_p);
+        
+        chunk_p = next_p;
+      }
+    }
+    
+    for(uint64_t i = 0;i < thread_num;i++) {
+      chunk_p = thread_slot_list_p[i]->head_p.load();
+      while(chunk_p != nullptr) {
+        Chunk *next_p = chunk_p->next_p.load();
+        DeleteChunk(chunk_p);
+        
+        chunk_p = next_p;
+      }
+      
+      // Chunks of the current region are not on the list of the slot
+      chunk_p = thread_slot_list_p[i]->region_p->head_p;
+      while(chunk_p != nullptr) {
+        Chunk *next_p = chunk_p->next_p.load();
+        DeleteChunk(chunk_p);
+        
+        chunk_p = next_p;
+      }
+      
+      // Blocks on the lists are in the chunks just freed
+      for(uint64_t j = 0;j < CLASS_NUM;j++) {
+        delete[] thread_slot_list_p[i]->free_list_p[j].entry_list_p;
+      }
+      
+      delete[] thread_slot_list_p[i]->free_list_p;
+      delete thread_slot_list_p[i]->region_p;
+    }
+    
+    chunk_p = large_head_p.load();
+    while(chunk_p != nullptr) {
+      Chunk *next_p = chunk_p->next_p.load();
+      DeleteChunk(chunk_p);
+      
+      chunk_p = next_p;
+    }
+    
+    for(CachedChunk &cached_chunk : chunk_cache) {
+      provider_p->Free(cached_chunk.p, chunk_size);
+    }
+    
+    free(slot_alloc_p);
+    free(node_alloc_p);
+    free(stats_alloc_p);
+    
+    return;
+  }
+  
+  // Disallow copying since the pool owns its chunks
+  VarLenPool(const VarLenPool &) = delete;
+  VarLenPool &operator=(const VarLenPool &) = delete;
+  
+  /*
+   * StartGCThread() - Starts a thread that calls ReclaimChunks() every
+   *                   gc_interval milliseconds until the pool is destroyed
+   *
+   * This requires an EM since chunks are reclaimed while other threads
+   * are allocating
+   */
+  void StartGCThread() {
+    assert(em_p != nullptr);
+    assert(gc_thread_p == nullptr);
+    
+    gc_thread_p = new std::thread{VarLenPool::ThreadFunc, this};
+    
+    return;
+  }
+  
+  /*
+   * SetGCInterval() - Sets the sleep time in milliseconds of the GC thread
+   */
+  inline void SetGCInterval(uint64_t interval) {
+    gc_interval = interval;
+    
+    return;
+  }
+  
+  /*
+   * GetNodeNum() - Returns the number of NUMA nodes chunks are placed on
+   */
+  inline uint64_t GetNodeNum() const {
+    return node_num;
+  }
+  
+  /*
+   * GetNode() - Returns the NUMA node the memory of an allocation is bound
+   *             to
+   */
+  inline uint64_t GetNode(void *p) const {
+    return GetChunk(p)->node;
+  }
+  
+  /*
+   * GetChunkCount() - Returns the number of chunks not yet reclaimed
+   */
+  inline uint64_t GetChunkCount() const {
+    return chunk_count.load();
+  }
+  
+  /*
+   * SetChunkCacheSize() - Sets the maximum number of reclaimed chunks kept
+   *                       for reuse
+   *
+   * Chunks already in the cache are not freed if it shrinks
+   */
+  inline void SetChunkCacheSize(uint64_t size) {
+    std::lock_guard<std::mutex> guard{cache_lock};
+    chunk_cache_size = size;
+    
+    return;
+  }
+  
+  /*
+   * SetDecommitRound() - Sets the number of ReclaimChunks() rounds after 
+   *                      which an idle cached chunk is decommitted
+   */
+  inline void SetDecommitRound(uint64_t round) {
+    std::lock_guard<std::mutex> guard{cache_lock};
+    decommit_round = round;
+    
+    return;
+  }
+  
+  /*
+   * GetCachedChunkCount() - Returns the number of chunks in the cache
+   */
+  inline uint64_t GetCachedChunkCount() {
+    std::lock_guard<std::mutex> guard{cache_lock};
+    
+    return chunk_cache.size();
+  }
+  
+  /*
+   * GetDecommitCount() - Returns the number of times cached chunks are
+   *                      decommitted
+   */
+  inline uint64_t GetDecommitCount() {
+    std::lock_guard<std::mutex> guard{cache_lock};
+    
+    return decommit_count;
+  }
+
+  /*
+   * GetRetiredCount() - Returns the number of retired objects not yet 
+   *                     destroyed, not including those retired after the
+   *                     last ReclaimChunks()
+   *
+   * This must be called by the thread calling ReclaimChunks()
+   */
+  inline uint64_t GetRetiredCount() const {
+    return pending_count;
+  }
+  
+  /*
+   * GetStats() - Sums up counters of all thread slots and stripes
+   *
+   * This only reads relaxed counters and is cheap enough to be called
+   * periodically by any thread. Counts of allocations, frees and bytes are
+   * zero unless the pool is constructed with stats enabled
+   */
+  Stats GetStats() {
+    Stats stats{};
+    
+    for(uint64_t i = 0;i < thread_num + STATS_STRIPE_NUM + 1;i++) {
+      StatsBlock *stats_p = stats_list_p + i;
+      
+      stats.alloc_count += stats_p->alloc_count.load(std::memory_order_relaxed);
+      stats.free_count += stats_p->free_count.load(std::memory_order_relaxed);
+      stats.requested_bytes += \
+        stats_p->requested_bytes.load(std::memory_order_relaxed);
+      stats.allocated_bytes += \
+        stats_p->allocated_bytes.load(std::memory_order_relaxed);
+      
+      for(uint64_t j = 0;j < CLASS_NUM + 1;j++) {
+        stats.class_count[j] += \
+          stats_p->class_count[j].load(std::memory_order_relaxed);
+      }
+    }
+    
+    // A free could be counted in a block read before the block of its
+    // allocation
+    if(stats.alloc_count > stats.free_count) {
+      stats.live_count = stats.alloc_count - stats.free_count;
+    }
+    
+    stats.reserved_bytes = reserved_bytes.load();
+    stats.cached_bytes = GetCachedChunkCount() * chunk_size;
+    stats.chunk_count = chunk_count.load();
+    
+    return stats;
+  }
+  
+  /*
+   * ScanChunks() - Walks all chunk lists and reports the state of chunks
+   *
+   * This is for diagnostics and takes time linear to the number of 
+   * chunks. It could be called by any thread while others allocate and
+   * free, since chunks are not reclaimed during the scan
+   */
+  ChunkStats ScanChunks() {
+    std::lock_guard<std::mutex> guard{reclaim_lock};
+    
+    ChunkStats stats{};
+    
+    for(uint64_t i = 0;i < node_num;i++) {
+      ScanList(node_list_p[i]->scanning_head_p, &stats, false);
+    }
+    
+    for(uint64_t i = 0;i < thread_num;i++) {
+      ScanList(thread_slot_list_p[i]->head_p.load(), &stats, false);
+    }
+    
+    ScanList(large_head_p.load(), &stats, true);
+    
+    return stats;
+  }
+
+ private:  
+  // This is the size and alignment of each chunk
+  uint64_t chunk_size;
+  // Allocations larger than this get dedicated chunks
+  uint64_t large_size;
+  
+  // Memory of all chunks comes from provider_p, which points to 
+  // heap_provider by default
+  HeapChunkProvider heap_provider;
+  ChunkProvider *provider_p;
+  
+  // Chunks are placed on nodes of topology_p, which points to 
+  // machine_topology by default
+  NumaTopology machine_topology;
+  const NumaTopology *topology_p;
+  
+  // Epochs of this EM are used to stamp retired chunks
+  EMType *em_p;
+  
+  // Number of thread slots
+  uint64_t thread_num;
+  // Cache line aligned thread slots and the address we call free() on
+  SlotType *thread_slot_list_p;
+  void *slot_alloc_p;
+  
+  // Cache line aligned shared lists of nodes and the address we call 
+  // free() on
+  uint64_t node_num;
+  NodeListType *node_list_p;
+  void *node_alloc_p;
+  // The most recent dedicated chunk of large allocations
+  std::atomic<Chunk *> large_head_p;
+  
+  // Number of chunks in the list
+  std::atomic<uint64_t> chunk_count;
+  // Bytes of those chunks
+  std::atomic<uint64_t> reserved_bytes;
+  
+  // Whether allocations and frees are counted in stats blocks
+  bool stats_flag;
+  
+  // Cache line aligned stats blocks of thread slots followed by stripes
+  // and the shared block, and the address we call free() on
+  StatsBlock *stats_list_p;
+  void *stats_alloc_p;
+  
+  // Serializes ReclaimChunks() and ScanChunks()
+  std::mutex reclaim_lock;
+  
+  // Reclaimed chunks of chunk_size. Chunks are only reclaimed by one
+  // thread, but are taken out by any thread that needs a new chunk. 
+  // Since that happens once per chunk a lock is good enough
+  std::mutex cache_lock;
+  std::vector<CachedChunk> chunk_cache;
+  uint64_t chunk_cache_size;
+  // Number of ReclaimChunks() calls so far
+  uint64_t reclaim_round;
+  uint64_t decommit_round;
+  uint64_t decommit_count;
+  
+  // Objects retired since the last ReclaimChunks(), and objects whose 
+  // epoch has not passed which are only accessed by ReclaimChunks()
+  std::atomic<RetiredObject *> retired_head_p;
+  RetiredObject *pending_head_p;
+  uint64_t pending_count;
+  
+  // Set by the destructor to stop the GC thread
+  std::atomic<bool> exited_flag;
+  std::thread *gc_thread_p;
+  uint64_t gc_interval;
 };
 
 #endif
@@ -0,0 +1,2 @@
+
+#include "WorkStealingDeque.h"
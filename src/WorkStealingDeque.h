@@ -0,0 +1,266 @@
+#pragma once
+
+#ifndef _WORK_STEALING_DEQUE_H
+#define _WORK_STEALING_DEQUE_H
+
+#include "common.h"
+
+namespace peloton {
+namespace index {
+
+/*
+ * class WorkStealingDeque - Chase-Lev work-stealing deque
+ *
+ * The deque has a single owner thread which pushes and pops at the bottom,
+ * while any number of thief threads steal from the top. Elements are kept
+ * in a circular buffer. When the buffer is full the owner copies elements
+ * into a buffer twice as large and retires the old one to the EM, since
+ * thieves might still be reading from the old buffer. This implementation
+ * follows the C11 version by Le et al. (PPoPP 2013)
+ *
+ * Push() only issues a release fence, and Pop() only does a CAS when it
+ * races with thieves on the last element; neither touches the EM. Thieves
+ * must be protected by the EM (e.g. AnnounceEnter()) around Steal(). The
+ * owner does not need to be, since it never reads a retired buffer
+ *
+ * Type T is stored in std::atomic and must be trivially copyable
+ */
+template <typename T,
+          template <typename> class EMTemplate>
+class WorkStealingDeque {
+ private:
+
+  /*
+   * class Buffer - A circular array whose size is a power of 2
+   */
+  class Buffer {
+   public:
+    int64_t capacity;
+    int64_t mask;
+    std::atomic<T> *data;
+
+    /*
+     * Constructor
+     */
+    Buffer(int64_t p_capacity) :
+      capacity{p_capacity},
+      mask{p_capacity - 1} {
+      assert((capacity & mask) == 0);
+
+      data = new std::atomic<T>[capacity];
+
+      return;
+    }
+
+    /*
+     * Destructor - Frees the array
+     */
+    ~Buffer() {
+      delete[] data;
+
+      return;
+    }
+
+    /*
+     * Get() / Put() - Accesses the element at a logical index
+     */
+    inline T Get(int64_t index) const {
+      return data[index & mask].load(std::memory_order_relaxed);
+    }
+
+    inline void Put(int64_t index, const T &value) {
+      data[index & mask].store(value, std::memory_order_relaxed);
+
+      return;
+    }
+  };
+
+ public:
+  // The EM should be instanciated with this type
+  using BufferType = Buffer;
+  using EMType = EMTemplate<BufferType>;
+
+ private:
+  // Index of the next element to steal; only increased by CAS
+  std::atomic<int64_t> top;
+
+  // Put top and bottom on different cache lines since thieves keep
+  // writing top, while bottom is mostly written by the owner
+  char padding[CACHE_LINE_SIZE - sizeof(std::atomic<int64_t>)];
+
+  // Index of the next slot to push into; only written by the owner
+  std::atomic<int64_t> bottom;
+
+  std::atomic<Buffer *> buffer_p;
+
+  // Old buffers go here
+  EMType *em_p;
+
+ private:
+
+  /*
+   * Grow() - Copies elements into a buffer twice as large and retires the
+   *          old buffer
+   *
+   * This is only called by the owner
+   */
+  Buffer *Grow(Buffer *old_buffer_p, int64_t b, int64_t t) {
+    Buffer *new_buffer_p = new Buffer{old_buffer_p->capacity * 2};
+
+    for(int64_t i = t;i < b;i++) {
+      new_buffer_p->Put(i, old_buffer_p->Get(i));
+    }
+
+    buffer_p.store(new_buffer_p, std::memory_order_release);
+    em_p->AddGarbageNode(old_buffer_p);
+
+    return new_buffer_p;
+  }
+
+ public:
+
+  /*
+   * Constructor - Initial capacity is rounded up to a power of 2
+   */
+  WorkStealingDeque(EMType *p_em_p, int64_t initial_capacity = 64) :
+    top{0},
+    bottom{0},
+    em_p{p_em_p} {
+    int64_t capacity = 1;
+    while(capacity < initial_capacity) {
+      capacity <<= 1;
+    }
+
+    buffer_p.store(new Buffer{capacity});
+
+    return;
+  }
+
+  /*
+   * Destructor - Frees the current buffer
+   *
+   * Retired buffers are freed by the EM
+   */
+  ~WorkStealingDeque() {
+    delete buffer_p.load();
+
+    return;
+  }
+
+  // Disallow copying since the deque owns its buffer
+  WorkStealingDeque(const WorkStealingDeque &) = delete;
+  WorkStealingDeque &operator=(const WorkStealingDeque &) = delete;
+
+  /*
+   * Push() - Pushes an element at the bottom; only called by the owner
+   */
+  void Push(const T &value) {
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_acquire);
+    Buffer *array_p = buffer_p.load(std::memory_order_relaxed);
+
+    if(unlikely(b - t > array_p->capacity - 1)) {
+      array_p = Grow(array_p, b, t);
+    }
+
+    array_p->Put(b, value);
+
+    // The element must be visible before thieves see the new bottom
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_relaxed);
+
+    return;
+  }
+
+  /*
+   * Pop() - Pops an element from the bottom; only called by the owner
+   *
+   * Returns false if the deque is empty or the last element is stolen
+   */
+  bool Pop(T &value) {
+    int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    Buffer *array_p = buffer_p.load(std::memory_order_relaxed);
+    bottom.store(b, std::memory_order_relaxed);
+
+    // The store to bottom must be ordered before the load of top, such
+    // that a thief and the owner could not both take the last element
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+
+    if(t > b) {
+      // Empty; restore bottom
+      bottom.store(b + 1, std::memory_order_relaxed);
+
+      return false;
+    }
+
+    value = array_p->Get(b);
+    if(t != b) {
+      // More than one element left, so no thief could take this one
+      return true;
+    }
+
+    // This is the last element; race with thieves on top
+    bool ret = top.compare_exchange_strong(t,
+                                           t + 1,
+                                           std::memory_order_seq_cst,
+                                           std::memory_order_relaxed);
+    bottom.store(b + 1, std::memory_order_relaxed);
+
+    return ret;
+  }
+
+  /*
+   * Steal() - Steals an element from the top; called by any thread other
+   *           than the owner
+   *
+   * The caller must be protected by the EM since the buffer might be
+   * replaced and retired after we load it. Returns false if the deque is
+   * empty or we lost the race to another thief or the owner
+   */
+  bool Steal(T &value) {
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_acquire);
+
+    if(t >= b) {
+      return false;
+    }
+
+    Buffer *array_p = buffer_p.load(std::memory_order_acquire);
+    T stolen_value = array_p->Get(t);
+
+    if(top.compare_exchange_strong(t,
+                                   t + 1,
+                                   std::memory_order_seq_cst,
+                                   std::memory_order_relaxed) == false) {
+      return false;
+    }
+
+    value = stolen_value;
+
+    return true;
+  }
+
+  /*
+   * GetSize() - Returns an estimation of the number of elements
+   */
+  inline int64_t GetSize() const {
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_relaxed);
+
+    return (b > t) ? (b - t) : 0;
+  }
+
+  /*
+   * GetCapacity() - Returns the capacity of the current buffer
+   */
+  inline int64_t GetCapacity() const {
+    return buffer_p.load()->capacity;
+  }
+};
+
+} // namespace index
+} // namespace peloton
+
+#endif
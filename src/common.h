@@ -39,5 +39,8 @@ static void dummy(const char*, ...) {}
 // if there is one
 #define likely(x)   __builtin_expect(!!(x), 1)
 #define unlikely(x) __builtin_expect(!!(x), 0)
+
+// Size of a cache line on the target platform; used for padding
+static const size_t CACHE_LINE_SIZE = 64;
  
 #endif
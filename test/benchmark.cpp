@@ -10,7 +10,24 @@
 #include "../src/AtomicStack.h"
 #include "../src/LocalWriteEM.h"
 #include "../src/GlobalWriteEM.h"
+#include "../src/AtomicHashMap.h"
+#include "../src/AtomicSkipList.h"
+#include "../src/DeltaChainIndex.h"
+#include "../src/AtomicListSet.h"
+#include "../src/WorkStealingDeque.h"
+#include "../src/ClockCache.h"
+#include "../src/RCUPointer.h"
+#include "../src/ConcurrentVector.h"
+#include "../src/DeferredAllocator.h"
+#include "../src/VarLenPool.h"
+#include "../src/ChunkProvider.h"
 #include "test_suite.h"
+#include "benchmark_harness.h"
+#include "latency_recorder.h"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
 
 using namespace peloton;
 using namespace index;
@@ -20,6 +37,12 @@ using namespace index;
 // not performance)
 uint64_t CoreNum;
 
+// Collects results of all trials. Benchmarks record their throughput in it
+BenchmarkHarness Harness{};
+
+// Pinned workers that run all multithreaded benchmarks
+WorkerPool Pool{};
+
 // Declear stack and its node type here
 using StackType = AtomicStack<uint64_t>;
 using NodeType = typename StackType::NodeType;
@@ -28,6 +51,62 @@ using NodeType = typename StackType::NodeType;
 using LEM = LocalWriteEM<NodeType>;
 using GEM = GlobalWriteEM<NodeType>;
 
+// Hash map and the EM it retires nodes and bucket arrays into
+using HashMapType = AtomicHashMap<uint64_t, uint64_t, LocalWriteEM>;
+using HashMapEM = typename HashMapType::EMType;
+
+// Skiplist and the EM it retires unlinked nodes into
+using SkipListType = AtomicSkipList<uint64_t, uint64_t, LocalWriteEM>;
+using SkipListEM = typename SkipListType::EMType;
+
+// Delta chain index retiring whole chains into either EM
+using LEMDeltaChainType = DeltaChainIndex<uint64_t, uint64_t, LocalWriteEM>;
+using GEMDeltaChainType = DeltaChainIndex<uint64_t, uint64_t, GlobalWriteEM>;
+
+// Sorted list set with either EM
+using LEMListSetType = AtomicListSet<uint64_t, LocalWriteEM>;
+using GEMListSetType = AtomicListSet<uint64_t, GlobalWriteEM>;
+
+// Work-stealing deque whose old buffers are retired into LocalWriteEM
+using DequeType = WorkStealingDeque<uint64_t, LocalWriteEM>;
+using DequeEM = typename DequeType::EMType;
+
+// CLOCK cache whose evicted entries are retired into LocalWriteEM
+using ClockCacheType = ClockCache<uint64_t, uint64_t, LocalWriteEM>;
+using ClockCacheEM = typename ClockCacheType::EMType;
+
+// Read-mostly object shared through RCUPointer or std::shared_ptr
+using SharedObjectType = std::vector<uint64_t>;
+using RCUPointerType = RCUPointer<SharedObjectType, LocalWriteEM>;
+using RCUPointerEM = typename RCUPointerType::EMType;
+
+// Concurrent vector whose old directories are retired into LocalWriteEM
+using VectorType = ConcurrentVector<uint64_t, LocalWriteEM>;
+using VectorEM = typename VectorType::EMType;
+
+// Batched deferred frees through LocalWriteEM
+using DeferredContextType = DeferredFreeContext<LocalWriteEM>;
+using DeferredContextEM = typename DeferredContextType::EMType;
+
+/*
+ * RunThreads() - Runs func on thread_num workers of the pool, and returns
+ *                the seconds between the first one starting and the last
+ *                one finishing
+ *
+ * Skew of start and end times among workers is also printed. Start skew
+ * should be small, while a large end skew means that threads finish
+ * unevenly and the throughput is underestimated
+ */
+double RunThreads(uint64_t thread_num, const WorkerPool::FuncType &func) {
+  double duration = Pool.Run(thread_num, func);
+
+  dbg_printf("    Start skew = %f us; End skew = %f us\n",
+             Pool.GetStartSkew() * 1000000.0,
+             Pool.GetEndSkew() * 1000000.0);
+
+  return duration;
+}
+
 /*
  * IntHasherRandBenchmark() - Benchmarks integer number hash function from 
  *                            Murmurhash3, which is then used as a random
@@ -55,6 +134,10 @@ void IntHasherRandBenchmark(uint64_t iter, uint64_t salt_num) {
              duration);
   dbg_printf("    Throughput = %f M op/sec\n", 
              static_cast<double>(iter * salt_num) / duration / 1024.0 / 1024.0);
+
+  Harness.Record("IntHash",
+                 static_cast<double>(iter * salt_num) / duration / 1024.0 / 1024.0,
+                 "M op/sec");
              
   return;
 }
@@ -66,7 +149,7 @@ void RandomNumberBenchmark(int thread_num, int iter) {
   PrintTestName("RandomNumberBenchmark");
   
   auto f = [thread_num, iter](uint64_t id) -> void {
-    Random<uint64_t, 0, -1> r{};
+    Random<uint64_t, 0, UINT64_MAX> r{};
   
     // Avoid optimization 
     std::vector<uint64_t> v{};
@@ -85,11 +168,7 @@ void RandomNumberBenchmark(int thread_num, int iter) {
     return; 
   };
   
-  Timer t{true};
-  
-  StartThreads(thread_num, f);
-  
-  double duration = t.Stop();
+  double duration = RunThreads(thread_num, f);
   
   dbg_printf("Thread num = %d, Iteration = %d, Duration = %f\n", 
              thread_num, 
@@ -99,6 +178,11 @@ void RandomNumberBenchmark(int thread_num, int iter) {
              static_cast<double>(iter) / duration / 1024.0 / 1024.0);
   dbg_printf("    Throughput = %f M op/(sec * thread)\n", 
              static_cast<double>(iter) / duration / 1024.0 / 1024.0 / thread_num);
+
+  Harness.Record(BenchmarkHarness::Format("RandomNumber, %d threads",
+                                          thread_num),
+                 static_cast<double>(iter) / duration / 1024.0 / 1024.0,
+                 "M op/sec");
   
   return;
 }
@@ -126,9 +210,7 @@ void GetThreadAffinityBenchmark(uint64_t thread_num) {
   };
   
   // Start Threads and timer
-  Timer t{true};
-  StartThreads(thread_num, f);
-  double duration = t.Stop();
+  double duration = RunThreads(thread_num, f);
   
   dbg_printf("Time usage (iter %d, thread %lu) = %f\n", 
              iter, 
@@ -138,6 +220,11 @@ void GetThreadAffinityBenchmark(uint64_t thread_num) {
              static_cast<double>(iter) / duration); 
   dbg_printf("    Throughput = %f op/(second * thread)\n", 
              static_cast<double>(iter) / duration / thread_num);
+
+  Harness.Record(BenchmarkHarness::Format("ThreadAffinity, %lu threads",
+                                          thread_num),
+                 static_cast<double>(iter) / duration,
+                 "op/sec");
              
   return;
 }
@@ -179,18 +266,13 @@ void LEMSimpleBenchmark(uint64_t thread_num,
   // Note that we use the number of counters equal to the number of threads
   // rather than number of cores, i.e. one core could have multiple counters
   LEM *em = new LEM{thread_num};
+  LatencyRecorder enter_recorder{thread_num};
 
-  auto func = [em, op_num, workload](uint64_t id) {
-                // This is the core ID this thread is logically pinned to
-                // physically we do not make any constraint here
+  auto func = [em, op_num, workload, &enter_recorder](uint64_t id) {
+                // This is the core ID this thread is pinned to by the
+                // worker pool
                 uint64_t core_id = id % CoreNum;
                 
-                // This avoids scheduling problem
-                // Without this function the performance will be very
-                // unstable especially when # of threads does not match
-                // number of core
-                PinToCore(core_id);
-                
                 const uint64_t random_workload = \
                   GetRandomWorkload(workload, workload >> 2, id); 
                 
@@ -199,9 +281,18 @@ void LEMSimpleBenchmark(uint64_t thread_num,
                 std::vector<uint64_t> v{};
                 v.reserve(random_workload);
                 
+                LatencyHistogram *enter_histogram_p = \
+                  enter_recorder.GetHistogram(id);
+
                 // And then announce entry on its own processor
                 for(uint64_t i = 0;i < op_num;i++) { 
-                  em->AnnounceEnter(core_id);
+                  if(enter_recorder.IsSampled(i) == true) {
+                    uint64_t start = TSCTimer::Start();
+                    em->AnnounceEnter(core_id);
+                    enter_histogram_p->Record(TSCTimer::End() - start);
+                  } else {
+                    em->AnnounceEnter(core_id);
+                  }
                   
                   for(uint64_t j = 0;j < random_workload;j++) {
                     v[j] = j; 
@@ -214,10 +305,8 @@ void LEMSimpleBenchmark(uint64_t thread_num,
   // Need to start GC thread to periodically increase global epoch
   em->StartGCThread();
 
-  // Let timer start and then start threads
-  Timer t{true};
-  StartThreads(thread_num, func);
-  double duration = t.Stop();
+  // Only the time threads spend in the loop is measured
+  double duration = RunThreads(thread_num, func);
 
   delete em;
   
@@ -229,9 +318,14 @@ void LEMSimpleBenchmark(uint64_t thread_num,
   dbg_printf("    Throughput = %f M op/sec\n", 
              static_cast<double>(thread_num * op_num) / duration / (1024.0 * 1024.0));
 
+  Harness.Record(BenchmarkHarness::Format("LEMSimple, %lu threads", thread_num),
+                 static_cast<double>(thread_num * op_num) / duration / (1024.0 * 1024.0),
+                 "M op/sec");
+
   dbg_printf("    Throughput Per Thread = %f M op/sec\n", 
              static_cast<double>(op_num) / duration / (1024.0 * 1024.0));
 
+  enter_recorder.Print("AnnounceEnter()");
 
   return;
 }
@@ -250,8 +344,11 @@ void GEMSimpleBenchmark(uint64_t thread_num,
   
   // This instance must be created by the factory
   GEM *em = new GEM{};
+  LatencyRecorder join_recorder{thread_num};
+  LatencyRecorder leave_recorder{thread_num};
 
-  auto func = [em, op_num, workload](uint64_t id) {
+  auto func = [em, op_num, workload,
+               &join_recorder, &leave_recorder](uint64_t id) {
                 // random is between (base [+/-] 1/4 base)
                 const uint64_t random_workload = \
                   GetRandomWorkload(workload, workload >> 2, id); 
@@ -259,16 +356,38 @@ void GEMSimpleBenchmark(uint64_t thread_num,
                 std::vector<uint64_t> v{};
                 v.reserve(random_workload);
                 
+                LatencyHistogram *join_histogram_p = \
+                  join_recorder.GetHistogram(id);
+                LatencyHistogram *leave_histogram_p = \
+                  leave_recorder.GetHistogram(id);
+
                 // And then announce entry on its own processor
                 for(uint64_t i = 0;i < op_num;i++) { 
+                  bool sampled_flag = join_recorder.IsSampled(i);
+
+                  uint64_t start = 0;
+                  if(sampled_flag == true) {
+                    start = TSCTimer::Start();
+                  }
+
                   void *epoch_node_p = em->JoinEpoch();
+
+                  if(sampled_flag == true) {
+                    join_histogram_p->Record(TSCTimer::End() - start);
+                  }
                   
                   // Actual workload is protected by epoch manager
                   for(uint64_t j = 0;j < random_workload;j++) {
                     v[j] = j; 
                   }
                   
-                  em->LeaveEpoch(epoch_node_p);
+                  if(sampled_flag == true) {
+                    start = TSCTimer::Start();
+                    em->LeaveEpoch(epoch_node_p);
+                    leave_histogram_p->Record(TSCTimer::End() - start);
+                  } else {
+                    em->LeaveEpoch(epoch_node_p);
+                  }
                 }
                 
                 return;
@@ -276,13 +395,9 @@ void GEMSimpleBenchmark(uint64_t thread_num,
 
   em->StartGCThread();
 
-  // Let timer start and then start threads
-  Timer t{true};
-  StartThreads(thread_num, func);
-  double duration = t.Stop();
+  // Only the time threads spend in the loop is measured
+  double duration = RunThreads(thread_num, func);
 
-  delete em;
-  
   dbg_printf("Tests of %lu threads, %lu operations each took %f seconds\n",
              thread_num,
              op_num,
@@ -292,83 +407,2410 @@ void GEMSimpleBenchmark(uint64_t thread_num,
              em->GetEpochCreated(),
              em->GetEpochFreed());
   
+  delete em;
+  
   dbg_printf("    Throughput = %f M op/sec\n", 
              static_cast<double>(thread_num * op_num) / duration / (1024.0 * 1024.0));
 
+  Harness.Record(BenchmarkHarness::Format("GEMSimple, %lu threads", thread_num),
+                 static_cast<double>(thread_num * op_num) / duration / (1024.0 * 1024.0),
+                 "M op/sec");
+
   dbg_printf("    Throughput Per Thread = %f M op/sec\n", 
              static_cast<double>(op_num) / duration / (1024.0 * 1024.0));
 
+  join_recorder.Print("JoinEpoch()");
+  leave_recorder.Print("LeaveEpoch()");
 
   return;
 }
 
 /*
- * GetValueOrThrow() - Get an unsigned long typed value from args, or throw 
- *                     exception if the format for key-value is not correct
+ * HashMapBenchmark() - Benchmarks AtomicHashMap under a mix of operations
  *
- * This function throws integer constant 0 on error 
+ * read_ratio is the percentage of Find() among all operations, and the rest
+ * is evenly split between Insert() and Delete() on uniformly random keys.
+ * The map is pre-populated with half of the key range such that inserts and
+ * deletes have roughly equal chance of succeeding. Every successful Delete()
+ * retires a node through LocalWriteEM, so write heavy workloads also measure
+ * the retire throughput of the EM
  */
-void GetValueAsULOrThrow(Argv &args, 
-                         const std::string &key,
-                         unsigned long *value_p) {
-  bool ret = args.GetValueAsUL(key, value_p);
-  
-  if(ret == false) {
-    dbg_printf("ERROR: Unrecognized value for key %s: \"%s\"\n",
-               key.c_str(), 
-               args.GetValue("thread_num")->c_str());
-               
-    throw 0;
+void HashMapBenchmark(uint64_t thread_num,
+                      uint64_t op_num,
+                      uint64_t key_num,
+                      uint64_t read_ratio) {
+  PrintTestName("HashMapBenchmark");
+
+  HashMapEM *em = new HashMapEM{thread_num};
+  HashMapType *hm = new HashMapType{em};
+
+  for(uint64_t i = 0;i < key_num;i += 2) {
+    hm->Insert(i, i);
   }
-  
+
+  auto func = [em, hm, op_num, key_num, read_ratio](uint64_t id) {
+                SimpleInt64Random<> r{};
+
+                // Avoid the lookups being optimized out
+                std::vector<uint64_t> v(1);
+
+                for(uint64_t i = 0;i < op_num;i++) {
+                  uint64_t key = r(i, id) % key_num;
+                  uint64_t op = r(i, id + 1024) % 100;
+
+                  em->AnnounceEnter(id);
+
+                  if(op < read_ratio) {
+                    hm->Find(key, v[0]);
+                  } else if(((op - read_ratio) & 0x1) == 0) {
+                    hm->Insert(key, key);
+                  } else {
+                    hm->Delete(key);
+                  }
+                }
+
+                return;
+              };
+
+  em->StartGCThread();
+
+  double duration = RunThreads(thread_num, func);
+
+  dbg_printf("Read ratio = %lu%%, key num = %lu, item count = %lu, "
+             "bucket num = %lu\n",
+             read_ratio,
+             key_num,
+             hm->GetItemCount(),
+             hm->GetBucketNum());
+
+  delete hm;
+  delete em;
+
+  dbg_printf("Tests of %lu threads, %lu operations each took %f seconds\n",
+             thread_num,
+             op_num,
+             duration);
+
+  dbg_printf("    Throughput = %f M op/sec\n",
+             static_cast<double>(thread_num * op_num) / duration / (1024.0 * 1024.0));
+
+  Harness.Record(BenchmarkHarness::Format("HashMap, %lu%% read, %lu threads",
+                                          read_ratio,
+                                          thread_num),
+                 static_cast<double>(thread_num * op_num) / duration / (1024.0 * 1024.0),
+                 "M op/sec");
+
+  dbg_printf("    Throughput Per Thread = %f M op/sec\n",
+             static_cast<double>(op_num) / duration / (1024.0 * 1024.0));
+
   return;
 }
 
-int main(int argc, char **argv) {
-  // This returns the number of logical CPUs
-  CoreNum = GetCoreNum();
-  dbg_printf("* # of cores (default thread_num) on the platform = %lu\n", 
-             CoreNum);
-  if(CoreNum == 0) {
-    dbg_printf("    ...which is not supported\n");
-    
-    exit(1);
-  }
-  
-  // This will be overloaded if a thread_num is provided as argument
-  uint64_t thread_num = CoreNum;
-  // By default no workload is done
-  uint64_t workload = 0;
-  
-  Argv args{argc, argv};
-  
-  GetValueAsULOrThrow(args, "thread_num", &thread_num);
-  GetValueAsULOrThrow(args, "workload", &workload);
-  
-  dbg_printf("* thread_num = %lu\n", thread_num);
-  dbg_printf("* workload = %lu\n", workload);
-  dbg_printf("* CoreNum = %lu\n", CoreNum);
-  
-  if(argc == 1 || args.Exists("thread_affinity")) {
-    GetThreadAffinityBenchmark(thread_num);
-  }
-  
-  if(argc == 1 || args.Exists("int_hash")) {
-    IntHasherRandBenchmark(100000000, 10);
-  }
-  
-  if(argc == 1 || args.Exists("random_number")) {
-    RandomNumberBenchmark(thread_num, 100000000);
-  }
-  
-  if(argc == 1 || args.Exists("lem_simple")) {
-    LEMSimpleBenchmark(thread_num, 1024 * 1024 * 30, workload);
-  }
-  
-  if(argc == 1 || args.Exists("gem_simple")) {
-    GEMSimpleBenchmark(thread_num, 1024 * 1024 * 10, workload);
-  }
-  
+/*
+ * ClockCacheBenchmark() - Benchmarks ClockCache under Zipfian lookups
+ *
+ * Every operation looks up a key drawn from a Zipfian distribution with the
+ * given theta, and inserts the key on a miss as if it were loaded from
+ * a slower storage. If charge_bytes is true then each entry is charged
+ * between 64 and 4095 bytes depending on the key, and capacity is in bytes;
+ * otherwise capacity is the number of entries. Hit rate and throughput are
+ * both reported
+ */
+void ClockCacheBenchmark(uint64_t thread_num,
+                         uint64_t op_num,
+                         uint64_t key_num,
+                         uint64_t capacity,
+                         double theta,
+                         bool charge_bytes) {
+  PrintTestName("ClockCacheBenchmark");
+
+  ClockCacheEM *em = new ClockCacheEM{thread_num};
+
+  // With byte charges the average entry is around 2KB
+  ClockCacheType *cache =
+    new ClockCacheType{em,
+                       capacity,
+                       (charge_bytes == true) ? (capacity / 2048) : capacity};
+
+  ZipfianRandom zipf{key_num, theta};
+
+  std::atomic<uint64_t> hit_count;
+  hit_count.store(0);
+
+  auto func = [em, cache, op_num, charge_bytes,
+               &zipf, &hit_count](uint64_t id) {
+                SimpleInt64Random<> r{};
+                uint64_t local_hit_count = 0;
+
+                for(uint64_t i = 0;i < op_num;i++) {
+                  // Scatter hot keys over buckets
+                  uint64_t key = r(zipf(i, id), 0);
+                  uint64_t value;
+
+                  em->AnnounceEnter(id);
+
+                  if(cache->Lookup(key, value) == true) {
+                    local_hit_count++;
+                  } else if(charge_bytes == true) {
+                    cache->Insert(key, key, 64 + key % 4032);
+                  } else {
+                    cache->Insert(key, key);
+                  }
+                }
+
+                hit_count.fetch_add(local_hit_count);
+
+                return;
+              };
+
+  em->StartGCThread();
+
+  double duration = RunThreads(thread_num, func);
+
+  dbg_printf("Capacity = %lu %s, key num = %lu, theta = %f\n",
+             capacity,
+             (charge_bytes == true) ? "bytes" : "entries",
+             key_num,
+             theta);
+
+  dbg_printf("    Hit rate = %f; Entry count = %lu; Eviction count = %lu\n",
+             static_cast<double>(hit_count.load()) / (thread_num * op_num),
+             cache->GetEntryCount(),
+             cache->GetEvictionCount());
+
+  delete cache;
+  delete em;
+
+  dbg_printf("Tests of %lu threads, %lu operations each took %f seconds\n",
+             thread_num,
+             op_num,
+             duration);
+
+  dbg_printf("    Throughput = %f M op/sec\n",
+             static_cast<double>(thread_num * op_num) / duration / (1024.0 * 1024.0));
+
+  Harness.Record(BenchmarkHarness::Format("ClockCache, theta = %.2f, %s, %lu threads",
+                                          theta,
+                                          (charge_bytes == true) ? "bytes" : "entries",
+                                          thread_num),
+                 static_cast<double>(thread_num * op_num) / duration / (1024.0 * 1024.0),
+                 "M op/sec");
+
+  dbg_printf("    Throughput Per Thread = %f M op/sec\n",
+             static_cast<double>(op_num) / duration / (1024.0 * 1024.0));
+
+  return;
+}
+
+/*
+ * RunReadMostly() - Runs read_func on thread_num reader threads, while
+ *                   another thread calls update_func every
+ *                   update_interval_us microseconds until all readers finish
+ *
+ * read_func takes the thread ID and the iteration, and returns a number
+ * that is summed up to avoid the read being optimized out. Returns the
+ * duration of readers in seconds
+ */
+template <typename ReadFunc, typename UpdateFunc>
+double RunReadMostly(uint64_t thread_num,
+                     uint64_t op_num,
+                     uint64_t update_interval_us,
+                     ReadFunc &&read_func,
+                     UpdateFunc &&update_func) {
+  std::atomic<uint64_t> reader_done;
+  reader_done.store(0);
+
+  std::atomic<uint64_t> sum;
+  sum.store(0);
+
+  uint64_t update_count = 0;
+
+  auto func = [thread_num, op_num, update_interval_us,
+               &read_func, &update_func,
+               &reader_done, &sum, &update_count](uint64_t id) {
+                // The last thread is the writer
+                if(id == thread_num) {
+                  while(reader_done.load() < thread_num) {
+                    update_func(id);
+                    update_count++;
+
+                    std::this_thread::sleep_for(
+                      std::chrono::microseconds{update_interval_us});
+                  }
+
+                  return;
+                }
+
+                uint64_t local_sum = 0;
+                for(uint64_t i = 0;i < op_num;i++) {
+                  local_sum += read_func(id, i);
+                }
+
+                sum.fetch_add(local_sum);
+                reader_done.fetch_add(1);
+
+                return;
+              };
+
+  double duration = RunThreads(thread_num + 1, func);
+
+  dbg_printf("    Updates = %lu; Checksum = %lu\n", update_count, sum.load());
+
+  return duration;
+}
+
+/*
+ * RCUPointerBenchmark() - Compares reading a shared object through
+ *                         RCUPointer against std::shared_ptr
+ *
+ * Three ways of sharing the object are measured with thread_num readers
+ * and one writer that replaces the object periodically:
+ *   1. RCUPointer with LocalWriteEM; a read is an epoch announcement plus
+ *      a pointer load
+ *   2. std::shared_ptr with std::atomic_load() / std::atomic_store()
+ *   3. std::shared_ptr guarded by a mutex
+ * Both shared_ptr versions do an atomic RMW on the reference count of the
+ * same object for every read
+ */
+void RCUPointerBenchmark(uint64_t thread_num,
+                         uint64_t op_num,
+                         uint64_t update_interval_us) {
+  PrintTestName("RCUPointerBenchmark");
+
+  dbg_printf("%lu readers, %lu reads each, update every %lu us\n",
+             thread_num,
+             op_num,
+             update_interval_us);
+
+  // RCUPointer needs an epoch counter for the writer as well
+  RCUPointerEM *em = new RCUPointerEM{thread_num + 1};
+  RCUPointerType *rcu_p = new RCUPointerType{em, new SharedObjectType(16, 0)};
+
+  em->StartGCThread();
+
+  double duration = RunReadMostly(
+    thread_num,
+    op_num,
+    update_interval_us,
+    [em, rcu_p](uint64_t id, uint64_t i) {
+      em->AnnounceEnter(id);
+
+      return (*rcu_p->Load())[i & 0xF];
+    },
+    [em, rcu_p](uint64_t id) {
+      em->AnnounceEnter(id);
+
+      rcu_p->Update([](const SharedObjectType *object_p) {
+                      return new SharedObjectType(16, (*object_p)[0] + 1);
+                    });
+    });
+
+  delete rcu_p;
+  delete em;
+
+  dbg_printf("RCUPointer: %f seconds; Throughput = %f M op/sec\n",
+             duration,
+             static_cast<double>(thread_num * op_num) / duration / (1024.0 * 1024.0));
+
+  Harness.Record(BenchmarkHarness::Format("RCUPointer, %lu threads",
+                                          thread_num),
+                 static_cast<double>(thread_num * op_num) / duration / (1024.0 * 1024.0),
+                 "M op/sec");
+
+  std::shared_ptr<SharedObjectType> shared_p{new SharedObjectType(16, 0)};
+
+  duration = RunReadMostly(
+    thread_num,
+    op_num,
+    update_interval_us,
+    [&shared_p](uint64_t, uint64_t i) {
+      std::shared_ptr<SharedObjectType> local_p = std::atomic_load(&shared_p);
+
+      return (*local_p)[i & 0xF];
+    },
+    [&shared_p](uint64_t) {
+      std::shared_ptr<SharedObjectType> local_p = std::atomic_load(&shared_p);
+      std::atomic_store(&shared_p,
+                        std::make_shared<SharedObjectType>(16, (*local_p)[0] + 1));
+    });
+
+  dbg_printf("atomic shared_ptr: %f seconds; Throughput = %f M op/sec\n",
+             duration,
+             static_cast<double>(thread_num * op_num) / duration / (1024.0 * 1024.0));
+
+  Harness.Record(BenchmarkHarness::Format("RCUPointer, atomic shared_ptr, %lu threads",
+                                          thread_num),
+                 static_cast<double>(thread_num * op_num) / duration / (1024.0 * 1024.0),
+                 "M op/sec");
+
+  std::mutex shared_lock;
+
+  duration = RunReadMostly(
+    thread_num,
+    op_num,
+    update_interval_us,
+    [&shared_p, &shared_lock](uint64_t, uint64_t i) {
+      std::shared_ptr<SharedObjectType> local_p;
+      {
+        std::lock_guard<std::mutex> guard{shared_lock};
+        local_p = shared_p;
+      }
+
+      return (*local_p)[i & 0xF];
+    },
+    [&shared_p, &shared_lock](uint64_t) {
+      std::lock_guard<std::mutex> guard{shared_lock};
+      shared_p = std::make_shared<SharedObjectType>(16, (*shared_p)[0] + 1);
+    });
+
+  dbg_printf("mutex shared_ptr: %f seconds; Throughput = %f M op/sec\n",
+             duration,
+             static_cast<double>(thread_num * op_num) / duration / (1024.0 * 1024.0));
+
+  Harness.Record(BenchmarkHarness::Format("RCUPointer, mutex shared_ptr, %lu threads",
+                                          thread_num),
+                 static_cast<double>(thread_num * op_num) / duration / (1024.0 * 1024.0),
+                 "M op/sec");
+
+  return;
+}
+
+/*
+ * ConcurrentVectorBenchmark() - Benchmarks ConcurrentVector with readers
+ *                               accessing random indices while the vector
+ *                               keeps growing
+ *
+ * read_ratio is the percentage of Get() among all operations, and the rest
+ * are PushBack(). The vector starts with a single small segment such that
+ * the directory is replaced many times during the benchmark
+ */
+void ConcurrentVectorBenchmark(uint64_t thread_num,
+                               uint64_t op_num,
+                               uint64_t read_ratio) {
+  PrintTestName("ConcurrentVectorBenchmark");
+
+  VectorEM *em = new VectorEM{thread_num};
+  VectorType *v = new VectorType{em, 256};
+
+  // Such that readers always have something to read
+  v->PushBack(1);
+
+  auto func = [em, v, op_num, read_ratio](uint64_t id) {
+                SimpleInt64Random<> r{};
+                uint64_t sum = 0;
+
+                for(uint64_t i = 0;i < op_num;i++) {
+                  em->AnnounceEnter(id);
+
+                  if((r(i, id + 1024) % 100) < read_ratio) {
+                    sum += v->Get(r(i, id) % v->GetSize());
+                  } else {
+                    v->PushBack(i + 1);
+                  }
+                }
+
+                // Avoid reads being optimized out
+                v->Set(0, sum);
+
+                return;
+              };
+
+  em->StartGCThread();
+
+  double duration = RunThreads(thread_num, func);
+
+  dbg_printf("Read ratio = %lu%%, size = %lu, capacity = %lu\n",
+             read_ratio,
+             v->GetSize(),
+             v->GetCapacity());
+
+  delete v;
+  delete em;
+
+  dbg_printf("Tests of %lu threads, %lu operations each took %f seconds\n",
+             thread_num,
+             op_num,
+             duration);
+
+  dbg_printf("    Throughput = %f M op/sec\n",
+             static_cast<double>(thread_num * op_num) / duration / (1024.0 * 1024.0));
+
+  Harness.Record(BenchmarkHarness::Format("ConcurrentVector, %lu%% read, %lu threads",
+                                          read_ratio,
+                                          thread_num),
+                 static_cast<double>(thread_num * op_num) / duration / (1024.0 * 1024.0),
+                 "M op/sec");
+
+  dbg_printf("    Throughput Per Thread = %f M op/sec\n",
+             static_cast<double>(op_num) / duration / (1024.0 * 1024.0));
+
+  return;
+}
+
+/*
+ * DeferredFreeBenchmark() - Compares retiring small objects one by one
+ *                           with AddGarbageNode() against batching them
+ *                           with DeferredFreeContext
+ *
+ * Each thread allocates and retires op_num 8 byte objects. Threads share
+ * the EM and, in the batched case, also the context. The GC thread is
+ * running in both cases such that the cost of freeing is also included
+ */
+void DeferredFreeBenchmark(uint64_t thread_num, uint64_t op_num) {
+  PrintTestName("DeferredFreeBenchmark");
+
+  using DirectEM = LocalWriteEM<uint64_t>;
+  DirectEM *direct_em = new DirectEM{thread_num};
+  direct_em->StartGCThread();
+
+  LatencyRecorder direct_recorder{thread_num};
+
+  auto direct_func = [direct_em, op_num, &direct_recorder](uint64_t id) {
+                       LatencyHistogram *histogram_p = \
+                         direct_recorder.GetHistogram(id);
+
+                       for(uint64_t i = 0;i < op_num;i++) {
+                         direct_em->AnnounceEnter(id);
+
+                         uint64_t *p = new uint64_t{i};
+                         if(direct_recorder.IsSampled(i) == true) {
+                           uint64_t start = TSCTimer::Start();
+                           direct_em->AddGarbageNode(p);
+                           histogram_p->Record(TSCTimer::End() - start);
+                         } else {
+                           direct_em->AddGarbageNode(p);
+                         }
+                       }
+
+                       return;
+                     };
+
+  double duration = RunThreads(thread_num, direct_func);
+
+  delete direct_em;
+
+  dbg_printf("AddGarbageNode(): %f seconds; Throughput = %f M op/sec\n",
+             duration,
+             static_cast<double>(thread_num * op_num) / duration / (1024.0 * 1024.0));
+
+  Harness.Record(BenchmarkHarness::Format("DeferredFree, AddGarbageNode(), %lu threads",
+                                          thread_num),
+                 static_cast<double>(thread_num * op_num) / duration / (1024.0 * 1024.0),
+                 "M op/sec");
+
+  direct_recorder.Print("AddGarbageNode()");
+
+  DeferredContextEM *em = new DeferredContextEM{thread_num};
+  DeferredContextType *context = new DeferredContextType{em};
+  em->StartGCThread();
+
+  LatencyRecorder batch_recorder{thread_num};
+
+  auto batch_func = [em, context, op_num, &batch_recorder](uint64_t id) {
+                      LatencyHistogram *histogram_p = \
+                        batch_recorder.GetHistogram(id);
+
+                      for(uint64_t i = 0;i < op_num;i++) {
+                        em->AnnounceEnter(id);
+
+                        uint64_t *p = new uint64_t{i};
+                        if(batch_recorder.IsSampled(i) == true) {
+                          uint64_t start = TSCTimer::Start();
+                          context->Retire(p);
+                          histogram_p->Record(TSCTimer::End() - start);
+                        } else {
+                          context->Retire(p);
+                        }
+                      }
+
+                      return;
+                    };
+
+  duration = RunThreads(thread_num, batch_func);
+
+  delete context;
+  delete em;
+
+  dbg_printf("DeferredFreeContext: %f seconds; Throughput = %f M op/sec\n",
+             duration,
+             static_cast<double>(thread_num * op_num) / duration / (1024.0 * 1024.0));
+
+  Harness.Record(BenchmarkHarness::Format("DeferredFree, DeferredFreeContext, %lu threads",
+                                          thread_num),
+                 static_cast<double>(thread_num * op_num) / duration / (1024.0 * 1024.0),
+                 "M op/sec");
+
+  batch_recorder.Print("Retire()");
+
+  return;
+}
+
+/*
+ * VarLenPoolScaleBenchmark() - Compares the shared appending tail of
+ *                              VarLenPool against per-thread owned chunks
+ *                              with increasing number of threads
+ *
+ * Each thread allocates 32 byte objects and frees them in a sliding window
+ * of 64. The EM and the GC thread of the pool are running in both cases
+ */
+void VarLenPoolScaleBenchmark(uint64_t thread_num, uint64_t op_num) {
+  PrintTestName("VarLenPoolScaleBenchmark");
+
+  for(uint64_t num = 1;num <= thread_num;num *= 2) {
+    for(int owned = 0;owned < 2;owned++) {
+      VarLenPool::EMType *em = new VarLenPool::EMType{num};
+      em->StartGCThread();
+
+      VarLenPool *vlp = new VarLenPool{1024 * 64, em, num};
+      vlp->StartGCThread();
+
+      auto func = [em, vlp, op_num, owned](uint64_t id) {
+                    void *p_list[64] = {};
+                    for(uint64_t i = 0;i < op_num;i++) {
+                      em->AnnounceEnter(id);
+
+                      uint64_t index = i % 64;
+                      if(p_list[index] != nullptr) {
+                        vlp->Free(p_list[index]);
+                      }
+
+                      if(owned == 1) {
+                        p_list[index] = vlp->Allocate(32, id);
+                      } else {
+                        p_list[index] = vlp->Allocate(32);
+                      }
+                    }
+
+                    for(uint64_t i = 0;i < 64;i++) {
+                      vlp->Free(p_list[i]);
+                    }
+
+                    return;
+                  };
+
+      double duration = RunThreads(num, func);
+
+      delete vlp;
+      delete em;
+
+      dbg_printf("%s, %lu threads: %f seconds; Throughput = %f M op/sec\n",
+                 (owned == 1) ? "Owned chunks" : "Shared tail",
+                 num,
+                 duration,
+                 static_cast<double>(num * op_num) / duration / (1024.0 * 1024.0));
+
+      Harness.Record(BenchmarkHarness::Format("VarLenPoolScale, %s, %lu threads",
+                                              (owned == 1) ? "Owned chunks" : "Shared tail",
+                                              num),
+                     static_cast<double>(num * op_num) / duration / (1024.0 * 1024.0),
+                     "M op/sec");
+    }
+  }
+
+  return;
+}
+
+/*
+ * VarLenPoolFragmentationBenchmark() - Compares memory footprint of
+ *                                      VarLenPool with and without reusing
+ *                                      freed blocks through size classes
+ *
+ * Each thread keeps long_num long-lived objects and a window of 64
+ * short-lived objects of random sizes between 16 and 128 bytes. One of
+ * every 16 operations replaces a random long-lived object, such that
+ * long-lived objects are scattered over chunks that are otherwise empty.
+ * Footprint is the maximum number of chunks times the chunk size
+ */
+void VarLenPoolFragmentationBenchmark(uint64_t thread_num, 
+                                      uint64_t op_num,
+                                      uint64_t long_num) {
+  PrintTestName("VarLenPoolFragmentationBenchmark");
+
+  static const uint64_t chunk_size = 1024 * 64;
+
+  for(int sized = 0;sized < 2;sized++) {
+    VarLenPool::EMType *em = new VarLenPool::EMType{thread_num};
+    em->SetGCInterval(1);
+    em->StartGCThread();
+
+    VarLenPool *vlp = new VarLenPool{chunk_size, em, thread_num};
+    vlp->SetGCInterval(5);
+    vlp->StartGCThread();
+
+    std::atomic<uint64_t> max_chunk_count;
+    max_chunk_count.store(0);
+    std::atomic<uint64_t> live_size;
+    live_size.store(0);
+
+    auto func = [em, vlp, op_num, long_num, sized, &max_chunk_count, &live_size](uint64_t id) {
+                  SimpleInt64Random<> r{};
+                  std::vector<std::pair<void *, uint64_t>> long_list(long_num, {nullptr, 0});
+                  std::vector<std::pair<void *, uint64_t>> short_list(64, {nullptr, 0});
+
+                  for(uint64_t i = 0;i < op_num;i++) {
+                    em->AnnounceEnter(id);
+
+                    std::pair<void *, uint64_t> *item_p = nullptr;
+                    if((i % 16) == 0) {
+                      item_p = &long_list[r(i, id) % long_num];
+                    } else {
+                      item_p = &short_list[i % 64];
+                    }
+
+                    if(item_p->first != nullptr) {
+                      if(sized == 1) {
+                        vlp->Free(item_p->first, item_p->second, id);
+                      } else {
+                        vlp->Free(item_p->first);
+                      }
+                    }
+
+                    item_p->second = 16 + r(i, id + 1000) % 113;
+                    item_p->first = vlp->Allocate(item_p->second, id);
+
+                    if((id == 0) && ((i % 1024) == 0)) {
+                      uint64_t chunk_count = vlp->GetChunkCount();
+                      if(chunk_count > max_chunk_count.load()) {
+                        max_chunk_count.store(chunk_count);
+                      }
+                    }
+                  }
+
+                  uint64_t size = 0;
+                  for(auto &item : long_list) {
+                    size += item.second;
+                  }
+
+                  for(auto &item : short_list) {
+                    size += item.second;
+                  }
+
+                  live_size.fetch_add(size);
+
+                  return;
+                };
+
+    double duration = RunThreads(thread_num, func);
+
+    // Objects are not freed, since the pool frees all chunks at once
+    delete vlp;
+    delete em;
+
+    double footprint = static_cast<double>(max_chunk_count.load() * chunk_size);
+    dbg_printf("%s: %f seconds; Throughput = %f M op/sec\n",
+               (sized == 1) ? "Size class free lists" : "Bump only",
+               duration,
+               static_cast<double>(thread_num * op_num) / duration / (1024.0 * 1024.0));
+
+    Harness.Record(BenchmarkHarness::Format("VarLenPoolFragmentation, %s, %lu threads",
+                                            (sized == 1) ? "Size class free lists" : "Bump only",
+                                            thread_num),
+                   static_cast<double>(thread_num * op_num) / duration / (1024.0 * 1024.0),
+                   "M op/sec");
+    dbg_printf("    Footprint = %f MB; Live data = %f MB; Ratio = %f\n",
+               footprint / (1024.0 * 1024.0),
+               static_cast<double>(live_size.load()) / (1024.0 * 1024.0),
+               footprint / static_cast<double>(live_size.load()));
+  }
+
+  return;
+}
+
+/*
+ * VarLenPoolTLBBenchmark() - Chases pointers in random order over objects
+ *                            allocated from VarLenPool with different
+ *                            chunk providers
+ *
+ * Objects are 64 bytes and linked into a single random cycle, so almost
+ * every step touches another page. With huge pages the page table of the
+ * whole working set fits in the TLB much better. Each thread starts from
+ * a different object
+ */
+void VarLenPoolTLBBenchmark(uint64_t thread_num,
+                            uint64_t object_num,
+                            uint64_t step_num) {
+  PrintTestName("VarLenPoolTLBBenchmark");
+
+  /*
+   * class Object - A node of the random cycle
+   */
+  class Object {
+   public:
+    Object *next_p;
+    uint64_t data[7];
+  };
+
+  using HugePageMode = MmapChunkProvider::HugePageMode;
+
+  std::vector<uint64_t> index_list(object_num);
+  for(uint64_t i = 0;i < object_num;i++) {
+    index_list[i] = i;
+  }
+
+  std::shuffle(index_list.begin(), index_list.end(), std::mt19937_64{0});
+
+  const char *name_list[] = {"Heap", "mmap", "mmap + MADV_HUGEPAGE", "mmap + MAP_HUGETLB"};
+  for(int k = 0;k < 4;k++) {
+    MmapChunkProvider *provider_p = nullptr;
+    if(k == 1) {
+      provider_p = new MmapChunkProvider{HugePageMode::NONE};
+    } else if(k == 2) {
+      provider_p = new MmapChunkProvider{HugePageMode::MADVISE};
+    } else if(k == 3) {
+      provider_p = new MmapChunkProvider{HugePageMode::HUGETLB};
+    }
+
+    VarLenPool *vlp = new VarLenPool{MmapChunkProvider::HUGE_PAGE_SIZE,
+                                     nullptr,
+                                     0,
+                                     provider_p};
+
+    std::vector<Object *> object_list(object_num);
+    for(uint64_t i = 0;i < object_num;i++) {
+      object_list[i] = reinterpret_cast<Object *>(vlp->Allocate(sizeof(Object)));
+    }
+
+    for(uint64_t i = 0;i < object_num;i++) {
+      object_list[index_list[i]]->next_p = object_list[index_list[(i + 1) % object_num]];
+    }
+
+    std::atomic<uint64_t> sum;
+    sum.store(0);
+
+    auto func = [object_num, step_num, &object_list, &sum](uint64_t id) {
+                  Object *object_p = object_list[(id * 7919) % object_num];
+                  for(uint64_t i = 0;i < step_num;i++) {
+                    object_p = object_p->next_p;
+                  }
+
+                  // Such that the loop is not optimized away
+                  sum.fetch_add(reinterpret_cast<uint64_t>(object_p));
+
+                  return;
+                };
+
+    double duration = RunThreads(thread_num, func);
+
+    dbg_printf("%s: %f seconds; Throughput = %f M op/sec\n",
+               name_list[k],
+               duration,
+               static_cast<double>(thread_num * step_num) / duration / (1024.0 * 1024.0));
+
+    Harness.Record(BenchmarkHarness::Format("VarLenPoolTLB, %s, %lu threads",
+                                            name_list[k],
+                                            thread_num),
+                   static_cast<double>(thread_num * step_num) / duration / (1024.0 * 1024.0),
+                   "M op/sec");
+    if(k == 3) {
+      dbg_printf("    HugeTLB chunks = %lu; Fallback chunks = %lu\n",
+                 provider_p->GetHugeTLBCount(),
+                 provider_p->GetFallbackCount());
+    }
+
+    delete vlp;
+    delete provider_p;
+  }
+
+  return;
+}
+
+/*
+ * VarLenPoolChurnBenchmark() - Compares allocation latency of VarLenPool
+ *                              with and without the chunk cache under
+ *                              steady-state chunk churn
+ *
+ * Each thread allocates 256 byte objects in a sliding window of 1024, so
+ * chunks are retired at the same rate as they are created. Chunks are 1MB
+ * and mapped with mmap(), such that without the cache every new chunk
+ * is a fresh mapping which is page faulted in. Every Allocate() is timed,
+ * and the number of allocations slower than 20us and the maximum are
+ * reported
+ */
+void VarLenPoolChurnBenchmark(uint64_t thread_num, uint64_t op_num) {
+  PrintTestName("VarLenPoolChurnBenchmark");
+
+  for(uint64_t cache_size = 0;cache_size <= 64;cache_size += 64) {
+    MmapChunkProvider provider{};
+
+    VarLenPool::EMType *em = new VarLenPool::EMType{thread_num};
+    em->SetGCInterval(1);
+    em->StartGCThread();
+
+    VarLenPool *vlp = new VarLenPool{1024 * 1024, em, thread_num, &provider};
+    vlp->SetChunkCacheSize(cache_size);
+    vlp->SetGCInterval(1);
+    vlp->StartGCThread();
+
+    std::atomic<uint64_t> slow_count;
+    slow_count.store(0);
+    std::atomic<uint64_t> max_latency;
+    max_latency.store(0);
+
+    auto func = [em, vlp, op_num, &slow_count, &max_latency](uint64_t id) {
+                  std::vector<void *> p_list(1024, nullptr);
+                  uint64_t slow = 0;
+                  uint64_t max = 0;
+
+                  for(uint64_t i = 0;i < op_num;i++) {
+                    em->AnnounceEnter(id);
+
+                    uint64_t index = i % 1024;
+                    if(p_list[index] != nullptr) {
+                      vlp->Free(p_list[index]);
+                    }
+
+                    auto start = std::chrono::steady_clock::now();
+                    p_list[index] = vlp->Allocate(256, id);
+                    auto end = std::chrono::steady_clock::now();
+
+                    // Touch the object as the user would
+                    memset(p_list[index], 0, 256);
+
+                    uint64_t latency = \
+                      std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+                    if(latency > 20000) {
+                      slow++;
+                    }
+
+                    if(latency > max) {
+                      max = latency;
+                    }
+                  }
+
+                  for(void *p : p_list) {
+                    vlp->Free(p);
+                  }
+
+                  vlp->ReleaseThreadChunk(id);
+
+                  slow_count.fetch_add(slow);
+
+                  uint64_t current = max_latency.load();
+                  while((max > current) &&
+                        (max_latency.compare_exchange_strong(current, max) == false));
+
+                  return;
+                };
+
+    double duration = RunThreads(thread_num, func);
+
+    uint64_t cached_count = vlp->GetCachedChunkCount();
+
+    delete vlp;
+    delete em;
+
+    dbg_printf("Chunk cache size = %lu: %f seconds; Throughput = %f M op/sec\n",
+               cache_size,
+               duration,
+               static_cast<double>(thread_num * op_num) / duration / (1024.0 * 1024.0));
+
+    Harness.Record(BenchmarkHarness::Format("VarLenPoolChurn, cache size = %lu, %lu threads",
+                                            cache_size,
+                                            thread_num),
+                   static_cast<double>(thread_num * op_num) / duration / (1024.0 * 1024.0),
+                   "M op/sec");
+    dbg_printf("    Allocations > 20us = %lu; Max latency = %lu ns; Cached chunks at the end = %lu\n",
+               slow_count.load(),
+               max_latency.load(),
+               cached_count);
+  }
+
+  return;
+}
+
+/*
+ * VarLenPoolRegionBenchmark() - Compares freeing batch-lifetime objects one
+ *                               by one against releasing their region
+ *
+ * Each thread allocates batches of 64 objects of 48 bytes from its slot
+ * and touches them. At the end of a batch they are either freed with 
+ * Free(p), which is a CAS on the chunk header each, or released at once
+ * with ReleaseRegion()
+ */
+void VarLenPoolRegionBenchmark(uint64_t thread_num, uint64_t op_num) {
+  PrintTestName("VarLenPoolRegionBenchmark");
+
+  static constexpr uint64_t batch_size = 64;
+
+  for(int region_flag = 0;region_flag <= 1;region_flag++) {
+    VarLenPool::EMType *em = new VarLenPool::EMType{thread_num};
+    em->SetGCInterval(1);
+    em->StartGCThread();
+
+    VarLenPool *vlp = new VarLenPool{64 * 1024, em, thread_num};
+    vlp->SetGCInterval(1);
+    vlp->StartGCThread();
+
+    auto func = [em, vlp, op_num, region_flag](uint64_t id) {
+                  void *p_list[batch_size];
+
+                  for(uint64_t i = 0;i < op_num;i += batch_size) {
+                    em->AnnounceEnter(id);
+
+                    for(uint64_t j = 0;j < batch_size;j++) {
+                      if(region_flag == 1) {
+                        p_list[j] = vlp->AllocateRegion(48, id);
+                      } else {
+                        p_list[j] = vlp->Allocate(48, id);
+                      }
+
+                      memset(p_list[j], 0, 48);
+                    }
+
+                    if(region_flag == 1) {
+                      vlp->ReleaseRegion(id);
+                    } else {
+                      for(uint64_t j = 0;j < batch_size;j++) {
+                        vlp->Free(p_list[j]);
+                      }
+                    }
+                  }
+
+                  vlp->ReleaseThreadChunk(id);
+
+                  return;
+                };
+
+    double duration = RunThreads(thread_num, func);
+
+    delete vlp;
+    delete em;
+
+    dbg_printf("%s, %lu threads: %f seconds; Throughput = %f M op/sec\n",
+               (region_flag == 1) ? "Region" : "Free()",
+               thread_num,
+               duration,
+               static_cast<double>(thread_num * op_num) / duration / (1024.0 * 1024.0));
+
+    Harness.Record(BenchmarkHarness::Format("VarLenPoolRegion, %s, %lu threads",
+                                            (region_flag == 1) ? "Region" : "Free()",
+                                            thread_num),
+                   static_cast<double>(thread_num * op_num) / duration / (1024.0 * 1024.0),
+                   "M op/sec");
+  }
+
+  return;
+}
+
+/*
+ * VarLenPoolReallocateBenchmark() - Compares growing buffers by copying
+ *                                   against Reallocate()
+ *
+ * Each thread grows a buffer from 16 to 512 bytes in 16 byte steps,
+ * writing the new bytes after each step, and then frees it. With copying
+ * every step allocates a new block and copies the old one. Both the
+ * shared list and thread slots are measured, and the number of steps that
+ * still move the buffer is reported
+ */
+void VarLenPoolReallocateBenchmark(uint64_t thread_num, uint64_t op_num) {
+  PrintTestName("VarLenPoolReallocateBenchmark");
+
+  static constexpr uint64_t step_size = 16;
+  static constexpr uint64_t max_size = 512;
+
+  for(int slot_flag = 0;slot_flag <= 1;slot_flag++) {
+    for(int reallocate_flag = 0;reallocate_flag <= 1;reallocate_flag++) {
+      VarLenPool::EMType *em = new VarLenPool::EMType{thread_num};
+      em->SetGCInterval(1);
+      em->StartGCThread();
+
+      VarLenPool *vlp = new VarLenPool{64 * 1024, em, thread_num};
+      vlp->SetGCInterval(1);
+      vlp->StartGCThread();
+
+      std::atomic<uint64_t> move_count;
+      move_count.store(0);
+
+      auto func = [em, vlp, op_num, slot_flag, reallocate_flag, &move_count](uint64_t id) {
+                    uint64_t move = 0;
+
+                    for(uint64_t i = 0;i < op_num;i += max_size / step_size) {
+                      em->AnnounceEnter(id);
+
+                      char *p = nullptr;
+                      for(size_t sz = step_size;sz <= max_size;sz += step_size) {
+                        size_t old_sz = sz - step_size;
+                        char *new_p = nullptr;
+
+                        if(reallocate_flag == 1) {
+                          if(slot_flag == 1) {
+                            new_p = static_cast<char *>(vlp->Reallocate(p, old_sz, sz, id));
+                          } else {
+                            new_p = static_cast<char *>(vlp->Reallocate(p, old_sz, sz));
+                          }
+                        } else {
+                          if(slot_flag == 1) {
+                            new_p = static_cast<char *>(vlp->Allocate(sz, id));
+                          } else {
+                            new_p = static_cast<char *>(vlp->Allocate(sz));
+                          }
+
+                          if(p != nullptr) {
+                            memcpy(new_p, p, old_sz);
+                            if(slot_flag == 1) {
+                              vlp->Free(p, old_sz, id);
+                            } else {
+                              vlp->Free(p);
+                            }
+                          }
+                        }
+
+                        if((p != nullptr) && (new_p != p)) {
+                          move++;
+                        }
+
+                        p = new_p;
+                        memset(p + old_sz, 0, step_size);
+                      }
+
+                      if(slot_flag == 1) {
+                        vlp->Free(p, max_size, id);
+                      } else {
+                        vlp->Free(p);
+                      }
+                    }
+
+                    if(slot_flag == 1) {
+                      vlp->ReleaseThreadChunk(id);
+                    }
+
+                    move_count.fetch_add(move);
+
+                    return;
+                  };
+
+      double duration = RunThreads(thread_num, func);
+
+      delete vlp;
+      delete em;
+
+      dbg_printf("%s, %s, %lu threads: %f seconds; Throughput = %f M op/sec; Moves = %lu\n",
+                 (slot_flag == 1) ? "Thread slot" : "Shared tail",
+                 (reallocate_flag == 1) ? "Reallocate()" : "Copy",
+                 thread_num,
+                 duration,
+                 static_cast<double>(thread_num * op_num) / duration / (1024.0 * 1024.0),
+                 move_count.load());
+
+      Harness.Record(BenchmarkHarness::Format("VarLenPoolReallocate, %s, %s, %lu threads",
+                                              (slot_flag == 1) ? "Thread slot" : "Shared tail",
+                                              (reallocate_flag == 1) ? "Reallocate()" : "Copy",
+                                              thread_num),
+                     static_cast<double>(thread_num * op_num) / duration / (1024.0 * 1024.0),
+                     "M op/sec");
+    }
+  }
+
+  return;
+}
+
+/*
+ * ReadProcStatus() - Returns a field of /proc/self/status in KB, such as
+ *                    "VmRSS" or "VmHWM"
+ *
+ * Returns 0 if the field is not there
+ */
+uint64_t ReadProcStatus(const char *field) {
+  FILE *fp = fopen("/proc/self/status", "r");
+  if(fp == nullptr) {
+    return 0;
+  }
+
+  size_t field_len = strlen(field);
+  uint64_t value = 0;
+
+  char line[256];
+  while(fgets(line, sizeof(line), fp) != nullptr) {
+    if((strncmp(line, field, field_len) == 0) && (line[field_len] == ':')) {
+      value = strtoull(line + field_len + 1, nullptr, 10);
+      break;
+    }
+  }
+
+  fclose(fp);
+
+  return value;
+}
+
+/*
+ * ResetPeakRSS() - Resets the peak resident set size of the process to the
+ *                  current one
+ *
+ * Writing 5 to clear_refs does this since Linux 4.0. If it fails, peaks of
+ * earlier runs are included in the next one
+ */
+bool ResetPeakRSS() {
+  FILE *fp = fopen("/proc/self/clear_refs", "w");
+  if(fp == nullptr) {
+    return false;
+  }
+
+  bool ret = (fputs("5", fp) >= 0);
+  ret = (fclose(fp) == 0) && ret;
+
+  return ret;
+}
+
+/*
+ * GetDeltaSize() - Returns the size of a random node of DeltaChainIndex
+ *                  with 8 byte keys and values
+ *
+ * With the default consolidation threshold of 8, each consolidation
+ * replaces 8 delta records with a base node and its item array. Pages have
+ * 64 items on average in DeltaChainBenchmark, and we use 32 to 96 items
+ */
+inline size_t GetDeltaSize(uint64_t seed, uint64_t salt) {
+  using DeltaNode = LEMDeltaChainType::GarbageType;
+  static constexpr size_t insert_size = sizeof(DeltaNode) + 2 * sizeof(uint64_t);
+  static constexpr size_t delete_size = sizeof(DeltaNode) + sizeof(uint64_t);
+  static constexpr size_t base_size = \
+    sizeof(DeltaNode) + sizeof(std::vector<std::pair<uint64_t, uint64_t>>);
+
+  SimpleInt64Random<> r{};
+  uint64_t value = r(seed, salt);
+  uint64_t type = value % 10;
+
+  if(type < 4) {
+    return insert_size;
+  } else if(type < 8) {
+    return delete_size;
+  } else if(type == 8) {
+    return base_size;
+  }
+
+  return (32 + (value / 10) % 65) * 2 * sizeof(uint64_t);
+}
+
+/*
+ * class PoolAllocator - Allocates from the shared path of VarLenPool
+ *
+ * Allocators of AllocatorBenchmark() are given the thread id and the size
+ * on every call, and Exit() is called when a thread stops allocating
+ */
+class PoolAllocator {
+ protected:
+  VarLenPool::EMType *em;
+  VarLenPool *vlp;
+
+ public:
+
+  /*
+   * Constructor
+   */
+  PoolAllocator(uint64_t thread_num) :
+    em{new VarLenPool::EMType{thread_num}},
+    vlp{nullptr} {
+    em->SetGCInterval(1);
+    em->StartGCThread();
+
+    vlp = new VarLenPool{64 * 1024, em, thread_num};
+    vlp->SetGCInterval(1);
+    vlp->StartGCThread();
+
+    return;
+  }
+
+  /*
+   * Destructor
+   */
+  ~PoolAllocator() {
+    delete vlp;
+    delete em;
+
+    return;
+  }
+
+  static const char *GetName() {
+    return "VarLenPool";
+  }
+
+  inline void Enter(uint64_t thread_id) {
+    em->AnnounceEnter(thread_id);
+
+    return;
+  }
+
+  inline void *Allocate(size_t sz, uint64_t) {
+    return vlp->Allocate(sz);
+  }
+
+  inline void Free(void *p, size_t, uint64_t) {
+    vlp->Free(p);
+
+    return;
+  }
+
+  inline void Exit(uint64_t) {}
+};
+
+/*
+ * class SlotPoolAllocator - Allocates from thread slots of VarLenPool
+ *
+ * This takes the owned bump chunk and size class free lists of a slot, and
+ * the chunk is released when the thread exits
+ */
+class SlotPoolAllocator : public PoolAllocator {
+ public:
+
+  /*
+   * Constructor
+   */
+  SlotPoolAllocator(uint64_t thread_num) :
+    PoolAllocator{thread_num}
+  {}
+
+  static const char *GetName() {
+    return "VarLenPool (thread slots)";
+  }
+
+  inline void *Allocate(size_t sz, uint64_t thread_id) {
+    return vlp->Allocate(sz, thread_id);
+  }
+
+  inline void Free(void *p, size_t sz, uint64_t thread_id) {
+    vlp->Free(p, sz, thread_id);
+
+    return;
+  }
+
+  inline void Exit(uint64_t thread_id) {
+    vlp->ReleaseThreadChunk(thread_id);
+
+    return;
+  }
+};
+
+/*
+ * class MallocAllocator - Allocates with malloc(), which also backs new
+ */
+class MallocAllocator {
+ public:
+
+  /*
+   * Constructor
+   */
+  MallocAllocator(uint64_t) {}
+
+  static const char *GetName() {
+    return "malloc()";
+  }
+
+  inline void Enter(uint64_t) {}
+
+  inline void *Allocate(size_t sz, uint64_t) {
+    return malloc(sz);
+  }
+
+  inline void Free(void *p, size_t, uint64_t) {
+    free(p);
+
+    return;
+  }
+
+  inline void Exit(uint64_t) {}
+};
+
+/*
+ * class AllocatedBlock - A block and the size it is allocated with, which
+ *                        sized frees need
+ */
+class AllocatedBlock {
+ public:
+  void *p;
+  size_t sz;
+};
+
+/*
+ * class HandoffQueue - Bounded single producer single consumer queue that
+ *                      hands blocks from one thread to another
+ */
+class HandoffQueue {
+ public:
+  static constexpr uint64_t QUEUE_SIZE = 1024;
+
+ private:
+  // Padded such that the producer and the consumer do not share lines
+  std::atomic<uint64_t> head;
+  char head_padding[64 - sizeof(std::atomic<uint64_t>)];
+  std::atomic<uint64_t> tail;
+  char tail_padding[64 - sizeof(std::atomic<uint64_t>)];
+  AllocatedBlock slot_list[QUEUE_SIZE];
+
+ public:
+
+  /*
+   * Constructor
+   */
+  HandoffQueue() :
+    head{0},
+    tail{0}
+  {}
+
+  /*
+   * Push() - Adds a block at the tail, waiting if the queue is full
+   */
+  inline void Push(const AllocatedBlock &block) {
+    uint64_t index = tail.load(std::memory_order_relaxed);
+    while(index - head.load(std::memory_order_acquire) == QUEUE_SIZE) {
+      std::this_thread::yield();
+    }
+
+    slot_list[index % QUEUE_SIZE] = block;
+    tail.store(index + 1, std::memory_order_release);
+
+    return;
+  }
+
+  /*
+   * Pop() - Removes a block from the head, waiting if the queue is empty
+   */
+  inline AllocatedBlock Pop() {
+    uint64_t index = head.load(std::memory_order_relaxed);
+    while(tail.load(std::memory_order_acquire) == index) {
+      std::this_thread::yield();
+    }
+
+    AllocatedBlock block = slot_list[index % QUEUE_SIZE];
+    head.store(index + 1, std::memory_order_release);
+
+    return block;
+  }
+};
+
+/*
+ * enum class AllocPattern - Allocation patterns of AllocatorBenchmark()
+ */
+enum class AllocPattern {
+  ALLOC_ONLY,
+  PRODUCER_CONSUMER,
+  MIXED_LIFETIME,
+};
+
+/*
+ * TimedAllocate() - Allocates a block and writes it, and records the
+ *                   latency of sampled allocations
+ *
+ * Writing the block faults in its pages, such that RSS reflects the memory
+ * callers actually use
+ */
+template <typename AllocatorType>
+inline AllocatedBlock TimedAllocate(AllocatorType *allocator,
+                                    size_t sz,
+                                    uint64_t thread_id,
+                                    uint64_t i,
+                                    const LatencyRecorder &recorder,
+                                    LatencyHistogram *histogram_p) {
+  void *p;
+  if(recorder.IsSampled(i) == true) {
+    uint64_t start = TSCTimer::Start();
+    p = allocator->Allocate(sz, thread_id);
+    histogram_p->Record(TSCTimer::End() - start);
+  } else {
+    p = allocator->Allocate(sz, thread_id);
+  }
+
+  memset(p, 0, sz);
+
+  return AllocatedBlock{p, sz};
+}
+
+/*
+ * RunAllocPattern() - Runs one pattern with one allocator, and prints the
+ *                     throughput, sampled latency of allocations and the
+ *                     growth of the peak RSS
+ *
+ * Under ALLOC_ONLY each thread allocates op_num / 16 blocks, which are
+ * freed after the timer stops. Under PRODUCER_CONSUMER threads are paired,
+ * such that blocks allocated by one thread are freed by the other. Under
+ * MIXED_LIFETIME each thread frees most blocks 64 operations later, while
+ * one of every 16 replaces a random block in a table of 4096 long-lived
+ * ones. Sizes follow GetDeltaSize() in all patterns. Each thread calls
+ * Exit() of the allocator after its last free
+ */
+template <typename AllocatorType>
+void RunAllocPattern(AllocPattern pattern,
+                     const char *pattern_name,
+                     uint64_t thread_num,
+                     uint64_t op_num) {
+  static constexpr uint64_t window_size = 64;
+  static constexpr uint64_t long_num = 4096;
+
+  if(pattern == AllocPattern::PRODUCER_CONSUMER) {
+    thread_num = (thread_num < 2) ? 2 : (thread_num & ~0x1UL);
+  } else if(pattern == AllocPattern::ALLOC_ONLY) {
+    op_num /= 16;
+  }
+
+  bool reset_flag = ResetPeakRSS();
+  uint64_t start_rss = ReadProcStatus("VmRSS");
+
+  AllocatorType *allocator = new AllocatorType{thread_num};
+
+  std::vector<HandoffQueue> queue_list(thread_num / 2);
+  std::vector<std::vector<AllocatedBlock>> block_list_list(thread_num);
+  LatencyRecorder recorder{thread_num};
+
+  auto func = [&](uint64_t id) {
+                LatencyHistogram *histogram_p = recorder.GetHistogram(id);
+
+                if(pattern == AllocPattern::ALLOC_ONLY) {
+                  std::vector<AllocatedBlock> &block_list = \
+                    block_list_list[id];
+                  block_list.reserve(op_num);
+
+                  for(uint64_t i = 0;i < op_num;i++) {
+                    allocator->Enter(id);
+                    block_list.push_back(TimedAllocate(allocator,
+                                                       GetDeltaSize(i, id),
+                                                       id,
+                                                       i,
+                                                       recorder,
+                                                       histogram_p));
+                  }
+
+                  // The thread frees its blocks and exits after the timer
+                  return;
+                } else if(pattern == AllocPattern::PRODUCER_CONSUMER) {
+                  HandoffQueue *queue_p = &queue_list[id / 2];
+
+                  for(uint64_t i = 0;i < op_num;i++) {
+                    allocator->Enter(id);
+
+                    if(id % 2 == 0) {
+                      queue_p->Push(TimedAllocate(allocator,
+                                                  GetDeltaSize(i, id),
+                                                  id,
+                                                  i,
+                                                  recorder,
+                                                  histogram_p));
+                    } else {
+                      AllocatedBlock block = queue_p->Pop();
+                      allocator->Free(block.p, block.sz, id);
+                    }
+                  }
+                } else {
+                  SimpleInt64Random<> r{};
+                  AllocatedBlock window[window_size] = {};
+                  std::vector<AllocatedBlock> long_list(long_num,
+                                                        AllocatedBlock{});
+
+                  for(uint64_t i = 0;i < op_num;i++) {
+                    allocator->Enter(id);
+
+                    AllocatedBlock block = TimedAllocate(allocator,
+                                                         GetDeltaSize(i, id),
+                                                         id,
+                                                         i,
+                                                         recorder,
+                                                         histogram_p);
+
+                    AllocatedBlock *slot_p = &window[i % window_size];
+                    if(i % 16 == 0) {
+                      slot_p = &long_list[r(i, id + 1024) % long_num];
+                    }
+
+                    if(slot_p->p != nullptr) {
+                      allocator->Free(slot_p->p, slot_p->sz, id);
+                    }
+
+                    *slot_p = block;
+                  }
+
+                  for(const AllocatedBlock &block : window) {
+                    if(block.p != nullptr) {
+                      allocator->Free(block.p, block.sz, id);
+                    }
+                  }
+
+                  for(const AllocatedBlock &block : long_list) {
+                    if(block.p != nullptr) {
+                      allocator->Free(block.p, block.sz, id);
+                    }
+                  }
+                }
+
+                allocator->Exit(id);
+
+                return;
+              };
+
+  double duration = RunThreads(thread_num, func);
+
+  // Alloc-only blocks are freed by the same threads outside of the timer
+  if(pattern == AllocPattern::ALLOC_ONLY) {
+    Pool.Run(thread_num, [&](uint64_t id) {
+                           allocator->Enter(id);
+                           for(const AllocatedBlock &block : 
+                                 block_list_list[id]) {
+                             allocator->Free(block.p, block.sz, id);
+                           }
+
+                           allocator->Exit(id);
+
+                           return;
+                         });
+  }
+
+  uint64_t peak_rss = ReadProcStatus("VmHWM");
+
+  delete allocator;
+
+  // Only producers allocate
+  uint64_t alloc_num = op_num * thread_num;
+  if(pattern == AllocPattern::PRODUCER_CONSUMER) {
+    alloc_num /= 2;
+  }
+
+  dbg_printf("%s, %s, %lu threads: %f seconds; Throughput = %f M op/sec\n",
+             AllocatorType::GetName(),
+             pattern_name,
+             thread_num,
+             duration,
+             static_cast<double>(alloc_num) / duration / (1024.0 * 1024.0));
+
+  Harness.Record(BenchmarkHarness::Format("Allocator, %s, %s, %lu threads",
+                                          AllocatorType::GetName(),
+                                          pattern_name,
+                                          thread_num),
+                 static_cast<double>(alloc_num) / duration / (1024.0 * 1024.0),
+                 "M op/sec");
+
+  recorder.Print("Allocation");
+
+  dbg_printf("    Peak RSS growth = %f MB%s\n",
+             static_cast<double>(peak_rss - start_rss) / 1024.0,
+             (reset_flag == true) ? "" : " (peak not reset)");
+
+  return;
+}
+
+/*
+ * AllocatorBenchmark() - Compares VarLenPool with malloc() under patterns of
+ *                        RunAllocPattern()
+ *
+ * VarLenPool is run both on the shared path and with thread slots, which
+ * bump allocate from owned chunks and reuse freed blocks through size class
+ * free lists
+ *
+ * Throughput counts allocations, and in patterns that also free, the
+ * matching free is included in the time. One of every 64 allocations is
+ * timed
+ */
+void AllocatorBenchmark(uint64_t thread_num, uint64_t op_num) {
+  PrintTestName("AllocatorBenchmark");
+
+  static const std::pair<AllocPattern, const char *> pattern_list[] = {
+    {AllocPattern::ALLOC_ONLY, "Alloc only"},
+    {AllocPattern::PRODUCER_CONSUMER, "Producer consumer"},
+    {AllocPattern::MIXED_LIFETIME, "Mixed lifetime"},
+  };
+
+  for(const auto &pattern : pattern_list) {
+    RunAllocPattern<PoolAllocator>(pattern.first,
+                                   pattern.second,
+                                   thread_num,
+                                   op_num);
+    RunAllocPattern<SlotPoolAllocator>(pattern.first,
+                                       pattern.second,
+                                       thread_num,
+                                       op_num);
+    RunAllocPattern<MallocAllocator>(pattern.first,
+                                     pattern.second,
+                                     thread_num,
+                                     op_num);
+  }
+
+  return;
+}
+
+/*
+ * SkipListBenchmark() - Benchmarks AtomicSkipList with scanning threads and
+ *                       updating threads running together
+ *
+ * Even numbered threads scan scan_len keys from a random start key, and
+ * odd numbered threads insert and delete random keys. Each scan is a long
+ * read-side critical section which holds back the minimum epoch, so we
+ * also sample the number of garbage nodes the EM could not yet free
+ * using an extra monitoring thread
+ */
+void SkipListBenchmark(uint64_t thread_num,
+                       uint64_t op_num,
+                       uint64_t key_num,
+                       uint64_t scan_len) {
+  PrintTestName("SkipListBenchmark");
+
+  SkipListEM *em = new SkipListEM{thread_num};
+  SkipListType *sl = new SkipListType{em};
+
+  for(uint64_t i = 0;i < key_num;i += 2) {
+    sl->Insert(i, i);
+  }
+
+  // Number of worker threads that have not finished
+  std::atomic<uint64_t> running_count;
+  running_count.store(thread_num);
+
+  std::atomic<uint64_t> scan_count;
+  std::atomic<uint64_t> scan_key_count;
+  std::atomic<uint64_t> update_count;
+  scan_count.store(0);
+  scan_key_count.store(0);
+  update_count.store(0);
+
+  uint64_t max_pending = 0;
+  uint64_t total_pending = 0;
+  uint64_t sample_num = 0;
+
+  auto func = [em, sl, thread_num, op_num, key_num, scan_len,
+               &running_count, &scan_count, &scan_key_count, &update_count,
+               &max_pending, &total_pending, &sample_num](uint64_t id) {
+                // The last thread is the monitor which does not access
+                // the skiplist
+                if(id == thread_num) {
+                  while(running_count.load() != 0) {
+                    uint64_t pending = em->GetPendingNodeCount();
+                    if(pending > max_pending) {
+                      max_pending = pending;
+                    }
+
+                    total_pending += pending;
+                    sample_num++;
+
+                    SleepFor(10);
+                  }
+
+                  return;
+                }
+
+                SimpleInt64Random<> r{};
+                std::vector<SkipListType::KeyValuePair> result{};
+                uint64_t local_key_count = 0;
+
+                for(uint64_t i = 0;i < op_num;i++) {
+                  uint64_t key = r(i, id) % key_num;
+
+                  em->AnnounceEnter(id);
+
+                  if((id % 2) == 0) {
+                    result.clear();
+                    local_key_count += sl->Scan(key, key + scan_len, result);
+                  } else if((i % 2) == 0) {
+                    sl->Insert(key, key);
+                  } else {
+                    sl->Delete(key);
+                  }
+                }
+
+                if((id % 2) == 0) {
+                  scan_count.fetch_add(op_num);
+                  scan_key_count.fetch_add(local_key_count);
+                } else {
+                  update_count.fetch_add(op_num);
+                }
+
+                running_count.fetch_sub(1);
+
+                return;
+              };
+
+  em->StartGCThread();
+
+  double duration = RunThreads(thread_num + 1, func);
+
+  delete sl;
+  delete em;
+
+  dbg_printf("Tests of %lu threads, %lu operations each took %f seconds\n",
+             thread_num,
+             op_num,
+             duration);
+
+  dbg_printf("    Scan throughput = %f M scan/sec; %f M key/sec\n",
+             static_cast<double>(scan_count.load()) / duration / (1024.0 * 1024.0),
+             static_cast<double>(scan_key_count.load()) / duration / (1024.0 * 1024.0));
+
+  Harness.Record(BenchmarkHarness::Format("SkipList, scan, %lu threads",
+                                          thread_num),
+                 static_cast<double>(scan_count.load()) / duration / (1024.0 * 1024.0),
+                 "M scan/sec");
+
+  dbg_printf("    Update throughput = %f M op/sec\n",
+             static_cast<double>(update_count.load()) / duration / (1024.0 * 1024.0));
+
+  Harness.Record(BenchmarkHarness::Format("SkipList, update, %lu threads",
+                                          thread_num),
+                 static_cast<double>(update_count.load()) / duration / (1024.0 * 1024.0),
+                 "M op/sec");
+
+  dbg_printf("    Pending garbage nodes: max = %lu; avg = %f\n",
+             max_pending,
+             static_cast<double>(total_pending) /
+               static_cast<double>(sample_num == 0 ? 1 : sample_num));
+
+  return;
+}
+
+/*
+ * EnterEpoch() / ExitEpoch() - Protects an operation using either EM
+ *
+ * These are overloaded on the EM type such that benchmarks could be
+ * written once for both EMs
+ */
+template <typename GarbageType>
+inline void *EnterEpoch(LocalWriteEM<GarbageType> *em, uint64_t id) {
+  em->AnnounceEnter(id);
+
+  return nullptr;
+}
+
+template <typename GarbageType>
+inline void *EnterEpoch(GlobalWriteEM<GarbageType> *em, uint64_t) {
+  return em->JoinEpoch();
+}
+
+template <typename GarbageType>
+inline void ExitEpoch(LocalWriteEM<GarbageType> *, void *) {}
+
+template <typename GarbageType>
+inline void ExitEpoch(GlobalWriteEM<GarbageType> *em, void *epoch_node_p) {
+  em->LeaveEpoch(epoch_node_p);
+
+  return;
+}
+
+/*
+ * DeltaChainBenchmark() - Runs an end-to-end BwTree-like workload on
+ *                         DeltaChainIndex
+ *
+ * Half of the operations are lookups and the rest are evenly split between
+ * inserts and deletes on uniformly random keys. Every consolidation retires
+ * a whole delta chain of consolidate_threshold records at once, and the
+ * GC thread advances epoch every epoch_interval ms, which are the two knobs
+ * to tune. The EM is created by the caller and destroyed here
+ */
+template <typename IndexType>
+void DeltaChainBenchmark(const char *em_name,
+                         typename IndexType::EMType *em,
+                         uint64_t thread_num,
+                         uint64_t op_num,
+                         uint64_t key_num,
+                         uint64_t epoch_interval,
+                         uint64_t consolidate_threshold) {
+  PrintTestName("DeltaChainBenchmark");
+
+  // Each page has 64 keys on average after the index is populated
+  IndexType *idx = new IndexType{em,
+                                 key_num / 64 + 1,
+                                 static_cast<int>(consolidate_threshold)};
+
+  for(uint64_t i = 0;i < key_num;i += 2) {
+    idx->Insert(i, i);
+  }
+
+  uint64_t prev_consolidation_count = idx->GetConsolidationCount();
+
+  auto func = [em, idx, op_num, key_num](uint64_t id) {
+                SimpleInt64Random<> r{};
+
+                // Avoid the lookups being optimized out
+                std::vector<uint64_t> v(1);
+
+                for(uint64_t i = 0;i < op_num;i++) {
+                  uint64_t key = r(i, id) % key_num;
+                  uint64_t op = r(i, id + 1024) % 4;
+
+                  void *epoch_node_p = EnterEpoch(em, id);
+
+                  if(op < 2) {
+                    idx->GetValue(key, v[0]);
+                  } else if(op == 2) {
+                    idx->Insert(key, key);
+                  } else {
+                    idx->Delete(key);
+                  }
+
+                  ExitEpoch(em, epoch_node_p);
+                }
+
+                return;
+              };
+
+  em->SetGCInterval(epoch_interval);
+  em->StartGCThread();
+
+  double duration = RunThreads(thread_num, func);
+
+  uint64_t consolidation_count = \
+    idx->GetConsolidationCount() - prev_consolidation_count;
+
+  delete idx;
+  delete em;
+
+  dbg_printf("EM = %s, epoch interval = %lu ms, consolidate threshold = %lu\n",
+             em_name,
+             epoch_interval,
+             consolidate_threshold);
+
+  dbg_printf("Tests of %lu threads, %lu operations each took %f seconds\n",
+             thread_num,
+             op_num,
+             duration);
+
+  dbg_printf("    Throughput = %f M op/sec\n",
+             static_cast<double>(thread_num * op_num) / duration / (1024.0 * 1024.0));
+
+  Harness.Record(BenchmarkHarness::Format("DeltaChain, %s, %lu threads",
+                                          em_name,
+                                          thread_num),
+                 static_cast<double>(thread_num * op_num) / duration / (1024.0 * 1024.0),
+                 "M op/sec");
+
+  dbg_printf("    Chains retired = %f K chain/sec\n",
+             static_cast<double>(consolidation_count) / duration / 1024.0);
+
+  return;
+}
+
+/*
+ * ListSetBenchmark() - Benchmarks AtomicListSet with mostly lookups
+ *
+ * The list is pre-populated with half of the key range. 80% of operations
+ * are Contains() and the rest are evenly split between Insert() and
+ * Delete(). Every operation walks half of the list on average, so the
+ * cost of epoch protection is amortized over many node dereferences, while
+ * nodes being dereferenced are concurrently unlinked and retired. The EM
+ * is created by the caller and destroyed here
+ */
+template <typename ListSetType>
+void ListSetBenchmark(const char *em_name,
+                      typename ListSetType::EMType *em,
+                      uint64_t thread_num,
+                      uint64_t op_num,
+                      uint64_t key_num) {
+  PrintTestName("ListSetBenchmark");
+
+  ListSetType *ls = new ListSetType{em};
+
+  for(uint64_t i = 0;i < key_num;i += 2) {
+    ls->Insert(i);
+  }
+
+  auto func = [em, ls, op_num, key_num](uint64_t id) {
+                SimpleInt64Random<> r{};
+
+                // Avoid the lookups being optimized out
+                std::vector<uint64_t> v(1);
+
+                for(uint64_t i = 0;i < op_num;i++) {
+                  uint64_t key = r(i, id) % key_num;
+                  uint64_t op = r(i, id + 1024) % 10;
+
+                  void *epoch_node_p = EnterEpoch(em, id);
+
+                  if(op < 8) {
+                    v[0] = ls->Contains(key);
+                  } else if(op == 8) {
+                    ls->Insert(key);
+                  } else {
+                    ls->Delete(key);
+                  }
+
+                  ExitEpoch(em, epoch_node_p);
+                }
+
+                return;
+              };
+
+  em->StartGCThread();
+
+  double duration = RunThreads(thread_num, func);
+
+  delete ls;
+  delete em;
+
+  // Half of the keys are in the list, and each operation walks through
+  // half of them on average
+  double node_per_op = static_cast<double>(key_num) / 4.0;
+
+  dbg_printf("EM = %s, key num = %lu\n", em_name, key_num);
+
+  dbg_printf("Tests of %lu threads, %lu operations each took %f seconds\n",
+             thread_num,
+             op_num,
+             duration);
+
+  dbg_printf("    Throughput = %f M op/sec\n",
+             static_cast<double>(thread_num * op_num) / duration / (1024.0 * 1024.0));
+
+  Harness.Record(BenchmarkHarness::Format("ListSet, %s, %lu threads",
+                                          em_name,
+                                          thread_num),
+                 static_cast<double>(thread_num * op_num) / duration / (1024.0 * 1024.0),
+                 "M op/sec");
+
+  dbg_printf("    Approx. node visited = %f M node/sec\n",
+             static_cast<double>(thread_num * op_num) * node_per_op /
+               duration / (1024.0 * 1024.0));
+
+  return;
+}
+
+/*
+ * WorkStealingBenchmark() - Runs a binary tree of tasks on per-thread
+ *                           work-stealing deques
+ *
+ * Thread 0 pushes the root task of depth tree_depth, and every task of
+ * depth d > 0 pushes two tasks of depth d - 1 into the deque of the thread
+ * running it, so all other threads start with nothing and must steal.
+ * Each task also runs a loop of workload iterations. Deques start small
+ * such that buffers grow and are retired while thieves read them
+ */
+void WorkStealingBenchmark(uint64_t thread_num,
+                           uint64_t tree_depth,
+                           uint64_t workload) {
+  PrintTestName("WorkStealingBenchmark");
+
+  DequeEM *em = new DequeEM{thread_num};
+
+  std::vector<DequeType *> deque_list{};
+  for(uint64_t i = 0;i < thread_num;i++) {
+    deque_list.push_back(new DequeType{em, 16});
+  }
+
+  const uint64_t task_num = (0x1UL << (tree_depth + 1)) - 1;
+
+  // Per-thread counters on separate cache lines, such that counting
+  // finished tasks does not become a contended RMW
+  using CounterType = PaddedData<std::atomic<uint64_t>, CACHE_LINE_SIZE>;
+  std::vector<CounterType> finished_list(thread_num);
+  for(uint64_t i = 0;i < thread_num;i++) {
+    finished_list[i]->store(0);
+  }
+
+  std::atomic<uint64_t> steal_count;
+  std::atomic<uint64_t> steal_attempt_count;
+  steal_count.store(0);
+  steal_attempt_count.store(0);
+
+  deque_list[0]->Push(tree_depth);
+
+  auto func = [em, thread_num, task_num, workload,
+               &deque_list, &finished_list,
+               &steal_count, &steal_attempt_count](uint64_t id) {
+                DequeType *dq = deque_list[id];
+                SimpleInt64Random<> r{};
+                uint64_t local_steal = 0;
+                uint64_t local_attempt = 0;
+
+                std::vector<uint64_t> v(workload + 1);
+
+                while(1) {
+                  uint64_t depth;
+
+                  if(dq->Pop(depth) == false) {
+                    uint64_t victim = r(local_attempt, id) % thread_num;
+                    local_attempt++;
+
+                    em->AnnounceEnter(id);
+                    if((victim == id) ||
+                       (deque_list[victim]->Steal(depth) == false)) {
+                      // Check for termination only when idle
+                      uint64_t finished = 0;
+                      for(uint64_t i = 0;i < thread_num;i++) {
+                        finished += finished_list[i]->load();
+                      }
+
+                      if(finished == task_num) {
+                        break;
+                      }
+
+                      continue;
+                    }
+
+                    local_steal++;
+                  }
+
+                  for(uint64_t j = 0;j < workload;j++) {
+                    v[j] = j;
+                  }
+
+                  if(depth > 0) {
+                    dq->Push(depth - 1);
+                    dq->Push(depth - 1);
+                  }
+
+                  finished_list[id]->fetch_add(1);
+                }
+
+                steal_count.fetch_add(local_steal);
+                steal_attempt_count.fetch_add(local_attempt);
+
+                return;
+              };
+
+  em->StartGCThread();
+
+  double duration = RunThreads(thread_num, func);
+
+  uint64_t max_capacity = 0;
+  for(uint64_t i = 0;i < thread_num;i++) {
+    max_capacity = std::max(max_capacity,
+                            static_cast<uint64_t>(deque_list[i]->GetCapacity()));
+    delete deque_list[i];
+  }
+
+  delete em;
+
+  dbg_printf("Tests of %lu threads, %lu tasks (workload %lu) took %f seconds\n",
+             thread_num,
+             task_num,
+             workload,
+             duration);
+
+  dbg_printf("    Throughput = %f M task/sec\n",
+             static_cast<double>(task_num) / duration / (1024.0 * 1024.0));
+
+  Harness.Record(BenchmarkHarness::Format("WorkStealing, %lu threads",
+                                          thread_num),
+                 static_cast<double>(task_num) / duration / (1024.0 * 1024.0),
+                 "M task/sec");
+
+  dbg_printf("    Steal = %lu; Steal attempt = %lu; Max capacity = %lu\n",
+             steal_count.load(),
+             steal_attempt_count.load(),
+             max_capacity);
+
+  return;
+}
+
+// Names of all benchmarks, which are selected with --name
+static const char *BenchmarkNameList[] = {
+  "thread_affinity", "int_hash", "random_number", "lem_simple", "gem_simple",
+  "hash_map_read", "hash_map_write", "clock_cache", "clock_cache_bytes",
+  "rcu_pointer", "concurrent_vector", "deferred_free", "var_len_pool_scale",
+  "var_len_pool_fragmentation", "var_len_pool_tlb", "var_len_pool_churn",
+  "var_len_pool_region", "var_len_pool_reallocate", "allocator", "skip_list",
+  "list_set_lem", "list_set_gem", "work_stealing", "delta_chain_lem",
+  "delta_chain_gem",
+};
+
+/*
+ * IsAnyBenchmarkNamed() - Whether any benchmark is selected on the command
+ *                         line
+ *
+ * Options such as --trial_num are not benchmark names, so they alone still
+ * run all benchmarks
+ */
+bool IsAnyBenchmarkNamed(Argv &args) {
+  for(const char *name : BenchmarkNameList) {
+    if(args.Exists(name) == true) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/*
+ * RunBenchmarks() - Runs benchmarks selected on the command line, or all of
+ *                   them if all_flag is set
+ */
+void RunBenchmarks(bool all_flag,
+                   Argv &args,
+                   uint64_t thread_num,
+                   uint64_t workload,
+                   uint64_t epoch_interval,
+                   uint64_t consolidate_threshold) {
+  if(all_flag == true || args.Exists("thread_affinity")) {
+    GetThreadAffinityBenchmark(thread_num);
+  }
+  
+  if(all_flag == true || args.Exists("int_hash")) {
+    IntHasherRandBenchmark(100000000, 10);
+  }
+  
+  if(all_flag == true || args.Exists("random_number")) {
+    RandomNumberBenchmark(thread_num, 100000000);
+  }
+  
+  if(all_flag == true || args.Exists("lem_simple")) {
+    LEMSimpleBenchmark(thread_num, 1024 * 1024 * 30, workload);
+  }
+  
+  if(all_flag == true || args.Exists("gem_simple")) {
+    GEMSimpleBenchmark(thread_num, 1024 * 1024 * 10, workload);
+  }
+
+  if(all_flag == true || args.Exists("hash_map_read")) {
+    HashMapBenchmark(thread_num, 1024 * 1024 * 4, 1024 * 1024, 90);
+  }
+
+  if(all_flag == true || args.Exists("hash_map_write")) {
+    HashMapBenchmark(thread_num, 1024 * 1024 * 4, 1024 * 1024, 10);
+  }
+
+  if(all_flag == true || args.Exists("clock_cache")) {
+    ClockCacheBenchmark(thread_num, 1024 * 1024 * 4, 1024 * 1024, 1024 * 64, 0.99, false);
+    ClockCacheBenchmark(thread_num, 1024 * 1024 * 4, 1024 * 1024, 1024 * 64, 0.8, false);
+  }
+
+  if(all_flag == true || args.Exists("clock_cache_bytes")) {
+    ClockCacheBenchmark(thread_num, 1024 * 1024 * 4, 1024 * 1024, 1024 * 1024 * 128, 0.99, true);
+  }
+
+  if(all_flag == true || args.Exists("rcu_pointer")) {
+    RCUPointerBenchmark(thread_num, 1024 * 1024 * 16, 1000);
+  }
+
+  if(all_flag == true || args.Exists("concurrent_vector")) {
+    ConcurrentVectorBenchmark(thread_num, 1024 * 1024 * 8, 90);
+    ConcurrentVectorBenchmark(thread_num, 1024 * 1024 * 8, 10);
+  }
+
+  if(all_flag == true || args.Exists("deferred_free")) {
+    DeferredFreeBenchmark(thread_num, 1024 * 1024 * 4);
+  }
+
+  if(all_flag == true || args.Exists("var_len_pool_scale")) {
+    VarLenPoolScaleBenchmark(thread_num, 1024 * 1024 * 8);
+  }
+
+  if(all_flag == true || args.Exists("var_len_pool_fragmentation")) {
+    VarLenPoolFragmentationBenchmark(thread_num, 1024 * 1024 * 8, 1024 * 16);
+  }
+
+  if(all_flag == true || args.Exists("var_len_pool_tlb")) {
+    VarLenPoolTLBBenchmark(thread_num, 1024 * 1024 * 8, 1024 * 1024 * 16);
+  }
+
+  if(all_flag == true || args.Exists("var_len_pool_churn")) {
+    VarLenPoolChurnBenchmark(thread_num, 1024 * 1024 * 8);
+  }
+
+  if(all_flag == true || args.Exists("var_len_pool_region")) {
+    VarLenPoolRegionBenchmark(thread_num, 1024 * 1024 * 16);
+  }
+
+  if(all_flag == true || args.Exists("var_len_pool_reallocate")) {
+    VarLenPoolReallocateBenchmark(thread_num, 1024 * 1024 * 8);
+  }
+
+  if(all_flag == true || args.Exists("allocator")) {
+    AllocatorBenchmark(thread_num, 1024 * 1024 * 4);
+  }
+
+  if(all_flag == true || args.Exists("skip_list")) {
+    SkipListBenchmark(thread_num, 1024 * 256, 1024 * 1024, 1000);
+  }
+
+  if(all_flag == true || args.Exists("list_set_lem")) {
+    ListSetBenchmark<LEMListSetType>(
+      "LocalWriteEM",
+      new typename LEMListSetType::EMType{thread_num},
+      thread_num,
+      1024 * 256,
+      1024);
+  }
+
+  if(all_flag == true || args.Exists("list_set_gem")) {
+    ListSetBenchmark<GEMListSetType>(
+      "GlobalWriteEM",
+      new typename GEMListSetType::EMType{},
+      thread_num,
+      1024 * 256,
+      1024);
+  }
+
+  if(all_flag == true || args.Exists("work_stealing")) {
+    WorkStealingBenchmark(thread_num, 22, workload);
+  }
+
+  if(all_flag == true || args.Exists("delta_chain_lem")) {
+    DeltaChainBenchmark<LEMDeltaChainType>(
+      "LocalWriteEM",
+      new typename LEMDeltaChainType::EMType{thread_num},
+      thread_num,
+      1024 * 1024 * 4,
+      1024 * 1024,
+      epoch_interval,
+      consolidate_threshold);
+  }
+
+  if(all_flag == true || args.Exists("delta_chain_gem")) {
+    DeltaChainBenchmark<GEMDeltaChainType>(
+      "GlobalWriteEM",
+      new typename GEMDeltaChainType::EMType{},
+      thread_num,
+      1024 * 1024 * 4,
+      1024 * 1024,
+      epoch_interval,
+      consolidate_threshold);
+  }
+
+  return;
+}
+
+/*
+ * GetValueOrThrow() - Get an unsigned long typed value from args, or throw 
+ *                     exception if the format for key-value is not correct
+ *
+ * This function throws integer constant 0 on error 
+ */
+void GetValueAsULOrThrow(Argv &args, 
+                         const std::string &key,
+                         unsigned long *value_p) {
+  bool ret = args.GetValueAsUL(key, value_p);
+  
+  if(ret == false) {
+    dbg_printf("ERROR: Unrecognized value for key %s: \"%s\"\n",
+               key.c_str(), 
+               args.GetValue("thread_num")->c_str());
+               
+    throw 0;
+  }
+  
+  return;
+}
+
+int main(int argc, char **argv) {
+  // This returns the number of logical CPUs
+  CoreNum = GetCoreNum();
+  dbg_printf("* # of cores (default thread_num) on the platform = %lu\n", 
+             CoreNum);
+  if(CoreNum == 0) {
+    dbg_printf("    ...which is not supported\n");
+    
+    exit(1);
+  }
+  
+  // This will be overloaded if a thread_num is provided as argument
+  uint64_t thread_num = CoreNum;
+  // By default no workload is done
+  uint64_t workload = 0;
+  // Epoch length and delta chain length for delta chain benchmarks
+  uint64_t epoch_interval = 50;
+  uint64_t consolidate_threshold = 8;
+  // Trials are repeated runs of all selected benchmarks, and a benchmark
+  // regresses if its median drops by more than threshold percent
+  uint64_t warmup_num = 0;
+  uint64_t trial_num = 1;
+  uint64_t threshold = 5;
+  
+  Argv args{argc, argv};
+  
+  GetValueAsULOrThrow(args, "thread_num", &thread_num);
+  GetValueAsULOrThrow(args, "workload", &workload);
+  GetValueAsULOrThrow(args, "epoch_interval", &epoch_interval);
+  GetValueAsULOrThrow(args, "consolidate_threshold", &consolidate_threshold);
+  GetValueAsULOrThrow(args, "warmup_num", &warmup_num);
+  GetValueAsULOrThrow(args, "trial_num", &trial_num);
+  GetValueAsULOrThrow(args, "threshold", &threshold);
+
+  if(trial_num == 0) {
+    dbg_printf("ERROR: trial_num must be positive\n");
+
+    return 1;
+  }
+
+  Harness = BenchmarkHarness{warmup_num, trial_num};
+  
+  dbg_printf("* thread_num = %lu\n", thread_num);
+  dbg_printf("* workload = %lu\n", workload);
+  dbg_printf("* epoch_interval = %lu\n", epoch_interval);
+  dbg_printf("* consolidate_threshold = %lu\n", consolidate_threshold);
+  dbg_printf("* CoreNum = %lu\n", CoreNum);
+  dbg_printf("* warmup_num = %lu\n", warmup_num);
+  dbg_printf("* trial_num = %lu\n", trial_num);
+  
+  bool all_flag = (IsAnyBenchmarkNamed(args) == false);
+
+  for(uint64_t i = 0;i < Harness.GetTotalTrialNum();i++) {
+    if(Harness.GetTotalTrialNum() > 1) {
+      Harness.BeginTrial(i);
+    }
+
+    RunBenchmarks(all_flag,
+                  args,
+                  thread_num,
+                  workload,
+                  epoch_interval,
+                  consolidate_threshold);
+  }
+
+  if(Harness.GetTotalTrialNum() > 1) {
+    PrintTestName("Summary");
+    Harness.PrintSummary();
+  }
+
+  // An empty result file or comparison would look like a clean run
+  uint64_t result_num = Harness.Summarize().size();
+  if((result_num == 0) &&
+     ((args.Exists("output") == true) || (args.Exists("baseline") == true))) {
+    dbg_printf("ERROR: No benchmark recorded a result\n");
+
+    return 1;
+  }
+
+  std::string *output_p = args.GetValue("output");
+  if(output_p != nullptr) {
+    if(Harness.WriteFile(*output_p) == false) {
+      dbg_printf("ERROR: Could not write \"%s\"\n", output_p->c_str());
+
+      return 1;
+    }
+
+    dbg_printf("Results are written to \"%s\"\n", output_p->c_str());
+  }
+
+  std::string *baseline_p = args.GetValue("baseline");
+  if(baseline_p != nullptr) {
+    std::vector<BenchmarkHarness::Comparison> comparison_list{};
+    if(Harness.CompareBaseline(*baseline_p,
+                               threshold / 100.0,
+                               &comparison_list) == false) {
+      dbg_printf("ERROR: Could not read \"%s\"\n", baseline_p->c_str());
+
+      return 1;
+    }
+
+    PrintTestName("Baseline");
+
+    uint64_t regression_count = 0;
+    for(const auto &comparison : comparison_list) {
+      dbg_printf("%s: %f -> %f (%+.2f%%)%s\n",
+                 comparison.name.c_str(),
+                 comparison.baseline_median,
+                 comparison.median,
+                 comparison.change * 100.0,
+                 (comparison.regression_flag == true) ? " REGRESSION" : "");
+
+      if(comparison.regression_flag == true) {
+        regression_count++;
+      }
+    }
+
+    dbg_printf("%lu of %lu benchmarks regressed by more than %lu%%\n",
+               regression_count,
+               comparison_list.size(),
+               threshold);
+
+    if(comparison_list.size() < result_num) {
+      dbg_printf("WARNING: %lu of %lu benchmarks are not in the baseline\n",
+                 result_num - comparison_list.size(),
+                 result_num);
+    }
+
+    if(comparison_list.size() == 0) {
+      dbg_printf("ERROR: No benchmark matches the baseline\n");
+
+      return 1;
+    }
+
+    if(regression_count > 0) {
+      return 1;
+    }
+  }
+
   return 0;
 }
 
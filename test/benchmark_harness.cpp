@@ -0,0 +1,355 @@
+
+/*
+ * benchmark_harness.cpp - Repeated trials and statistics of benchmarks
+ *
+ * Like test_suite.cpp this is only called outside of measured regions, so
+ * nothing here is performance critical
+ */
+
+#include "benchmark_harness.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <fstream>
+
+/*
+ * QuoteCSV() - Quotes a CSV field, doubling quotes inside it
+ */
+static std::string QuoteCSV(const std::string &s) {
+  std::string ret{"\""};
+  for(char c : s) {
+    if(c == '"') {
+      ret.push_back('"');
+    }
+
+    ret.push_back(c);
+  }
+
+  ret.push_back('"');
+
+  return ret;
+}
+
+/*
+ * SplitCSV() - Splits a CSV line into fields, and removes quotes
+ */
+static std::vector<std::string> SplitCSV(const std::string &line) {
+  std::vector<std::string> field_list{};
+  std::string field{};
+  bool quoted_flag = false;
+
+  for(size_t i = 0;i < line.size();i++) {
+    char c = line[i];
+
+    if(quoted_flag == true) {
+      if(c != '"') {
+        field.push_back(c);
+      } else if((i + 1 < line.size()) && (line[i + 1] == '"')) {
+        field.push_back('"');
+        i++;
+      } else {
+        quoted_flag = false;
+      }
+    } else if(c == '"') {
+      quoted_flag = true;
+    } else if(c == ',') {
+      field_list.push_back(field);
+      field.clear();
+    } else if(c != '\r') {
+      field.push_back(c);
+    }
+  }
+
+  field_list.push_back(field);
+
+  return field_list;
+}
+
+/*
+ * QuoteJSON() - Quotes a JSON string
+ */
+static std::string QuoteJSON(const std::string &s) {
+  std::string ret{"\""};
+  for(char c : s) {
+    if((c == '"') || (c == '\\')) {
+      ret.push_back('\\');
+    }
+
+    ret.push_back(c);
+  }
+
+  ret.push_back('"');
+
+  return ret;
+}
+
+/*
+ * GetPercentile() - Returns a percentile of a sorted non-empty list by
+ *                   interpolating between the two closest values
+ */
+static double GetPercentile(const std::vector<double> &value_list,
+                            double percentile) {
+  double rank = percentile * (value_list.size() - 1);
+  size_t lower = static_cast<size_t>(rank);
+  if(lower + 1 >= value_list.size()) {
+    return value_list.back();
+  }
+
+  double fraction = rank - lower;
+
+  return value_list[lower] * (1.0 - fraction) + value_list[lower + 1] * fraction;
+}
+
+/*
+ * Constructor
+ */
+BenchmarkHarness::BenchmarkHarness(uint64_t p_warmup_num,
+                                   uint64_t p_trial_num) :
+  warmup_num{p_warmup_num},
+  trial_num{p_trial_num},
+  trial_index{p_warmup_num},
+  name_list{},
+  value_map{} {
+  assert(trial_num > 0);
+
+  return;
+}
+
+/*
+ * BeginTrial() - Starts a trial, and returns whether it is a warmup
+ */
+bool BenchmarkHarness::BeginTrial(uint64_t index) {
+  assert(index < GetTotalTrialNum());
+  trial_index = index;
+
+  bool warmup_flag = (trial_index < warmup_num);
+
+  dbg_printf("*** Trial %lu of %lu%s\n",
+             trial_index + 1,
+             GetTotalTrialNum(),
+             (warmup_flag == true) ? " (warmup)" : "");
+
+  return warmup_flag;
+}
+
+/*
+ * Record() - Records a value of a benchmark in the current trial
+ */
+void BenchmarkHarness::Record(const std::string &name,
+                              double value,
+                              const char *unit) {
+  if(trial_index < warmup_num) {
+    return;
+  }
+
+  auto it = value_map.find(name);
+  if(it == value_map.end()) {
+    name_list.push_back(name);
+    it = value_map.emplace(name,
+                           std::make_pair(std::string{unit},
+                                          std::vector<double>{})).first;
+  }
+
+  it->second.second.push_back(value);
+
+  return;
+}
+
+/*
+ * Summarize() - Computes statistics of a list of values
+ */
+BenchmarkHarness::Summary
+BenchmarkHarness::Summarize(const std::string &name,
+                            const std::string &unit,
+                            std::vector<double> value_list) {
+  assert(value_list.size() > 0);
+
+  Summary summary{};
+  summary.name = name;
+  summary.unit = unit;
+  summary.trial_num = value_list.size();
+
+  std::sort(value_list.begin(), value_list.end());
+  summary.median = GetPercentile(value_list, 0.5);
+  summary.p5 = GetPercentile(value_list, 0.05);
+  summary.p95 = GetPercentile(value_list, 0.95);
+
+  double sum = 0.0;
+  for(double value : value_list) {
+    sum += value;
+  }
+
+  summary.mean = sum / value_list.size();
+
+  double square_sum = 0.0;
+  for(double value : value_list) {
+    square_sum += (value - summary.mean) * (value - summary.mean);
+  }
+
+  summary.stddev = 0.0;
+  if(value_list.size() > 1) {
+    summary.stddev = std::sqrt(square_sum / (value_list.size() - 1));
+  }
+
+  summary.cv = 0.0;
+  if(summary.mean != 0.0) {
+    summary.cv = summary.stddev / summary.mean;
+  }
+
+  return summary;
+}
+
+/*
+ * Summarize() - Returns statistics of all benchmarks in recording order
+ */
+std::vector<BenchmarkHarness::Summary> BenchmarkHarness::Summarize() const {
+  std::vector<Summary> summary_list{};
+
+  for(const std::string &name : name_list) {
+    const auto &entry = value_map.at(name);
+    summary_list.push_back(Summarize(name, entry.first, entry.second));
+  }
+
+  return summary_list;
+}
+
+/*
+ * PrintSummary() - Prints a line of statistics per benchmark
+ */
+void BenchmarkHarness::PrintSummary() const {
+  for(const Summary &summary : Summarize()) {
+    dbg_printf("%s: median = %f %s; p5 = %f; p95 = %f; CV = %.2f%% "
+               "(%lu trials)\n",
+               summary.name.c_str(),
+               summary.median,
+               summary.unit.c_str(),
+               summary.p5,
+               summary.p95,
+               summary.cv * 100.0,
+               summary.trial_num);
+  }
+
+  return;
+}
+
+/*
+ * WriteFile() - Writes summaries as JSON if the path ends with ".json",
+ *               or otherwise as CSV
+ */
+bool BenchmarkHarness::WriteFile(const std::string &path) const {
+  std::ofstream file{path};
+  if(file.good() == false) {
+    return false;
+  }
+
+  std::vector<Summary> summary_list = Summarize();
+
+  // Enough digits to read the same double back
+  file.precision(17);
+
+  bool json_flag = (path.size() >= 5) &&
+                   (path.compare(path.size() - 5, 5, ".json") == 0);
+
+  if(json_flag == true) {
+    file << "{\n  \"warmup_num\": " << warmup_num
+         << ",\n  \"trial_num\": " << trial_num
+         << ",\n  \"results\": [";
+
+    for(size_t i = 0;i < summary_list.size();i++) {
+      const Summary &summary = summary_list[i];
+
+      file << ((i == 0) ? "\n" : ",\n")
+           << "    {\"name\": " << QuoteJSON(summary.name)
+           << ", \"unit\": " << QuoteJSON(summary.unit)
+           << ", \"trial_num\": " << summary.trial_num
+           << ", \"median\": " << summary.median
+           << ", \"p5\": " << summary.p5
+           << ", \"p95\": " << summary.p95
+           << ", \"mean\": " << summary.mean
+           << ", \"stddev\": " << summary.stddev
+           << ", \"cv\": " << summary.cv << "}";
+    }
+
+    file << "\n  ]\n}\n";
+  } else {
+    file << "name,unit,trial_num,median,p5,p95,mean,stddev,cv\n";
+
+    for(const Summary &summary : summary_list) {
+      file << QuoteCSV(summary.name) << ","
+           << QuoteCSV(summary.unit) << ","
+           << summary.trial_num << ","
+           << summary.median << ","
+           << summary.p5 << ","
+           << summary.p95 << ","
+           << summary.mean << ","
+           << summary.stddev << ","
+           << summary.cv << "\n";
+    }
+  }
+
+  file.close();
+
+  return file.good();
+}
+
+/*
+ * CompareBaseline() - Compares medians against a CSV file written by
+ *                     WriteFile()
+ */
+bool BenchmarkHarness::CompareBaseline(
+  const std::string &path,
+  double threshold,
+  std::vector<Comparison> *comparison_list_p) const {
+  std::ifstream file{path};
+  if(file.good() == false) {
+    return false;
+  }
+
+  // The first line is the header
+  std::string line;
+  std::getline(file, line);
+
+  std::map<std::string, double> baseline_map{};
+  while(std::getline(file, line)) {
+    std::vector<std::string> field_list = SplitCSV(line);
+    if(field_list.size() < 4) {
+      continue;
+    }
+
+    baseline_map[field_list[0]] = std::strtod(field_list[3].c_str(), nullptr);
+  }
+
+  comparison_list_p->clear();
+  for(const Summary &summary : Summarize()) {
+    auto it = baseline_map.find(summary.name);
+    if((it == baseline_map.end()) || (it->second == 0.0)) {
+      continue;
+    }
+
+    Comparison comparison{};
+    comparison.name = summary.name;
+    comparison.baseline_median = it->second;
+    comparison.median = summary.median;
+    comparison.change = (summary.median - it->second) / it->second;
+    comparison.regression_flag = (comparison.change < -threshold);
+
+    comparison_list_p->push_back(comparison);
+  }
+
+  return true;
+}
+
+/*
+ * Format() - Formats a benchmark name with printf() syntax
+ */
+std::string BenchmarkHarness::Format(const char *fmt, ...) {
+  char buffer[256];
+
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(buffer, sizeof(buffer), fmt, args);
+  va_end(args);
+
+  return std::string{buffer};
+}
@@ -0,0 +1,141 @@
+
+#pragma once
+
+#ifndef _BENCHMARK_HARNESS_H
+#define _BENCHMARK_HARNESS_H
+
+#include "../src/common.h"
+
+#include <map>
+#include <string>
+
+/*
+ * class BenchmarkHarness - Repeats benchmarks and summarizes their results
+ *
+ * Benchmarks call Record() with a name and a metric such as throughput for
+ * every configuration they run. The caller runs all benchmarks once per
+ * trial, between BeginTrial() calls, and results recorded in warmup trials
+ * are dropped. Names must be the same in all trials, and a higher value
+ * is always better
+ *
+ * Summaries could be written as JSON or CSV, and the CSV file could be
+ * read back as the baseline of a later run
+ */
+class BenchmarkHarness {
+ public:
+
+  /*
+   * class Summary - Statistics of all trials of a benchmark
+   *
+   * Percentiles interpolate between the two closest trials. cv is the
+   * coefficient of variation, i.e. the sample standard deviation divided
+   * by the mean
+   */
+  class Summary {
+   public:
+    std::string name;
+    std::string unit;
+    uint64_t trial_num;
+    double median;
+    double p5;
+    double p95;
+    double mean;
+    double stddev;
+    double cv;
+  };
+
+  /*
+   * class Comparison - Median of a benchmark against its baseline
+   *
+   * change is relative to the baseline, e.g. -0.1 is 10% slower
+   */
+  class Comparison {
+   public:
+    std::string name;
+    double baseline_median;
+    double median;
+    double change;
+    bool regression_flag;
+  };
+
+ private:
+  uint64_t warmup_num;
+  uint64_t trial_num;
+
+  // Index of the current trial, starting from warmup trials
+  uint64_t trial_index;
+
+  // Names in the order they are first recorded, and values of all
+  // measured trials
+  std::vector<std::string> name_list;
+  std::map<std::string, std::pair<std::string, std::vector<double>>> value_map;
+
+ public:
+
+  /*
+   * Constructor
+   */
+  BenchmarkHarness(uint64_t p_warmup_num = 0, uint64_t p_trial_num = 1);
+
+  /*
+   * GetTotalTrialNum() - Returns the number of trials including warmup
+   */
+  inline uint64_t GetTotalTrialNum() const {
+    return warmup_num + trial_num;
+  }
+
+  /*
+   * BeginTrial() - Starts a trial, and returns whether it is a warmup
+   */
+  bool BeginTrial(uint64_t index);
+
+  /*
+   * Record() - Records a value of a benchmark in the current trial
+   */
+  void Record(const std::string &name, double value, const char *unit);
+
+  /*
+   * Summarize() - Returns statistics of all benchmarks in recording order
+   */
+  std::vector<Summary> Summarize() const;
+
+  /*
+   * PrintSummary() - Prints a line of statistics per benchmark
+   */
+  void PrintSummary() const;
+
+  /*
+   * WriteFile() - Writes summaries as JSON if the path ends with ".json",
+   *               or otherwise as CSV
+   *
+   * Returns false if the file could not be written
+   */
+  bool WriteFile(const std::string &path) const;
+
+  /*
+   * CompareBaseline() - Compares medians against a CSV file written by
+   *                     WriteFile()
+   *
+   * A benchmark regresses if its median is lower than the baseline by more
+   * than threshold, e.g. 0.05 for 5%. Benchmarks not in the baseline are
+   * skipped. Returns false if the file could not be read
+   */
+  bool CompareBaseline(const std::string &path,
+                       double threshold,
+                       std::vector<Comparison> *comparison_list_p) const;
+
+  /*
+   * Format() - Formats a benchmark name with printf() syntax
+   */
+  static std::string Format(const char *fmt, ...)
+    __attribute__((format(printf, 1, 2)));
+
+  /*
+   * Summarize() - Computes statistics of a list of values
+   */
+  static Summary Summarize(const std::string &name,
+                           const std::string &unit,
+                           std::vector<double> value_list);
+};
+
+#endif
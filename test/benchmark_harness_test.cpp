@@ -0,0 +1,291 @@
+
+/*
+ * benchmark_harness_test.cpp - Tests statistics, output files and baseline
+ *                              comparison of the benchmark harness, the
+ *                              worker pool benchmarks run on, and latency
+ *                              histograms
+ */
+
+#include "test_suite.h"
+#include "benchmark_harness.h"
+#include "latency_recorder.h"
+
+#include <fstream>
+
+/*
+ * IsClose() - Whether two doubles are equal within a small error
+ */
+static bool IsClose(double a, double b) {
+  return std::fabs(a - b) < 1e-9;
+}
+
+/*
+ * TestSummarize() - Tests percentiles, mean and CV of a list of values
+ */
+void TestSummarize() {
+  PrintTestName("TestSummarize");
+
+  // Given out of order
+  BenchmarkHarness::Summary summary = \
+    BenchmarkHarness::Summarize("a", "M op/sec", {5.0, 1.0, 3.0, 2.0, 4.0});
+
+  assert(summary.trial_num == 5);
+  assert(IsClose(summary.median, 3.0) == true);
+  assert(IsClose(summary.mean, 3.0) == true);
+  // Interpolated between the two smallest and the two largest values
+  assert(IsClose(summary.p5, 1.2) == true);
+  assert(IsClose(summary.p95, 4.8) == true);
+  assert(IsClose(summary.stddev, std::sqrt(2.5)) == true);
+  assert(IsClose(summary.cv, std::sqrt(2.5) / 3.0) == true);
+
+  dbg_printf("Median = %f; p5 = %f; p95 = %f; CV = %f\n",
+             summary.median,
+             summary.p5,
+             summary.p95,
+             summary.cv);
+
+  // A single trial has no variation
+  summary = BenchmarkHarness::Summarize("b", "M op/sec", {7.0});
+  assert(IsClose(summary.median, 7.0) == true);
+  assert(IsClose(summary.p5, 7.0) == true);
+  assert(IsClose(summary.p95, 7.0) == true);
+  assert(IsClose(summary.cv, 0.0) == true);
+
+  return;
+}
+
+/*
+ * TestWarmup() - Tests that warmup trials are not recorded and names keep
+ *                the order they are first recorded in
+ */
+void TestWarmup() {
+  PrintTestName("TestWarmup");
+
+  BenchmarkHarness harness{2, 3};
+  assert(harness.GetTotalTrialNum() == 5);
+
+  for(uint64_t i = 0;i < harness.GetTotalTrialNum();i++) {
+    bool warmup_flag = harness.BeginTrial(i);
+    assert(warmup_flag == (i < 2));
+
+    harness.Record(BenchmarkHarness::Format("second, %d threads", 4),
+                   (warmup_flag == true) ? 1000.0 : 10.0 + i,
+                   "M op/sec");
+    harness.Record("first", 1.0, "op/sec");
+  }
+
+  std::vector<BenchmarkHarness::Summary> summary_list = harness.Summarize();
+  assert(summary_list.size() == 2);
+  assert(summary_list[0].name == "second, 4 threads");
+  assert(summary_list[0].trial_num == 3);
+  assert(IsClose(summary_list[0].median, 13.0) == true);
+  assert(summary_list[1].name == "first");
+  assert(summary_list[1].unit == "op/sec");
+
+  harness.PrintSummary();
+
+  return;
+}
+
+/*
+ * TestBaseline() - Tests writing files and comparing against a CSV file as
+ *                  the baseline
+ */
+void TestBaseline() {
+  PrintTestName("TestBaseline");
+
+  static const char *csv_path = "/tmp/benchmark_harness_test.csv";
+  static const char *json_path = "/tmp/benchmark_harness_test.json";
+
+  BenchmarkHarness baseline{0, 1};
+  baseline.Record("steady", 100.0, "M op/sec");
+  // Quotes and commas in names survive the CSV round trip
+  baseline.Record("slower, \"quoted\"", 100.0, "M op/sec");
+  baseline.Record("faster", 100.0, "M op/sec");
+  baseline.Record("removed", 100.0, "M op/sec");
+  assert(baseline.WriteFile(csv_path) == true);
+
+  BenchmarkHarness current{0, 1};
+  current.Record("steady", 97.0, "M op/sec");
+  current.Record("slower, \"quoted\"", 90.0, "M op/sec");
+  current.Record("faster", 120.0, "M op/sec");
+  current.Record("added", 100.0, "M op/sec");
+
+  std::vector<BenchmarkHarness::Comparison> comparison_list{};
+  bool ret = current.CompareBaseline(csv_path, 0.05, &comparison_list);
+  assert(ret == true);
+  assert(comparison_list.size() == 3);
+
+  assert(comparison_list[0].name == "steady");
+  assert(comparison_list[0].regression_flag == false);
+  assert(IsClose(comparison_list[0].change, -0.03) == true);
+
+  assert(comparison_list[1].name == "slower, \"quoted\"");
+  assert(comparison_list[1].regression_flag == true);
+  assert(IsClose(comparison_list[1].baseline_median, 100.0) == true);
+
+  assert(comparison_list[2].name == "faster");
+  assert(comparison_list[2].regression_flag == false);
+
+  ret = current.CompareBaseline("/nonexistent/baseline.csv",
+                                0.05,
+                                &comparison_list);
+  assert(ret == false);
+
+  assert(current.WriteFile(json_path) == true);
+  std::ifstream file{json_path};
+  std::string content{std::istreambuf_iterator<char>{file},
+                      std::istreambuf_iterator<char>{}};
+  assert(content.find("\"name\": \"slower, \\\"quoted\\\"\"") != std::string::npos);
+  assert(content.find("\"trial_num\": 1") != std::string::npos);
+
+  dbg_printf("%s", content.c_str());
+
+  remove(csv_path);
+  remove(json_path);
+
+  return;
+}
+
+/*
+ * TestWorkerPool() - Tests that workers are reused, that only the requested
+ *                    ones run, and that they start after all have arrived
+ */
+void TestWorkerPool() {
+  PrintTestName("TestWorkerPool");
+
+  WorkerPool pool{};
+  std::atomic<uint64_t> arrive_count;
+  std::vector<uint64_t> run_count_list(4, 0);
+
+  for(uint64_t thread_num : {4, 2, 4}) {
+    arrive_count.store(0);
+
+    double duration = pool.Run(thread_num,
+                               [&](uint64_t id) {
+                                 // Each requested worker runs once
+                                 assert(arrive_count.fetch_add(1) < thread_num);
+                                 run_count_list[id]++;
+
+                                 return;
+                               });
+
+    assert(arrive_count.load() == thread_num);
+    assert(duration >= 0.0);
+    assert(pool.GetStartSkew() <= duration);
+
+    dbg_printf("%lu threads: %f us; start skew = %f us; end skew = %f us\n",
+               thread_num,
+               duration * 1000000.0,
+               pool.GetStartSkew() * 1000000.0,
+               pool.GetEndSkew() * 1000000.0);
+  }
+
+  assert(pool.GetThreadNum() == 4);
+  assert(run_count_list[0] == 3);
+  assert(run_count_list[1] == 3);
+  assert(run_count_list[2] == 2);
+  assert(run_count_list[3] == 2);
+
+  SpinBarrier barrier{2};
+  std::atomic<uint64_t> phase;
+  phase.store(0);
+
+  // The barrier is reused for several phases
+  StartThreads(2, [&barrier, &phase](uint64_t id) {
+                    for(uint64_t i = 0;i < 100;i++) {
+                      if(id == 0) {
+                        phase.store(i + 1);
+                      }
+
+                      barrier.Wait();
+                      assert(phase.load() == i + 1);
+                      barrier.Wait();
+                    }
+
+                    return;
+                  });
+
+  return;
+}
+
+/*
+ * TestLatencyHistogram() - Tests bucket boundaries, percentiles and merging
+ *                          of latency histograms
+ */
+void TestLatencyHistogram() {
+  PrintTestName("TestLatencyHistogram");
+
+  // Every value is in a bucket whose range contains it and is at most
+  // 1/32 of the value wide
+  uint64_t prev_index = 0;
+  for(uint64_t value = 1;value < (0x1UL << 20);value++) {
+    uint64_t index = LatencyHistogram::GetIndex(value);
+    assert(index < LatencyHistogram::BUCKET_NUM);
+    assert(index >= prev_index);
+    assert(index <= prev_index + 1);
+    assert(LatencyHistogram::GetHighestValue(index) >= value);
+    assert(LatencyHistogram::GetHighestValue(index) - value <= value / 32);
+
+    prev_index = index;
+  }
+
+  assert(LatencyHistogram::GetIndex(UINT64_MAX) ==
+         LatencyHistogram::BUCKET_NUM - 1);
+  assert(LatencyHistogram::GetHighestValue(LatencyHistogram::BUCKET_NUM - 1) ==
+         UINT64_MAX);
+
+  // 1 to 1000 in two histograms
+  LatencyHistogram histogram{};
+  LatencyHistogram other{};
+  for(uint64_t value = 1;value <= 1000;value++) {
+    if(value % 2 == 0) {
+      histogram.Record(value);
+    } else {
+      other.Record(value);
+    }
+  }
+
+  histogram.Merge(other);
+  assert(histogram.GetCount() == 1000);
+  assert(histogram.GetMax() == 1000);
+
+  for(double percentile : {0.5, 0.99, 0.999}) {
+    uint64_t expected = static_cast<uint64_t>(percentile * 1000);
+    uint64_t value = histogram.GetPercentile(percentile);
+
+    dbg_printf("p%g = %lu\n", percentile * 100, value);
+    assert(value >= expected);
+    assert(value - expected <= expected / 32);
+  }
+
+  assert(histogram.GetPercentile(1.0) == 1000);
+  assert(LatencyHistogram{}.GetPercentile(0.5) == 0);
+
+  LatencyRecorder recorder{2, 4};
+  assert(recorder.IsSampled(0) == true);
+  assert(recorder.IsSampled(3) == false);
+  assert(recorder.IsSampled(4) == true);
+
+  recorder.GetHistogram(0)->Record(10);
+  recorder.GetHistogram(1)->Record(30);
+  assert(recorder.Merge().GetCount() == 2);
+  assert(recorder.Merge().GetMax() == 30);
+
+  dbg_printf("ns per tick = %f; timer overhead = %lu ticks\n",
+             TSCTimer::GetNsPerTick(),
+             TSCTimer::GetOverhead());
+  assert(TSCTimer::GetNsPerTick() > 0.0);
+
+  return;
+}
+
+int main() {
+  TestSummarize();
+  TestWarmup();
+  TestBaseline();
+  TestWorkerPool();
+  TestLatencyHistogram();
+
+  return 0;
+}
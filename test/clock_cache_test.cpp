@@ -0,0 +1,211 @@
+/*
+ * clock_cache_test.cpp - Tests CLOCK cache together with LocalWriteEM
+ *
+ * This file should be compiled with debugging flags turned on, and also
+ * without optimization
+ */
+
+#include "../src/ClockCache.h"
+#include "../src/LocalWriteEM.h"
+#include "test_suite.h"
+
+using namespace peloton;
+using namespace index;
+
+// Number of counters in the EM for single threaded tests
+static const uint64_t CoreNum = 8;
+
+using CacheType = ClockCache<uint64_t, uint64_t, LocalWriteEM>;
+using EM = typename CacheType::EMType;
+
+/*
+ * ClockCacheBasicTest() - Single threaded insert, lookup, replace and delete
+ *                         with capacity in number of entries
+ */
+void ClockCacheBasicTest() {
+  PrintTestName("ClockCacheBasicTest");
+
+  EM *em = new EM{CoreNum};
+  CacheType *cache = new CacheType{em, 100};
+
+  for(uint64_t i = 0;i < 100;i++) {
+    bool ret = cache->Insert(i, i + 1);
+    assert(ret == true);
+    (void)ret;
+  }
+
+  assert(cache->GetEntryCount() == 100);
+  assert(cache->GetEvictionCount() == 0);
+
+  // Replacing does not change the usage
+  for(uint64_t i = 0;i < 100;i++) {
+    cache->Insert(i, i + 2);
+
+    uint64_t value = 0;
+    bool ret = cache->Lookup(i, value);
+    assert(ret == true);
+    assert(value == i + 2);
+    (void)ret;
+  }
+
+  assert(cache->GetUsage() == 100);
+
+  // The hand clears all reference bits and then evicts key 0. Touch keys
+  // 1 - 50 such that other keys are evicted next
+  cache->Insert(100, 101);
+  assert(cache->GetEvictionCount() == 1);
+
+  uint64_t value = 0;
+  assert(cache->Lookup(0, value) == false);
+
+  for(uint64_t i = 1;i <= 50;i++) {
+    cache->Lookup(i, value);
+  }
+
+  for(uint64_t i = 101;i < 140;i++) {
+    cache->Insert(i, i + 1);
+  }
+
+  assert(cache->GetEntryCount() == 100);
+  dbg_printf("Eviction count = %lu\n", cache->GetEvictionCount());
+  assert(cache->GetEvictionCount() == 40);
+
+  for(uint64_t i = 1;i <= 50;i++) {
+    assert(cache->Lookup(i, value) == true);
+    assert(value == i + 2);
+  }
+
+  (void)value;
+
+  for(uint64_t i = 1;i <= 50;i++) {
+    bool ret = cache->Delete(i);
+    assert(ret == true);
+
+    ret = cache->Delete(i);
+    assert(ret == false);
+    (void)ret;
+  }
+
+  assert(cache->GetEntryCount() == 50);
+  assert(cache->GetUsage() == 50);
+
+  delete cache;
+
+  // Since there is no GC thread
+  em->SignalExit();
+  delete em;
+
+  return;
+}
+
+/*
+ * ClockCacheChargeTest() - Capacity in bytes with entries of different
+ *                          charges
+ */
+void ClockCacheChargeTest() {
+  PrintTestName("ClockCacheChargeTest");
+
+  EM *em = new EM{CoreNum};
+  CacheType *cache = new CacheType{em, 4096, 64};
+
+  // Larger than the capacity
+  assert(cache->Insert(0, 0, 4097) == false);
+  assert(cache->GetEntryCount() == 0);
+
+  for(uint64_t i = 0;i < 1000;i++) {
+    bool ret = cache->Insert(i, i, 1 + (i % 200));
+    assert(ret == true);
+    assert(cache->GetUsage() <= 4096);
+    (void)ret;
+  }
+
+  dbg_printf("Usage = %lu; Entry count = %lu; Eviction count = %lu\n",
+             cache->GetUsage(),
+             cache->GetEntryCount(),
+             cache->GetEvictionCount());
+
+  // Replacing with a larger charge evicts other entries
+  uint64_t value;
+  assert(cache->Lookup(999, value) == true);
+  cache->Insert(999, 999, 4096);
+  assert(cache->GetEntryCount() == 1);
+  assert(cache->Lookup(999, value) == true);
+  (void)value;
+
+  delete cache;
+
+  em->SignalExit();
+  delete em;
+
+  return;
+}
+
+/*
+ * ClockCacheThreadTest() - Threads look up Zipfian keys and insert on miss
+ *                          with GC thread running
+ *
+ * The value of a key is always derived from the key, so any value read must
+ * be consistent even if the entry is evicted concurrently
+ */
+void ClockCacheThreadTest(uint64_t thread_num, uint64_t op_num) {
+  PrintTestName("ClockCacheThreadTest");
+
+  EM *em = new EM{thread_num};
+  em->SetGCInterval(5);
+  em->StartGCThread();
+
+  CacheType *cache = new CacheType{em, 1000};
+  ZipfianRandom zipf{100000};
+
+  std::atomic<uint64_t> hit_count;
+  hit_count.store(0);
+
+  auto func = [cache, em, op_num, &zipf, &hit_count](uint64_t id) {
+                uint64_t local_hit_count = 0;
+
+                for(uint64_t i = 0;i < op_num;i++) {
+                  uint64_t key = zipf(i, id);
+                  uint64_t value;
+
+                  em->AnnounceEnter(id);
+
+                  if(cache->Lookup(key, value) == true) {
+                    assert(value == key * 3);
+                    local_hit_count++;
+                  } else {
+                    cache->Insert(key, key * 3);
+                  }
+
+                  // Occasionally delete
+                  if((i % 64) == 0) {
+                    cache->Delete(key);
+                  }
+                }
+
+                hit_count.fetch_add(local_hit_count);
+              };
+
+  StartThreads(thread_num, func);
+
+  dbg_printf("Hit rate = %f; Entry count = %lu; Eviction count = %lu\n",
+             static_cast<double>(hit_count.load()) / (thread_num * op_num),
+             cache->GetEntryCount(),
+             cache->GetEvictionCount());
+  assert(cache->GetUsage() <= 1000);
+  assert(cache->GetUsage() == cache->GetEntryCount());
+
+  delete cache;
+  delete em;
+
+  return;
+}
+
+int main() {
+  ClockCacheBasicTest();
+  ClockCacheChargeTest();
+
+  ClockCacheThreadTest(4, 200000);
+  ClockCacheThreadTest(16, 50000);
+
+  return 0;
+}
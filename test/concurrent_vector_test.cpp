@@ -0,0 +1,199 @@
+/*
+ * concurrent_vector_test.cpp - Tests concurrent vector together with
+ *                              LocalWriteEM
+ *
+ * This file should be compiled with debugging flags turned on, and also
+ * without optimization
+ */
+
+#include "../src/ConcurrentVector.h"
+#include "../src/LocalWriteEM.h"
+#include "test_suite.h"
+
+using namespace peloton;
+using namespace index;
+
+// Number of counters in the EM for single threaded tests
+static const uint64_t CoreNum = 8;
+
+using VectorType = ConcurrentVector<uint64_t, LocalWriteEM>;
+using EM = typename VectorType::EMType;
+
+/*
+ * VectorBasicTest() - Single threaded push back, get, set and CAS with
+ *                     small segments such that the directory grows
+ *                     many times
+ */
+void VectorBasicTest(uint64_t op_num) {
+  PrintTestName("VectorBasicTest");
+
+  EM *em = new EM{CoreNum};
+  VectorType *v = new VectorType{em, 4};
+
+  for(uint64_t i = 0;i < op_num;i++) {
+    uint64_t index = v->PushBack(i + 1);
+    assert(index == i);
+    (void)index;
+  }
+
+  dbg_printf("Size = %lu; Capacity = %lu\n", v->GetSize(), v->GetCapacity());
+  assert(v->GetSize() == op_num);
+  assert(v->GetCapacity() >= op_num);
+
+  for(uint64_t i = 0;i < op_num;i++) {
+    assert(v->Get(i) == i + 1);
+    v->Set(i, i + 2);
+  }
+
+  // Beyond capacity
+  assert(v->Get(v->GetCapacity()) == 0);
+
+  uint64_t expected = 0;
+  bool ret = v->CompareExchange(0, expected, 100);
+  assert(ret == false);
+  assert(expected == 2);
+
+  ret = v->CompareExchange(0, expected, 100);
+  assert(ret == true);
+  assert(v->Get(0) == 100);
+  (void)ret;
+
+  // Segments past the last push are only allocated when touched, and 
+  // survive growing the directory
+  uint64_t capacity = v->GetCapacity();
+  assert(v->Get(capacity - 1) == 0);
+  v->Set(capacity - 1, 7);
+  assert(v->Get(capacity - 1) == 7);
+
+  v->Reserve(capacity * 4);
+  assert(v->GetCapacity() >= capacity * 4);
+  assert(v->Get(capacity * 4 - 1) == 0);
+  assert(v->Get(capacity - 1) == 7);
+  assert(v->Get(op_num - 1) == op_num + 1);
+
+  delete v;
+
+  // Since there is no GC thread
+  em->SignalExit();
+  delete em;
+
+  return;
+}
+
+/*
+ * VectorPushTest() - Threads push back values while reading random indices
+ *                    with GC thread running
+ *
+ * Every value must appear exactly once after all threads finish
+ */
+void VectorPushTest(uint64_t thread_num, uint64_t op_num) {
+  PrintTestName("VectorPushTest");
+
+  EM *em = new EM{thread_num};
+  em->SetGCInterval(5);
+  em->StartGCThread();
+
+  VectorType *v = new VectorType{em, 16};
+
+  auto func = [v, em, op_num](uint64_t id) {
+                SimpleInt64Random<> r{};
+
+                for(uint64_t i = 0;i < op_num;i++) {
+                  em->AnnounceEnter(id);
+
+                  // Values are never 0 which denotes not written yet
+                  v->PushBack((id << 32) | (i + 1));
+
+                  uint64_t value = v->Get(r(i, id) % v->GetSize());
+                  assert((value == 0) || ((value & 0xFFFFFFFFUL) <= op_num));
+                  (void)value;
+                }
+              };
+
+  StartThreads(thread_num, func);
+
+  assert(v->GetSize() == thread_num * op_num);
+
+  std::vector<uint64_t> count_list(thread_num * op_num, 0);
+  for(uint64_t i = 0;i < v->GetSize();i++) {
+    uint64_t value = v->Get(i);
+    uint64_t id = value >> 32;
+    uint64_t seq = (value & 0xFFFFFFFFUL) - 1;
+
+    count_list[id * op_num + seq]++;
+  }
+
+  for(uint64_t count : count_list) {
+    assert(count == 1);
+    (void)count;
+  }
+
+  dbg_printf("Capacity = %lu\n", v->GetCapacity());
+
+  delete v;
+  delete em;
+
+  return;
+}
+
+/*
+ * VectorCASTest() - Half of the threads increase counters with CAS while
+ *                   the other half keep pushing back to grow the directory
+ *
+ * No increment could be lost during growth
+ */
+void VectorCASTest(uint64_t thread_num, uint64_t op_num, uint64_t counter_num) {
+  PrintTestName("VectorCASTest");
+
+  EM *em = new EM{thread_num};
+  em->SetGCInterval(5);
+  em->StartGCThread();
+
+  VectorType *v = new VectorType{em, 8};
+  for(uint64_t i = 0;i < counter_num;i++) {
+    v->PushBack(0);
+  }
+
+  auto func = [v, em, op_num, counter_num](uint64_t id) {
+                for(uint64_t i = 0;i < op_num;i++) {
+                  em->AnnounceEnter(id);
+
+                  if((id % 2) == 0) {
+                    v->PushBack(1);
+
+                    continue;
+                  }
+
+                  uint64_t index = i % counter_num;
+                  uint64_t expected = v->Get(index);
+                  while(v->CompareExchange(index, expected, expected + 1) == false);
+                }
+              };
+
+  StartThreads(thread_num, func);
+
+  uint64_t sum = 0;
+  for(uint64_t i = 0;i < counter_num;i++) {
+    sum += v->Get(i);
+  }
+
+  dbg_printf("Sum = %lu; Size = %lu\n", sum, v->GetSize());
+  assert(sum == (thread_num / 2) * op_num);
+  assert(v->GetSize() == counter_num + (thread_num / 2) * op_num);
+
+  delete v;
+  delete em;
+
+  return;
+}
+
+int main() {
+  VectorBasicTest(10000);
+
+  VectorPushTest(4, 100000);
+  VectorPushTest(16, 20000);
+
+  VectorCASTest(8, 100000, 64);
+
+  return 0;
+}
@@ -0,0 +1,216 @@
+/*
+ * deferred_allocator_test.cpp - Tests epoch-deferred allocator together
+ *                               with LocalWriteEM
+ *
+ * This file should be compiled with debugging flags turned on, and also
+ * without optimization
+ */
+
+#include "../src/DeferredAllocator.h"
+#include "../src/LocalWriteEM.h"
+#include "test_suite.h"
+
+#include <list>
+#include <map>
+
+// Number of counters in the EM for single threaded tests
+static const uint64_t CoreNum = 8;
+
+using ContextType = DeferredFreeContext<LocalWriteEM>;
+using EM = typename ContextType::EMType;
+
+template <typename T>
+using AllocatorType = DeferredAllocator<T, LocalWriteEM>;
+
+// Number of Counted objects destroyed
+static std::atomic<uint64_t> destroyed_count;
+
+/*
+ * class Counted - Counts destructor calls
+ */
+class Counted {
+ public:
+  uint64_t magic;
+
+  Counted() :
+    magic{0x12345678UL}
+  {}
+
+  ~Counted() {
+    magic = 0;
+    destroyed_count.fetch_add(1);
+  }
+};
+
+/*
+ * DeferredAllocatorBasicTest() - Uses the allocator in standard containers
+ *                                and retires objects of another type into
+ *                                the same context
+ */
+void DeferredAllocatorBasicTest() {
+  PrintTestName("DeferredAllocatorBasicTest");
+
+  EM *em = new EM{CoreNum};
+  ContextType *context = new ContextType{em};
+
+  destroyed_count.store(0);
+
+  {
+    AllocatorType<uint64_t> alloc{context};
+
+    // Each reallocation defers the old buffer
+    std::vector<uint64_t, AllocatorType<uint64_t>> v{alloc};
+    for(uint64_t i = 0;i < 10000;i++) {
+      v.push_back(i);
+    }
+
+    // Node based containers rebind the allocator to their node types
+    std::map<uint64_t,
+             uint64_t,
+             std::less<uint64_t>,
+             AllocatorType<std::pair<const uint64_t, uint64_t>>> m{alloc};
+    std::list<uint64_t, AllocatorType<uint64_t>> l{alloc};
+
+    for(uint64_t i = 0;i < 1000;i++) {
+      m[i] = i;
+      l.push_back(i);
+    }
+
+    for(uint64_t i = 0;i < 1000;i += 2) {
+      m.erase(i);
+      l.pop_front();
+    }
+
+    assert(m.size() == 500);
+    assert(l.size() == 500);
+  }
+
+  for(uint64_t i = 0;i < 1000;i++) {
+    context->Retire(new Counted{});
+  }
+
+  // Nothing is freed before the EM does GC
+  assert(destroyed_count.load() == 0);
+
+  context->Flush();
+  dbg_printf("Deferred count = %lu\n", context->GetDeferredCount());
+  assert(context->GetDeferredCount() >= 1000 + 1000 + 1000);
+
+  delete context;
+
+  // Since there is no GC thread
+  em->SignalExit();
+  delete em;
+
+  assert(destroyed_count.load() == 1000);
+
+  return;
+}
+
+/*
+ * class ListNode - Node of a linked list allocated by the deferred
+ *                  allocator
+ */
+class ListNode {
+ public:
+  uint64_t magic;
+  uint64_t value;
+  std::atomic<ListNode *> next_p;
+};
+
+/*
+ * DeferredAllocatorListTest() - A single writer keeps inserting and
+ *                               removing nodes of a linked list, while
+ *                               readers traverse it without lock
+ *
+ * Removed nodes are freed through the allocator right after being
+ * unlinked, so readers would run into freed memory (which the sanitizer
+ * reports, or reused memory with a broken magic) if the free were not
+ * deferred
+ */
+void DeferredAllocatorListTest(uint64_t reader_num, uint64_t op_num) {
+  PrintTestName("DeferredAllocatorListTest");
+
+  EM *em = new EM{reader_num + 1};
+  em->SetGCInterval(5);
+  em->StartGCThread();
+
+  ContextType *context = new ContextType{em};
+  AllocatorType<ListNode> alloc{context};
+
+  std::atomic<ListNode *> head_p;
+  head_p.store(nullptr);
+
+  std::atomic<bool> writer_done;
+  writer_done.store(false);
+
+  auto func = [em, op_num, &alloc, &head_p, &writer_done](uint64_t id) {
+                if(id == 0) {
+                  uint64_t length = 0;
+
+                  for(uint64_t i = 0;i < op_num;i++) {
+                    em->AnnounceEnter(id);
+
+                    if((length < 64) || ((i % 2) == 0)) {
+                      ListNode *node_p = alloc.allocate(1);
+                      node_p->magic = 0x12345678UL;
+                      node_p->value = i;
+                      node_p->next_p.store(head_p.load());
+
+                      head_p.store(node_p);
+                      length++;
+                    } else {
+                      // Remove the second node
+                      ListNode *first_p = head_p.load();
+                      ListNode *node_p = first_p->next_p.load();
+                      first_p->next_p.store(node_p->next_p.load());
+
+                      alloc.deallocate(node_p, 1);
+                      length--;
+                    }
+                  }
+
+                  writer_done.store(true);
+
+                  return;
+                }
+
+                while(writer_done.load() == false) {
+                  em->AnnounceEnter(id);
+
+                  ListNode *node_p = head_p.load();
+                  while(node_p != nullptr) {
+                    assert(node_p->magic == 0x12345678UL);
+                    node_p = node_p->next_p.load();
+                  }
+                }
+              };
+
+  StartThreads(reader_num + 1, func);
+
+  // Free the remaining nodes
+  ListNode *node_p = head_p.load();
+  while(node_p != nullptr) {
+    ListNode *next_p = node_p->next_p.load();
+    alloc.deallocate(node_p, 1);
+
+    node_p = next_p;
+  }
+
+  context->Flush();
+  dbg_printf("Deferred count = %lu\n", context->GetDeferredCount());
+
+  delete context;
+  delete em;
+
+  return;
+}
+
+int main() {
+  DeferredAllocatorBasicTest();
+
+  DeferredAllocatorListTest(4, 1000000);
+  DeferredAllocatorListTest(15, 100000);
+
+  return 0;
+}
@@ -0,0 +1,231 @@
+/*
+ * delta_chain_test.cpp - Tests mapping table + delta chain index with both
+ *                        LocalWriteEM and GlobalWriteEM
+ *
+ * This file should be compiled with debugging flags turned on, and also
+ * without optimization
+ */
+
+#include "../src/DeltaChainIndex.h"
+#include "../src/LocalWriteEM.h"
+#include "../src/GlobalWriteEM.h"
+#include "test_suite.h"
+
+using namespace peloton;
+using namespace index;
+
+// Number of counters in the EM for single threaded tests
+static const uint64_t CoreNum = 8;
+
+using LEMIndexType = DeltaChainIndex<uint64_t, uint64_t, LocalWriteEM>;
+using GEMIndexType = DeltaChainIndex<uint64_t, uint64_t, GlobalWriteEM>;
+
+using LEM = typename LEMIndexType::EMType;
+using GEM = typename GEMIndexType::EMType;
+
+/*
+ * DeltaChainBasicTest() - Single threaded insert, lookup and delete with
+ *                         a small number of pages such that chains are
+ *                         consolidated many times
+ */
+void DeltaChainBasicTest(uint64_t key_num) {
+  PrintTestName("DeltaChainBasicTest");
+
+  LEM *em = new LEM{CoreNum};
+  LEMIndexType *idx = new LEMIndexType{em, 4, 4};
+
+  for(uint64_t i = 0;i < key_num;i++) {
+    bool ret = idx->Insert(i, i + 1);
+    assert(ret == true);
+
+    ret = idx->Insert(i, 0);
+    assert(ret == false);
+    (void)ret;
+  }
+
+  for(uint64_t i = 0;i < key_num;i++) {
+    uint64_t value = 0;
+    bool ret = idx->GetValue(i, value);
+    assert(ret == true);
+    assert(value == i + 1);
+    (void)ret;
+  }
+
+  for(uint64_t i = 0;i < key_num;i += 2) {
+    bool ret = idx->Delete(i);
+    assert(ret == true);
+
+    ret = idx->Delete(i);
+    assert(ret == false);
+    (void)ret;
+  }
+
+  // Deleted keys could be inserted again with a new value
+  for(uint64_t i = 0;i < key_num;i += 4) {
+    bool ret = idx->Insert(i, i + 2);
+    assert(ret == true);
+    (void)ret;
+  }
+
+  for(uint64_t i = 0;i < key_num;i++) {
+    uint64_t value = 0;
+    bool ret = idx->GetValue(i, value);
+
+    if((i % 4) == 0) {
+      assert(ret == true);
+      assert(value == i + 2);
+    } else if((i % 2) == 0) {
+      assert(ret == false);
+    } else {
+      assert(ret == true);
+      assert(value == i + 1);
+    }
+
+    (void)ret;
+  }
+
+  uint64_t item_count = idx->GetItemCount();
+  dbg_printf("Item count = %lu; Consolidation count = %lu\n",
+             item_count,
+             idx->GetConsolidationCount());
+  assert(item_count == key_num / 2 + key_num / 4);
+
+  delete idx;
+
+  // Since there is no GC thread
+  em->SignalExit();
+  delete em;
+
+  return;
+}
+
+/*
+ * DeltaChainLEMTest() - Threads insert and delete random keys with
+ *                       LocalWriteEM GC thread running
+ *
+ * The net number of successful inserts must equal the final item count
+ */
+void DeltaChainLEMTest(uint64_t thread_num, uint64_t op_num, uint64_t key_num) {
+  PrintTestName("DeltaChainLEMTest");
+
+  LEM *em = new LEM{thread_num};
+  em->SetGCInterval(5);
+  em->StartGCThread();
+
+  LEMIndexType *idx = new LEMIndexType{em, 16};
+
+  std::atomic<int64_t> net_insert;
+  net_insert.store(0);
+
+  auto func = [idx, em, op_num, key_num, &net_insert](uint64_t id) {
+                SimpleInt64Random<> r{};
+                int64_t local_net_insert = 0;
+
+                for(uint64_t i = 0;i < op_num;i++) {
+                  uint64_t key = r(i, id) % key_num;
+                  uint64_t value;
+
+                  em->AnnounceEnter(id);
+
+                  switch(r(i, id + 1000) % 3) {
+                    case 0:
+                      local_net_insert += idx->Insert(key, key);
+                      break;
+                    case 1:
+                      local_net_insert -= idx->Delete(key);
+                      break;
+                    default:
+                      if(idx->GetValue(key, value) == true) {
+                        assert(value == key);
+                      }
+                  }
+                }
+
+                net_insert.fetch_add(local_net_insert);
+              };
+
+  StartThreads(thread_num, func);
+
+  uint64_t item_count = idx->GetItemCount();
+  dbg_printf("Net insert = %ld; Item count = %lu; Consolidation = %lu\n",
+             net_insert.load(),
+             item_count,
+             idx->GetConsolidationCount());
+  assert(static_cast<uint64_t>(net_insert.load()) == item_count);
+
+  delete idx;
+  delete em;
+
+  return;
+}
+
+/*
+ * DeltaChainGEMTest() - Same as DeltaChainLEMTest() but uses GlobalWriteEM
+ */
+void DeltaChainGEMTest(uint64_t thread_num, uint64_t op_num, uint64_t key_num) {
+  PrintTestName("DeltaChainGEMTest");
+
+  GEM *em = new GEM{};
+  em->SetGCInterval(5);
+  em->StartGCThread();
+
+  GEMIndexType *idx = new GEMIndexType{em, 16};
+
+  std::atomic<int64_t> net_insert;
+  net_insert.store(0);
+
+  auto func = [idx, em, op_num, key_num, &net_insert](uint64_t id) {
+                SimpleInt64Random<> r{};
+                int64_t local_net_insert = 0;
+
+                for(uint64_t i = 0;i < op_num;i++) {
+                  uint64_t key = r(i, id) % key_num;
+                  uint64_t value;
+
+                  void *epoch_node_p = em->JoinEpoch();
+
+                  switch(r(i, id + 1000) % 3) {
+                    case 0:
+                      local_net_insert += idx->Insert(key, key);
+                      break;
+                    case 1:
+                      local_net_insert -= idx->Delete(key);
+                      break;
+                    default:
+                      if(idx->GetValue(key, value) == true) {
+                        assert(value == key);
+                      }
+                  }
+
+                  em->LeaveEpoch(epoch_node_p);
+                }
+
+                net_insert.fetch_add(local_net_insert);
+              };
+
+  StartThreads(thread_num, func);
+
+  uint64_t item_count = idx->GetItemCount();
+  dbg_printf("Net insert = %ld; Item count = %lu; Consolidation = %lu\n",
+             net_insert.load(),
+             item_count,
+             idx->GetConsolidationCount());
+  assert(static_cast<uint64_t>(net_insert.load()) == item_count);
+
+  delete idx;
+  delete em;
+
+  return;
+}
+
+int main() {
+  DeltaChainBasicTest(10000);
+
+  DeltaChainLEMTest(8, 200000, 256);
+  DeltaChainLEMTest(16, 100000, 4096);
+
+  DeltaChainGEMTest(8, 200000, 256);
+  DeltaChainGEMTest(16, 100000, 4096);
+
+  return 0;
+}
@@ -0,0 +1,224 @@
+/*
+ * hash_map_test.cpp - Tests lock-free hash map together with LocalWriteEM
+ *
+ * This file should be compiled with debugging flags turned on, and also
+ * without optimization
+ */
+
+#include "../src/AtomicHashMap.h"
+#include "../src/LocalWriteEM.h"
+#include "test_suite.h"
+
+using namespace peloton;
+using namespace index;
+
+// Number of counters in the EM for single threaded tests. Multithreaded
+// tests use one counter per thread, since two threads sharing a counter
+// could overwrite each other's announced epoch
+static const uint64_t CoreNum = 8;
+
+using HashMapType = AtomicHashMap<uint64_t, uint64_t, LocalWriteEM>;
+using EM = typename HashMapType::EMType;
+
+/*
+ * HashMapBasicTest() - Single threaded insert, find and delete
+ *
+ * The initial bucket array is small such that it must grow several times
+ */
+void HashMapBasicTest(uint64_t key_num) {
+  PrintTestName("HashMapBasicTest");
+
+  EM *em = new EM{CoreNum};
+  HashMapType *hm = new HashMapType{em, 2};
+
+  for(uint64_t i = 0;i < key_num;i++) {
+    bool ret = hm->Insert(i, i + 1);
+    assert(ret == true);
+    (void)ret;
+  }
+
+  // Duplicated keys are rejected
+  for(uint64_t i = 0;i < key_num;i++) {
+    bool ret = hm->Insert(i, 0);
+    assert(ret == false);
+    (void)ret;
+  }
+
+  dbg_printf("Item count = %lu; Bucket num = %lu\n",
+             hm->GetItemCount(),
+             hm->GetBucketNum());
+  assert(hm->GetItemCount() == key_num);
+  assert(hm->GetBucketNum() * HashMapType::MAX_LOAD_FACTOR >= key_num);
+
+  for(uint64_t i = 0;i < key_num;i++) {
+    uint64_t value = 0;
+    bool ret = hm->Find(i, value);
+    assert(ret == true);
+    assert(value == i + 1);
+    (void)ret;
+  }
+
+  // Delete all even keys and check both halves
+  for(uint64_t i = 0;i < key_num;i += 2) {
+    bool ret = hm->Delete(i);
+    assert(ret == true);
+    (void)ret;
+  }
+
+  for(uint64_t i = 0;i < key_num;i++) {
+    uint64_t value = 0;
+    bool ret = hm->Find(i, value);
+    assert(ret == ((i % 2) == 1));
+
+    ret = hm->Delete(i);
+    assert(ret == ((i % 2) == 1));
+    (void)ret;
+  }
+
+  assert(hm->GetItemCount() == 0);
+
+  delete hm;
+
+  // Since there is no GC thread
+  em->SignalExit();
+  delete em;
+
+  return;
+}
+
+/*
+ * HashMapThreadTest() - Threads insert disjoint key sets, check them and
+ *                       then delete them while GC thread is running
+ */
+void HashMapThreadTest(uint64_t thread_num, uint64_t key_num) {
+  PrintTestName("HashMapThreadTest");
+
+  EM *em = new EM{thread_num};
+  em->SetGCInterval(5);
+  em->StartGCThread();
+
+  HashMapType *hm = new HashMapType{em};
+
+  auto func = [hm, em, thread_num, key_num](uint64_t id) {
+
+                for(uint64_t i = id;i < key_num;i += thread_num) {
+                  em->AnnounceEnter(id);
+
+                  bool ret = hm->Insert(i, i * 2);
+                  assert(ret == true);
+                  (void)ret;
+                }
+
+                for(uint64_t i = id;i < key_num;i += thread_num) {
+                  em->AnnounceEnter(id);
+
+                  uint64_t value = 0;
+                  bool ret = hm->Find(i, value);
+                  assert(ret == true);
+                  assert(value == i * 2);
+                  (void)ret;
+
+                  ret = hm->Delete(i);
+                  assert(ret == true);
+                }
+              };
+
+  StartThreads(thread_num, func);
+
+  dbg_printf("Item count = %lu; Bucket num = %lu\n",
+             hm->GetItemCount(),
+             hm->GetBucketNum());
+  assert(hm->GetItemCount() == 0);
+
+  for(uint64_t i = 0;i < key_num;i++) {
+    uint64_t value;
+    assert(hm->Find(i, value) == false);
+    (void)value;
+  }
+
+  delete hm;
+  delete em;
+
+  return;
+}
+
+/*
+ * HashMapMixedTest() - Threads insert and delete random keys in a small
+ *                      key range, such that operations on the same key
+ *                      contend with each other
+ *
+ * Each thread counts the number of successful inserts and deletes, and the
+ * final item count must equal the difference, and also the number of keys
+ * that could be found
+ */
+void HashMapMixedTest(uint64_t thread_num, uint64_t op_num, uint64_t key_num) {
+  PrintTestName("HashMapMixedTest");
+
+  EM *em = new EM{thread_num};
+  em->SetGCInterval(5);
+  em->StartGCThread();
+
+  HashMapType *hm = new HashMapType{em};
+
+  std::atomic<int64_t> net_insert;
+  net_insert.store(0);
+
+  auto func = [hm, em, op_num, key_num, &net_insert](uint64_t id) {
+                SimpleInt64Random<> r{};
+                int64_t local_net_insert = 0;
+
+                for(uint64_t i = 0;i < op_num;i++) {
+                  uint64_t key = r(i, id) % key_num;
+                  uint64_t value;
+
+                  em->AnnounceEnter(id);
+
+                  switch(r(i, id + 1000) % 3) {
+                    case 0:
+                      local_net_insert += hm->Insert(key, key);
+                      break;
+                    case 1:
+                      local_net_insert -= hm->Delete(key);
+                      break;
+                    default:
+                      if(hm->Find(key, value) == true) {
+                        assert(value == key);
+                      }
+                  }
+                }
+
+                net_insert.fetch_add(local_net_insert);
+              };
+
+  StartThreads(thread_num, func);
+
+  uint64_t found = 0;
+  for(uint64_t i = 0;i < key_num;i++) {
+    uint64_t value;
+    found += hm->Find(i, value);
+  }
+
+  dbg_printf("Net insert = %ld; Found = %lu; Item count = %lu\n",
+             net_insert.load(),
+             found,
+             hm->GetItemCount());
+  assert(static_cast<uint64_t>(net_insert.load()) == found);
+  assert(hm->GetItemCount() == found);
+
+  delete hm;
+  delete em;
+
+  return;
+}
+
+int main() {
+  HashMapBasicTest(10000);
+
+  HashMapThreadTest(8, 100000);
+  HashMapThreadTest(32, 10000);
+
+  HashMapMixedTest(8, 200000, 64);
+  HashMapMixedTest(16, 100000, 4096);
+
+  return 0;
+}
@@ -0,0 +1,336 @@
+
+#pragma once
+
+#ifndef _LATENCY_RECORDER_H
+#define _LATENCY_RECORDER_H
+
+#include "../src/common.h"
+
+#include <chrono>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*
+ * class TSCTimer - Reads the time stamp counter for timing short operations
+ *
+ * Start() fences with lfence before rdtsc such that earlier instructions
+ * are not counted, and End() uses rdtscp which waits for the timed ones to
+ * finish. Ticks are converted to nanoseconds with a rate calibrated once
+ * against steady_clock, which assumes an invariant TSC. On other
+ * architectures steady_clock is used and a tick is a nanosecond
+ */
+class TSCTimer {
+ public:
+
+  /*
+   * Start() - Returns the tick count before a timed operation
+   */
+  static inline uint64_t Start() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_lfence();
+    return __rdtsc();
+#else
+    return GetSteadyNs();
+#endif
+  }
+
+  /*
+   * End() - Returns the tick count after a timed operation
+   */
+  static inline uint64_t End() {
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int aux;
+    uint64_t tick = __rdtscp(&aux);
+    _mm_lfence();
+
+    return tick;
+#else
+    return GetSteadyNs();
+#endif
+  }
+
+  /*
+   * GetNsPerTick() - Returns nanoseconds per tick, which is measured over
+   *                  10 ms on the first call
+   */
+  static double GetNsPerTick() {
+    static const double ns_per_tick = Calibrate();
+
+    return ns_per_tick;
+  }
+
+  /*
+   * GetOverhead() - Returns the ticks measured between Start() and End()
+   *                 with nothing in between, which is the floor of every
+   *                 sample
+   */
+  static uint64_t GetOverhead() {
+    uint64_t overhead = UINT64_MAX;
+    for(int i = 0;i < 1000;i++) {
+      uint64_t start = Start();
+      uint64_t end = End();
+      if(end - start < overhead) {
+        overhead = end - start;
+      }
+    }
+
+    return overhead;
+  }
+
+ private:
+
+  /*
+   * GetSteadyNs() - Returns steady_clock in nanoseconds
+   */
+  static inline uint64_t GetSteadyNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  /*
+   * Calibrate() - Counts ticks in a busy wait of 10 ms of steady_clock
+   */
+  static double Calibrate() {
+    uint64_t start_ns = GetSteadyNs();
+    uint64_t start_tick = Start();
+
+    uint64_t end_ns;
+    do {
+      end_ns = GetSteadyNs();
+    } while(end_ns - start_ns < 10 * 1000 * 1000);
+
+    uint64_t end_tick = End();
+
+    return static_cast<double>(end_ns - start_ns) /
+           static_cast<double>(end_tick - start_tick);
+  }
+};
+
+/*
+ * class LatencyHistogram - Log-bucketed histogram of integer latencies
+ *
+ * Like HdrHistogram, values below SUB_BUCKET_NUM have exact buckets, and
+ * above that each power of two is split into SUB_BUCKET_NUM / 2 linear
+ * buckets, so a bucket is never wider than 1/32 of its values. All 64 bit
+ * values fit in a fixed array and recording is a few shifts and an
+ * increment. The maximum is kept exactly. A histogram is written by one
+ * thread, and merged after the threads finish
+ */
+class LatencyHistogram {
+ public:
+  static constexpr uint64_t SUB_BUCKET_BITS = 6;
+  static constexpr uint64_t SUB_BUCKET_NUM = 0x1UL << SUB_BUCKET_BITS;
+  static constexpr uint64_t HALF_BUCKET_NUM = SUB_BUCKET_NUM / 2;
+  static constexpr uint64_t BUCKET_NUM = \
+    (64 - SUB_BUCKET_BITS + 1) * HALF_BUCKET_NUM + HALF_BUCKET_NUM;
+
+ private:
+  uint64_t count_list[BUCKET_NUM];
+  uint64_t total_count;
+  uint64_t max_value;
+
+ public:
+
+  /*
+   * Constructor
+   */
+  LatencyHistogram() :
+    count_list{},
+    total_count{0},
+    max_value{0}
+  {}
+
+  /*
+   * GetIndex() - Returns the bucket of a value
+   */
+  static inline uint64_t GetIndex(uint64_t value) {
+    if(value < SUB_BUCKET_NUM) {
+      return value;
+    }
+
+    // value >> shift is in [HALF_BUCKET_NUM, SUB_BUCKET_NUM)
+    uint64_t shift = (63 - __builtin_clzl(value)) - (SUB_BUCKET_BITS - 1);
+
+    return shift * HALF_BUCKET_NUM + (value >> shift);
+  }
+
+  /*
+   * GetHighestValue() - Returns the largest value of a bucket
+   */
+  static inline uint64_t GetHighestValue(uint64_t index) {
+    if(index < SUB_BUCKET_NUM) {
+      return index;
+    }
+
+    uint64_t shift = index / HALF_BUCKET_NUM - 1;
+    uint64_t top = index - shift * HALF_BUCKET_NUM;
+
+    return ((top + 1) << shift) - 1;
+  }
+
+  /*
+   * Record() - Adds a value
+   */
+  inline void Record(uint64_t value) {
+    count_list[GetIndex(value)]++;
+    total_count++;
+    if(value > max_value) {
+      max_value = value;
+    }
+
+    return;
+  }
+
+  /*
+   * Merge() - Adds all values of another histogram
+   */
+  void Merge(const LatencyHistogram &other) {
+    for(uint64_t i = 0;i < BUCKET_NUM;i++) {
+      count_list[i] += other.count_list[i];
+    }
+
+    total_count += other.total_count;
+    if(other.max_value > max_value) {
+      max_value = other.max_value;
+    }
+
+    return;
+  }
+
+  /*
+   * GetPercentile() - Returns the highest value of the bucket that has the
+   *                   given fraction of values at or below it
+   *
+   * Returns 0 for an empty histogram. The result never exceeds the maximum
+   */
+  uint64_t GetPercentile(double percentile) const {
+    if(total_count == 0) {
+      return 0;
+    }
+
+    uint64_t rank = static_cast<uint64_t>(percentile * total_count + 0.5);
+    if(rank == 0) {
+      rank = 1;
+    } else if(rank > total_count) {
+      rank = total_count;
+    }
+
+    uint64_t count = 0;
+    for(uint64_t i = 0;i < BUCKET_NUM;i++) {
+      count += count_list[i];
+      if(count >= rank) {
+        uint64_t value = GetHighestValue(i);
+
+        return (value < max_value) ? value : max_value;
+      }
+    }
+
+    return max_value;
+  }
+
+  inline uint64_t GetCount() const {
+    return total_count;
+  }
+
+  inline uint64_t GetMax() const {
+    return max_value;
+  }
+};
+
+/*
+ * class LatencyRecorder - Per-thread histograms of one operation, sampled
+ *                         with TSCTimer
+ *
+ * Threads time one of every sample_interval operations, which must be a
+ * power of two, such that timing does not dominate short operations. Each
+ * thread has a separately allocated histogram, and the histograms are
+ * merged after the threads finish. Values are in ticks
+ */
+class LatencyRecorder {
+ private:
+  std::vector<LatencyHistogram *> histogram_list;
+  uint64_t sample_mask;
+
+ public:
+
+  /*
+   * Constructor
+   */
+  LatencyRecorder(uint64_t thread_num, uint64_t sample_interval = 64) :
+    histogram_list{},
+    sample_mask{sample_interval - 1} {
+    assert((sample_interval & sample_mask) == 0);
+
+    for(uint64_t i = 0;i < thread_num;i++) {
+      histogram_list.push_back(new LatencyHistogram{});
+    }
+
+    return;
+  }
+
+  /*
+   * Destructor
+   */
+  ~LatencyRecorder() {
+    for(LatencyHistogram *histogram_p : histogram_list) {
+      delete histogram_p;
+    }
+
+    return;
+  }
+
+  LatencyRecorder(const LatencyRecorder &) = delete;
+  LatencyRecorder &operator=(const LatencyRecorder &) = delete;
+
+  /*
+   * IsSampled() - Whether the i-th operation of a thread should be timed
+   */
+  inline bool IsSampled(uint64_t i) const {
+    return (i & sample_mask) == 0;
+  }
+
+  /*
+   * GetHistogram() - Returns the histogram of a thread
+   */
+  inline LatencyHistogram *GetHistogram(uint64_t thread_id) {
+    return histogram_list[thread_id];
+  }
+
+  /*
+   * Merge() - Returns a histogram of all threads
+   */
+  LatencyHistogram Merge() const {
+    LatencyHistogram merged{};
+    for(const LatencyHistogram *histogram_p : histogram_list) {
+      merged.Merge(*histogram_p);
+    }
+
+    return merged;
+  }
+
+  /*
+   * Print() - Prints percentiles of all threads in nanoseconds
+   */
+  void Print(const char *name) const {
+    LatencyHistogram merged = Merge();
+    double ns_per_tick = TSCTimer::GetNsPerTick();
+
+    dbg_printf("    %s latency (ns): p50 = %.0f; p99 = %.0f; "
+               "p99.9 = %.0f; max = %.0f\n",
+               name,
+               merged.GetPercentile(0.5) * ns_per_tick,
+               merged.GetPercentile(0.99) * ns_per_tick,
+               merged.GetPercentile(0.999) * ns_per_tick,
+               merged.GetMax() * ns_per_tick);
+
+    dbg_printf("        %lu samples; timer overhead = %.0f ns\n",
+               merged.GetCount(),
+               TSCTimer::GetOverhead() * ns_per_tick);
+
+    return;
+  }
+};
+
+#endif
@@ -0,0 +1,190 @@
+/*
+ * list_set_test.cpp - Tests lock-free list set together with the EMs
+ *
+ * This file should be compiled with debugging flags turned on, and also
+ * without optimization
+ */
+
+#include "../src/AtomicListSet.h"
+#include "../src/LocalWriteEM.h"
+#include "../src/GlobalWriteEM.h"
+#include "test_suite.h"
+
+using namespace peloton;
+using namespace index;
+
+// Number of counters in the EM for single threaded tests
+static const uint64_t CoreNum = 8;
+
+using LEMListSetType = AtomicListSet<uint64_t, LocalWriteEM>;
+using GEMListSetType = AtomicListSet<uint64_t, GlobalWriteEM>;
+
+using LEM = typename LEMListSetType::EMType;
+using GEM = typename GEMListSetType::EMType;
+
+/*
+ * ListSetBasicTest() - Single threaded insert, contains and delete
+ */
+void ListSetBasicTest() {
+  PrintTestName("ListSetBasicTest");
+
+  LEM *em = new LEM{CoreNum};
+  LEMListSetType *ls = new LEMListSetType{em};
+
+  // Insert in a scrambled order
+  for(uint64_t i = 0;i < 100;i++) {
+    bool ret = ls->Insert((i * 37) % 100);
+    assert(ret == true);
+
+    ret = ls->Insert((i * 37) % 100);
+    assert(ret == false);
+    (void)ret;
+  }
+
+  assert(ls->GetSize() == 100);
+
+  for(uint64_t i = 0;i < 100;i += 2) {
+    bool ret = ls->Delete(i);
+    assert(ret == true);
+
+    ret = ls->Delete(i);
+    assert(ret == false);
+    (void)ret;
+  }
+
+  for(uint64_t i = 0;i < 100;i++) {
+    assert(ls->Contains(i) == ((i % 2) == 1));
+  }
+
+  assert(ls->GetSize() == 50);
+
+  delete ls;
+
+  // Since there is no GC thread
+  em->SignalExit();
+  delete em;
+
+  return;
+}
+
+/*
+ * ListSetThreadTest() - Threads insert disjoint keys and then delete them
+ *                       with GC thread running
+ */
+void ListSetThreadTest(uint64_t thread_num, uint64_t op_num) {
+  PrintTestName("ListSetThreadTest");
+
+  LEM *em = new LEM{thread_num};
+  em->SetGCInterval(5);
+  em->StartGCThread();
+
+  LEMListSetType *ls = new LEMListSetType{em};
+
+  auto insert_func = [ls, em, thread_num, op_num](uint64_t id) {
+                       for(uint64_t i = id;i < thread_num * op_num;i += thread_num) {
+                         em->AnnounceEnter(id);
+
+                         bool ret = ls->Insert(i);
+                         assert(ret == true);
+                         (void)ret;
+                       }
+                     };
+
+  auto delete_func = [ls, em, thread_num, op_num](uint64_t id) {
+                       for(uint64_t i = id;i < thread_num * op_num;i += thread_num) {
+                         em->AnnounceEnter(id);
+
+                         assert(ls->Contains(i) == true);
+
+                         bool ret = ls->Delete(i);
+                         assert(ret == true);
+                         (void)ret;
+                       }
+                     };
+
+  StartThreads(thread_num, insert_func);
+  assert(ls->GetSize() == thread_num * op_num);
+
+  StartThreads(thread_num, delete_func);
+  assert(ls->GetSize() == 0);
+
+  delete ls;
+  delete em;
+
+  return;
+}
+
+/*
+ * ListSetMixedTest() - Half of the threads insert keys, and the other half
+ *                      delete them, looping until the key could be deleted
+ *
+ * This uses GlobalWriteEM such that both EMs are covered
+ */
+void ListSetMixedTest(uint64_t thread_num, uint64_t op_num) {
+  PrintTestName("ListSetMixedTest");
+
+  // Make sure thread number is an even number otherwise exit
+  if((thread_num % 2) != 0) {
+    dbg_printf("ListSetMixedTest requires thread_num being an even number!\n");
+
+    return;
+  }
+
+  GEM *em = new GEM{};
+  em->SetGCInterval(5);
+  em->StartGCThread();
+
+  GEMListSetType *ls = new GEMListSetType{em};
+
+  // This is the actual number of threads doing Insert() or Delete()
+  uint64_t delta = thread_num >> 1;
+
+  auto func = [ls, em, delta, op_num](uint64_t id) {
+                bool is_insert = ((id % 2) == 1);
+                id >>= 1;
+
+                for(uint64_t i = id;i < delta * op_num;i += delta) {
+                  while(1) {
+                    void *epoch_node_p = em->JoinEpoch();
+
+                    bool ret;
+                    if(is_insert == true) {
+                      ret = ls->Insert(i);
+                      assert(ret == true);
+                    } else {
+                      ret = ls->Delete(i);
+                    }
+
+                    em->LeaveEpoch(epoch_node_p);
+
+                    if(ret == true) {
+                      break;
+                    }
+                  }
+                }
+              };
+
+  StartThreads(thread_num, func);
+
+  dbg_printf("Size after all deletes = %lu\n", ls->GetSize());
+  assert(ls->GetSize() == 0);
+
+  delete ls;
+  delete em;
+
+  return;
+}
+
+int main() {
+  ListSetBasicTest();
+
+  // Many threads and small number of keys
+  ListSetThreadTest(64, 10);
+  // Many keys and smaller number of threads
+  ListSetThreadTest(4, 1000);
+
+  // Half insert half delete; delete loops until it succeeds
+  ListSetMixedTest(16, 200);
+
+  return 0;
+}
@@ -0,0 +1,149 @@
+/*
+ * rcu_pointer_test.cpp - Tests RCU pointer together with LocalWriteEM
+ *
+ * This file should be compiled with debugging flags turned on, and also
+ * without optimization
+ */
+
+#include "../src/RCUPointer.h"
+#include "../src/LocalWriteEM.h"
+#include "test_suite.h"
+
+using namespace peloton;
+using namespace index;
+
+// Number of counters in the EM for single threaded tests
+static const uint64_t CoreNum = 8;
+
+/*
+ * class Config - A read-mostly object whose fields must always be
+ *                consistent with each other
+ */
+class Config {
+ public:
+  uint64_t version;
+  uint64_t check;
+  std::vector<uint64_t> data;
+
+  Config(uint64_t p_version) :
+    version{p_version},
+    check{p_version * 3},
+    data(16, p_version)
+  {}
+};
+
+using PointerType = RCUPointer<Config, LocalWriteEM>;
+using EM = typename PointerType::EMType;
+
+/*
+ * RCUPointerBasicTest() - Single threaded load, store and compare exchange
+ */
+void RCUPointerBasicTest() {
+  PrintTestName("RCUPointerBasicTest");
+
+  EM *em = new EM{CoreNum};
+  PointerType *ptr = new PointerType{em};
+
+  assert(ptr->Load() == nullptr);
+
+  ptr->Store(new Config{1});
+  assert(ptr->Load()->version == 1);
+
+  // Fails since expected is stale
+  Config *expected_p = nullptr;
+  Config *new_p = new Config{2};
+  bool ret = ptr->CompareExchange(expected_p, new_p);
+  assert(ret == false);
+  assert(expected_p == ptr->Load());
+
+  ret = ptr->CompareExchange(expected_p, new_p);
+  assert(ret == true);
+  assert(ptr->Load() == new_p);
+  (void)ret;
+
+  ptr->Update([](const Config *config_p) {
+                return new Config{config_p->version + 1};
+              });
+
+  assert(ptr->Load()->version == 3);
+  assert(ptr->Load()->check == 9);
+
+  delete ptr;
+
+  // Since there is no GC thread
+  em->SignalExit();
+  delete em;
+
+  return;
+}
+
+/*
+ * RCUPointerThreadTest() - Readers keep checking the object while writers
+ *                          update it with GC thread running
+ *
+ * Every update increases the version by 1, so the final version equals
+ * the total number of updates
+ */
+void RCUPointerThreadTest(uint64_t reader_num,
+                          uint64_t writer_num,
+                          uint64_t op_num) {
+  PrintTestName("RCUPointerThreadTest");
+
+  EM *em = new EM{reader_num + writer_num};
+  em->SetGCInterval(5);
+  em->StartGCThread();
+
+  PointerType *ptr = new PointerType{em, new Config{0}};
+
+  std::atomic<uint64_t> writer_done;
+  writer_done.store(0);
+
+  auto func = [ptr, em, reader_num, writer_num, op_num,
+               &writer_done](uint64_t id) {
+                if(id < writer_num) {
+                  for(uint64_t i = 0;i < op_num;i++) {
+                    em->AnnounceEnter(id);
+
+                    ptr->Update([](const Config *config_p) {
+                                  return new Config{config_p->version + 1};
+                                });
+                  }
+
+                  writer_done.fetch_add(1);
+
+                  return;
+                }
+
+                uint64_t last_version = 0;
+                while(writer_done.load() < writer_num) {
+                  em->AnnounceEnter(id);
+
+                  const Config *config_p = ptr->Load();
+                  assert(config_p->check == config_p->version * 3);
+                  assert(config_p->data[15] == config_p->version);
+
+                  // Versions seen by one reader never go back
+                  assert(config_p->version >= last_version);
+                  last_version = config_p->version;
+                }
+              };
+
+  StartThreads(reader_num + writer_num, func);
+
+  dbg_printf("Final version = %lu\n", ptr->Load()->version);
+  assert(ptr->Load()->version == writer_num * op_num);
+
+  delete ptr;
+  delete em;
+
+  return;
+}
+
+int main() {
+  RCUPointerBasicTest();
+
+  RCUPointerThreadTest(4, 1, 100000);
+  RCUPointerThreadTest(12, 4, 20000);
+
+  return 0;
+}
@@ -0,0 +1,170 @@
+/*
+ * skip_list_test.cpp - Tests lock-free skiplist together with LocalWriteEM
+ *
+ * This file should be compiled with debugging flags turned on, and also
+ * without optimization
+ */
+
+#include "../src/AtomicSkipList.h"
+#include "../src/LocalWriteEM.h"
+#include "test_suite.h"
+
+using namespace peloton;
+using namespace index;
+
+// Number of counters in the EM for single threaded tests. Multithreaded
+// tests use one counter per thread, since two threads sharing a counter
+// could overwrite each other's announced epoch
+static const uint64_t CoreNum = 8;
+
+using SkipListType = AtomicSkipList<uint64_t, uint64_t, LocalWriteEM>;
+using EM = typename SkipListType::EMType;
+
+/*
+ * SkipListBasicTest() - Single threaded insert, find, delete and scan
+ */
+void SkipListBasicTest(uint64_t key_num) {
+  PrintTestName("SkipListBasicTest");
+
+  EM *em = new EM{CoreNum};
+  SkipListType *sl = new SkipListType{em};
+
+  // Insert in a scrambled order
+  for(uint64_t i = 0;i < key_num;i++) {
+    uint64_t key = (i * 7919) % key_num;
+    bool ret = sl->Insert(key, key + 1);
+    assert(ret == true);
+
+    ret = sl->Insert(key, 0);
+    assert(ret == false);
+    (void)ret;
+  }
+
+  for(uint64_t i = 0;i < key_num;i++) {
+    uint64_t value = 0;
+    bool ret = sl->Find(i, value);
+    assert(ret == true);
+    assert(value == i + 1);
+    (void)ret;
+  }
+
+  // Scan must return all keys in order
+  std::vector<SkipListType::KeyValuePair> result{};
+  uint64_t count = sl->Scan(0, key_num, result);
+  assert(count == key_num);
+  for(uint64_t i = 0;i < key_num;i++) {
+    assert(result[i].first == i);
+    assert(result[i].second == i + 1);
+  }
+
+  for(uint64_t i = 0;i < key_num;i += 2) {
+    bool ret = sl->Delete(i);
+    assert(ret == true);
+
+    ret = sl->Delete(i);
+    assert(ret == false);
+    (void)ret;
+  }
+
+  // Only odd keys in [10, 20] are left
+  result.clear();
+  count = sl->Scan(10, 20, result);
+  dbg_printf("Scan [10, 20] returns %lu keys\n", count);
+  assert(count == 5);
+  for(uint64_t i = 0;i < count;i++) {
+    assert(result[i].first == 11 + i * 2);
+  }
+
+  for(uint64_t i = 0;i < key_num;i++) {
+    uint64_t value = 0;
+    bool ret = sl->Find(i, value);
+    assert(ret == ((i % 2) == 1));
+    (void)ret;
+  }
+
+  delete sl;
+
+  // Since there is no GC thread
+  em->SignalExit();
+  delete em;
+
+  return;
+}
+
+/*
+ * SkipListMixedTest() - Threads insert and delete random keys in a small
+ *                       key range while some threads keep scanning
+ *
+ * Scanning threads check that scan results are strictly increasing, and
+ * modifying threads count successful inserts and deletes, the difference
+ * of which must equal the number of keys in the final scan
+ */
+void SkipListMixedTest(uint64_t thread_num, uint64_t op_num, uint64_t key_num) {
+  PrintTestName("SkipListMixedTest");
+
+  EM *em = new EM{thread_num};
+  em->SetGCInterval(5);
+  em->StartGCThread();
+
+  SkipListType *sl = new SkipListType{em};
+
+  std::atomic<int64_t> net_insert;
+  net_insert.store(0);
+
+  auto func = [sl, em, op_num, key_num, &net_insert](uint64_t id) {
+                SimpleInt64Random<> r{};
+                int64_t local_net_insert = 0;
+                std::vector<SkipListType::KeyValuePair> result{};
+
+                for(uint64_t i = 0;i < op_num;i++) {
+                  uint64_t key = r(i, id) % key_num;
+                  uint64_t value;
+
+                  em->AnnounceEnter(id);
+
+                  switch(r(i, id + 1000) % 4) {
+                    case 0:
+                      local_net_insert += sl->Insert(key, key);
+                      break;
+                    case 1:
+                      local_net_insert -= sl->Delete(key);
+                      break;
+                    case 2:
+                      if(sl->Find(key, value) == true) {
+                        assert(value == key);
+                      }
+                      break;
+                    default:
+                      result.clear();
+                      sl->Scan(key, key + 64, result);
+                      for(uint64_t j = 1;j < result.size();j++) {
+                        assert(result[j - 1].first < result[j].first);
+                      }
+                  }
+                }
+
+                net_insert.fetch_add(local_net_insert);
+              };
+
+  StartThreads(thread_num, func);
+
+  std::vector<SkipListType::KeyValuePair> result{};
+  uint64_t count = sl->Scan(0, key_num, result);
+
+  dbg_printf("Net insert = %ld; Found = %lu\n", net_insert.load(), count);
+  assert(static_cast<uint64_t>(net_insert.load()) == count);
+
+  delete sl;
+  delete em;
+
+  return;
+}
+
+int main() {
+  SkipListBasicTest(10000);
+
+  SkipListMixedTest(8, 200000, 64);
+  SkipListMixedTest(16, 100000, 4096);
+
+  return 0;
+}
@@ -0,0 +1,313 @@
+/*
+ * task_em_test.cpp - Tests task handles of LocalWriteEM with user-level
+ *                    tasks that migrate between worker threads
+ *
+ * Tasks are ucontext coroutines scheduled by a simple shared run queue.
+ * A task yields in the middle of its critical section, and is very likely
+ * to be resumed by another worker thread, so the epoch must be pinned by
+ * the task rather than by the core it started on
+ *
+ * This file should be compiled with debugging flags turned on, and also
+ * without optimization
+ */
+
+#include "../src/RCUPointer.h"
+#include "../src/LocalWriteEM.h"
+#include "test_suite.h"
+
+#include <deque>
+#include <mutex>
+
+#include <ucontext.h>
+
+using namespace peloton;
+using namespace index;
+
+// Stack size of each task
+static const uint64_t STACK_SIZE = 64 * 1024;
+
+/*
+ * class Config - An object whose fields are destroyed in its destructor,
+ *                such that reading it after it is freed is detected
+ */
+class Config {
+ public:
+  uint64_t version;
+  uint64_t check;
+
+  Config(uint64_t p_version) :
+    version{p_version},
+    check{p_version * 3 + 1}
+  {}
+
+  ~Config() {
+    check = 0;
+  }
+
+  bool IsValid() const {
+    return check == version * 3 + 1;
+  }
+};
+
+using PointerType = RCUPointer<Config, LocalWriteEM>;
+using EM = typename PointerType::EMType;
+using TaskHandle = typename EM::TaskHandle;
+
+/*
+ * class Task - Control block of a user-level task
+ */
+class Task {
+ public:
+  ucontext_t context;
+  char *stack_p;
+
+  // Context of the worker currently running this task; the task switches
+  // back to it on yield
+  ucontext_t *worker_context_p;
+
+  // ID of the worker currently running this task
+  uint64_t worker_id;
+
+  TaskHandle handle;
+  bool finished;
+
+  uint64_t id;
+  uint64_t op_num;
+  uint64_t migration_count;
+
+  EM *em;
+  PointerType *ptr;
+};
+
+/*
+ * class Scheduler - A run queue shared by all worker threads
+ */
+class Scheduler {
+ public:
+  std::mutex lock;
+  std::deque<Task *> run_queue;
+  std::atomic<uint64_t> finished_count;
+
+  Scheduler() :
+    finished_count{0}
+  {}
+
+  void Push(Task *task_p) {
+    std::lock_guard<std::mutex> guard{lock};
+    run_queue.push_back(task_p);
+
+    return;
+  }
+
+  Task *Pop() {
+    std::lock_guard<std::mutex> guard{lock};
+    if(run_queue.empty() == true) {
+      return nullptr;
+    }
+
+    Task *task_p = run_queue.front();
+    run_queue.pop_front();
+
+    return task_p;
+  }
+};
+
+/*
+ * Yield() - Switches from the task back to the worker running it
+ *
+ * When this returns the task might be running on another worker
+ */
+void Yield(Task *task_p) {
+  swapcontext(&task_p->context, task_p->worker_context_p);
+
+  return;
+}
+
+/*
+ * TaskBody() - Body of every task
+ *
+ * Task 0 keeps replacing the object, and other tasks read it, yield in
+ * the middle, and check it again after being resumed
+ */
+void TaskBody(uint32_t high, uint32_t low) {
+  Task *task_p = reinterpret_cast<Task *>(
+                   (static_cast<uint64_t>(high) << 32) | low);
+
+  for(uint64_t i = 0;i < task_p->op_num;i++) {
+    task_p->em->AnnounceTaskEnter(task_p->handle);
+
+    if(task_p->id == 0) {
+      task_p->ptr->Update([](const Config *config_p) {
+                            return new Config{config_p->version + 1};
+                          });
+    } else {
+      const Config *config_p = task_p->ptr->Load();
+      assert(config_p->IsValid() == true);
+
+      uint64_t worker_id = task_p->worker_id;
+      Yield(task_p);
+
+      task_p->migration_count += (task_p->worker_id != worker_id);
+
+      // Still pinned after migration
+      assert(config_p->IsValid() == true);
+      (void)config_p;
+    }
+
+    task_p->em->AnnounceTaskLeave(task_p->handle);
+
+    Yield(task_p);
+  }
+
+  task_p->finished = true;
+  Yield(task_p);
+
+  // Never resumed after finishing
+  assert(false);
+
+  return;
+}
+
+/*
+ * TaskHandleBasicTest() - Acquires and releases task handles, and checks
+ *                         that idle slots do not hold back GC while active
+ *                         slots do
+ */
+void TaskHandleBasicTest() {
+  PrintTestName("TaskHandleBasicTest");
+
+  // No per-core counter at all
+  EM *em = new EM{0, 2};
+
+  TaskHandle handle_1, handle_2, handle_3;
+  assert(em->AcquireTaskHandle(handle_1) == true);
+  assert(em->AcquireTaskHandle(handle_2) == true);
+  assert(em->AcquireTaskHandle(handle_3) == false);
+
+  em->ReleaseTaskHandle(handle_2);
+  assert(em->AcquireTaskHandle(handle_3) == true);
+
+  em->AnnounceTaskEnter(handle_1);
+
+  em->AddGarbageNode(new Config{1});
+  em->AddGarbageNode(new Config{2});
+  em->GotoNextEpoch();
+  em->DoGC();
+
+  // The head node is never freed by DoGC(), and the other is pinned
+  assert(em->GetPendingNodeCount() == 2);
+
+  em->AnnounceTaskLeave(handle_1);
+  em->DoGC();
+  assert(em->GetPendingNodeCount() == 1);
+
+  em->ReleaseTaskHandle(handle_1);
+  em->ReleaseTaskHandle(handle_3);
+
+  em->SignalExit();
+  delete em;
+
+  return;
+}
+
+/*
+ * TaskMigrationTest() - Runs tasks on a group of worker threads, where
+ *                       tasks migrate inside critical sections
+ */
+void TaskMigrationTest(uint64_t worker_num, uint64_t task_num, uint64_t op_num) {
+  PrintTestName("TaskMigrationTest");
+
+  // Workers do not announce per-core epochs at all
+  EM *em = new EM{0, task_num};
+  em->SetGCInterval(1);
+  em->StartGCThread();
+
+  PointerType *ptr = new PointerType{em, new Config{0}};
+  Scheduler scheduler{};
+
+  std::vector<Task *> task_list{};
+  for(uint64_t i = 0;i < task_num;i++) {
+    Task *task_p = new Task{};
+
+    task_p->stack_p = new char[STACK_SIZE];
+    task_p->finished = false;
+    task_p->id = i;
+    task_p->op_num = op_num;
+    task_p->migration_count = 0;
+    task_p->em = em;
+    task_p->ptr = ptr;
+
+    bool ret = em->AcquireTaskHandle(task_p->handle);
+    assert(ret == true);
+    (void)ret;
+
+    getcontext(&task_p->context);
+    task_p->context.uc_stack.ss_sp = task_p->stack_p;
+    task_p->context.uc_stack.ss_size = STACK_SIZE;
+    task_p->context.uc_link = nullptr;
+
+    uint64_t p = reinterpret_cast<uint64_t>(task_p);
+    makecontext(&task_p->context,
+                reinterpret_cast<void (*)()>(TaskBody),
+                2,
+                static_cast<uint32_t>(p >> 32),
+                static_cast<uint32_t>(p & 0xFFFFFFFFUL));
+
+    task_list.push_back(task_p);
+    scheduler.Push(task_p);
+  }
+
+  auto func = [task_num, &scheduler](uint64_t id) {
+                ucontext_t worker_context;
+
+                while(scheduler.finished_count.load() < task_num) {
+                  Task *task_p = scheduler.Pop();
+                  if(task_p == nullptr) {
+                    std::this_thread::yield();
+
+                    continue;
+                  }
+
+                  task_p->worker_context_p = &worker_context;
+                  task_p->worker_id = id;
+                  swapcontext(&worker_context, &task_p->context);
+
+                  if(task_p->finished == true) {
+                    scheduler.finished_count.fetch_add(1);
+                  } else {
+                    scheduler.Push(task_p);
+                  }
+                }
+              };
+
+  StartThreads(worker_num, func);
+
+  uint64_t migration_count = 0;
+  for(Task *task_p : task_list) {
+    migration_count += task_p->migration_count;
+
+    em->ReleaseTaskHandle(task_p->handle);
+
+    delete[] task_p->stack_p;
+    delete task_p;
+  }
+
+  dbg_printf("Final version = %lu; Migrations inside critical section = %lu\n",
+             ptr->Load()->version,
+             migration_count);
+  assert(ptr->Load()->version == op_num);
+
+  delete ptr;
+  delete em;
+
+  return;
+}
+
+int main() {
+  TaskHandleBasicTest();
+
+  TaskMigrationTest(4, 16, 20000);
+  TaskMigrationTest(8, 64, 2000);
+
+  return 0;
+}
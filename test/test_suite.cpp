@@ -10,6 +10,8 @@
 
 #include "test_suite.h"
 
+#include <algorithm>
+
 /*
  * PrintTestName() - As name suggests 
  */
@@ -70,3 +72,155 @@ void PinToCore(size_t core_id) {
 uint64_t GetCoreNum() {
   return std::thread::hardware_concurrency(); 
 }
+
+/*
+ * WorkerPool Constructor - Creates a pool without workers
+ */
+WorkerPool::WorkerPool() :
+  worker_list{},
+  lock{},
+  start_cv{},
+  done_cv{},
+  generation{0},
+  active_num{0},
+  done_num{0},
+  func_p{nullptr},
+  barrier_p{nullptr},
+  exit_flag{false},
+  start_skew{0.0},
+  end_skew{0.0}
+{}
+
+/*
+ * WorkerPool Destructor - Stops and joins all workers
+ */
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> guard{lock};
+    exit_flag = true;
+  }
+
+  start_cv.notify_all();
+
+  for(Worker *worker_p : worker_list) {
+    worker_p->thread.join();
+    delete worker_p;
+  }
+
+  return;
+}
+
+/*
+ * WorkerFunc() - Body of workers, which waits for runs until the pool is
+ *                destroyed
+ *
+ * seen_generation is the generation when the worker is created, such that
+ * a run started before the thread gets to the lock is not missed
+ */
+void WorkerPool::WorkerFunc(uint64_t id, uint64_t seen_generation) {
+  PinToCore(id % GetCoreNum());
+
+  Worker *worker_p;
+  {
+    std::lock_guard<std::mutex> guard{lock};
+    worker_p = worker_list[id];
+  }
+
+  while(1) {
+    const FuncType *local_func_p;
+    SpinBarrier *local_barrier_p;
+    {
+      std::unique_lock<std::mutex> guard{lock};
+      start_cv.wait(guard, [this, seen_generation]() {
+                             return (exit_flag == true) ||
+                                    (generation != seen_generation);
+                           });
+
+      if(exit_flag == true) {
+        return;
+      }
+
+      seen_generation = generation;
+      if(id >= active_num) {
+        continue;
+      }
+
+      local_func_p = func_p;
+      local_barrier_p = barrier_p;
+    }
+
+    local_barrier_p->Wait();
+
+    TimePoint start_time = std::chrono::steady_clock::now();
+    (*local_func_p)(id);
+    TimePoint end_time = std::chrono::steady_clock::now();
+
+    {
+      std::lock_guard<std::mutex> guard{lock};
+      worker_p->start_time = start_time;
+      worker_p->end_time = end_time;
+
+      done_num++;
+      if(done_num == active_num) {
+        done_cv.notify_one();
+      }
+    }
+  }
+
+  return;
+}
+
+/*
+ * Run() - Runs func(id) on workers 0 to thread_num - 1, and returns the
+ *         seconds between the first worker starting and the last one
+ *         finishing
+ */
+double WorkerPool::Run(uint64_t thread_num, const FuncType &func) {
+  assert(thread_num > 0);
+
+  // Workers read worker_list under the lock when they start
+  {
+    std::lock_guard<std::mutex> guard{lock};
+    while(worker_list.size() < thread_num) {
+      uint64_t id = worker_list.size();
+      worker_list.push_back(new Worker{});
+      worker_list[id]->thread = std::thread{&WorkerPool::WorkerFunc,
+                                            this,
+                                            id,
+                                            generation};
+    }
+  }
+
+  SpinBarrier barrier{thread_num};
+
+  std::unique_lock<std::mutex> guard{lock};
+  func_p = &func;
+  barrier_p = &barrier;
+  active_num = thread_num;
+  done_num = 0;
+  generation++;
+  start_cv.notify_all();
+
+  done_cv.wait(guard, [this]() {
+                        return done_num == active_num;
+                      });
+
+  TimePoint first_start = worker_list[0]->start_time;
+  TimePoint last_start = first_start;
+  TimePoint first_end = worker_list[0]->end_time;
+  TimePoint last_end = first_end;
+  for(uint64_t id = 1;id < thread_num;id++) {
+    first_start = std::min(first_start, worker_list[id]->start_time);
+    last_start = std::max(last_start, worker_list[id]->start_time);
+    first_end = std::min(first_end, worker_list[id]->end_time);
+    last_end = std::max(last_end, worker_list[id]->end_time);
+  }
+
+  start_skew = std::chrono::duration<double>(last_start - first_start).count();
+  end_skew = std::chrono::duration<double>(last_end - first_end).count();
+
+  func_p = nullptr;
+  barrier_p = nullptr;
+
+  return std::chrono::duration<double>(last_end - first_start).count();
+}
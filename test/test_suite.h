@@ -9,6 +9,10 @@
 #include <cmath>
 #include <cstring>
 #include <string>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 
 void PrintTestName(const char *name);
 void SleepFor(uint64_t sleep_ms); 
@@ -36,6 +40,152 @@ void StartThreads(uint64_t num_threads, Fn &&fn, Args &&... args) {
   return;
 }
 
+/*
+ * class SpinBarrier - Barrier that lets a fixed number of threads leave at
+ *                     about the same time
+ *
+ * Threads spin instead of sleeping such that they leave within a few cache
+ * misses of each other, but yield the CPU every now and then in case there
+ * are more threads than cores. The barrier could be reused once all
+ * threads have left
+ */
+class SpinBarrier {
+ private:
+  uint64_t thread_num;
+  std::atomic<uint64_t> count;
+  std::atomic<uint64_t> generation;
+
+ public:
+
+  /*
+   * Constructor
+   */
+  SpinBarrier(uint64_t p_thread_num) :
+    thread_num{p_thread_num},
+    count{0},
+    generation{0} {
+    assert(thread_num > 0);
+
+    return;
+  }
+
+  /*
+   * Wait() - Returns after all threads have called this function
+   */
+  inline void Wait() {
+    uint64_t current_generation = generation.load(std::memory_order_acquire);
+
+    // The last thread resets the count before releasing others, such that
+    // they could not come back and see the old count
+    if(count.fetch_add(1) + 1 == thread_num) {
+      count.store(0, std::memory_order_relaxed);
+      generation.fetch_add(1, std::memory_order_release);
+
+      return;
+    }
+
+    uint64_t spin_count = 0;
+    while(generation.load(std::memory_order_acquire) == current_generation) {
+      spin_count++;
+      if(spin_count % 1024 == 0) {
+        std::this_thread::yield();
+      }
+    }
+
+    return;
+  }
+};
+
+/*
+ * class WorkerPool - Persistent threads that run benchmark functions
+ *
+ * Worker i is pinned to core i % GetCoreNum() when it is created, and
+ * workers are created on demand and kept until the pool is destroyed. Run()
+ * hands a function to the first thread_num workers, which meet at a spin
+ * barrier and then take their start timestamps, such that thread creation,
+ * pinning and wake up are not measured. Idle workers sleep on a condition
+ * variable and do not compete with measured ones
+ */
+class WorkerPool {
+ public:
+  using FuncType = std::function<void(uint64_t)>;
+  using TimePoint = std::chrono::time_point<std::chrono::steady_clock>;
+
+ private:
+
+  /*
+   * class Worker - A thread and the timestamps of its latest run
+   *
+   * Timestamps are stored under the lock after the function returns, so
+   * they are not written in the measured region. Workers are allocated
+   * separately such that the address does not change as the list grows
+   */
+  class Worker {
+   public:
+    std::thread thread;
+    TimePoint start_time;
+    TimePoint end_time;
+  };
+
+  std::vector<Worker *> worker_list;
+
+  // Protects everything below, and the timestamps between runs
+  std::mutex lock;
+  std::condition_variable start_cv;
+  std::condition_variable done_cv;
+
+  // Incremented for each run, and workers wait for it to change
+  uint64_t generation;
+  uint64_t active_num;
+  uint64_t done_num;
+  const FuncType *func_p;
+  SpinBarrier *barrier_p;
+  bool exit_flag;
+
+  // Of the latest run
+  double start_skew;
+  double end_skew;
+
+  void WorkerFunc(uint64_t id, uint64_t seen_generation);
+
+ public:
+  WorkerPool();
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+
+  /*
+   * Run() - Runs func(id) on workers 0 to thread_num - 1, and returns the
+   *         seconds between the first worker starting and the last one
+   *         finishing
+   */
+  double Run(uint64_t thread_num, const FuncType &func);
+
+  /*
+   * GetStartSkew() - Returns the seconds between the first and the last
+   *                  worker starting in the latest run
+   */
+  inline double GetStartSkew() const {
+    return start_skew;
+  }
+
+  /*
+   * GetEndSkew() - Returns the seconds between the first and the last
+   *                worker finishing in the latest run
+   */
+  inline double GetEndSkew() const {
+    return end_skew;
+  }
+
+  /*
+   * GetThreadNum() - Returns the number of workers created so far
+   */
+  inline uint64_t GetThreadNum() const {
+    return worker_list.size();
+  }
+};
+
 /*
  * class Random - A random number generator
  *
@@ -193,6 +343,76 @@ class SimpleInt64Random {
   }
 };
 
+/*
+ * class ZipfianRandom - Generates integers in range [0, n) following the
+ *                       Zipfian distribution
+ *
+ * This uses the method from Gray et al., "Quickly Generating Billion-Record
+ * Synthetic Databases", which is also used by YCSB. 0 is the most frequent
+ * value. The constructor computes the zeta constant in O(n) time, and after
+ * that the object is read-only, such that it could be shared by all threads.
+ * Just like SimpleInt64Random, each call takes a seed and a salt, which are
+ * hashed into a uniform random number
+ *
+ * theta must be in range (0, 1); larger theta means more skewed
+ */
+class ZipfianRandom {
+ private:
+  uint64_t n;
+  double theta;
+
+  double alpha;
+  double zeta_n;
+  double eta;
+
+  // Used to derive uniform numbers between 0 and 1
+  SimpleInt64Random<> hash;
+
+ public:
+
+  /*
+   * Constructor
+   */
+  ZipfianRandom(uint64_t p_n, double p_theta = 0.99) :
+    n{p_n},
+    theta{p_theta},
+    hash{} {
+    assert(n > 0);
+    assert((theta > 0.0) && (theta < 1.0));
+
+    zeta_n = 0.0;
+    for(uint64_t i = 1;i <= n;i++) {
+      zeta_n += 1.0 / std::pow(static_cast<double>(i), theta);
+    }
+
+    double zeta_2 = 1.0 + 1.0 / std::pow(2.0, theta);
+
+    alpha = 1.0 / (1.0 - theta);
+    eta = (1.0 - std::pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta_2 / zeta_n);
+
+    return;
+  }
+
+  /*
+   * operator()() - Returns a random number given the seed and the salt
+   */
+  inline uint64_t operator()(uint64_t value, uint64_t salt) const {
+    double u = static_cast<double>(hash(value, salt) >> 11) /
+               static_cast<double>(0x1UL << 53);
+    double uz = u * zeta_n;
+
+    if(uz < 1.0) {
+      return 0;
+    } else if(uz < 1.0 + std::pow(0.5, theta)) {
+      return 1 % n;
+    }
+
+    uint64_t ret = static_cast<uint64_t>(n * std::pow(eta * u - eta + 1.0, alpha));
+
+    return (ret >= n) ? (n - 1) : ret;
+  }
+};
+
 /*
  * class Argv - Process argument vector of a C program
  *
@@ -6,6 +6,14 @@
 #include "test_suite.h"
 #include "../src/VarLenPool.h"
 
+#include <set>
+
+#include <sys/stat.h>
+
+// Tests that count chunks run on a single node, such that the count does
+// not depend on the machine
+static const NumaTopology single_node_topology{std::vector<uint64_t>{}};
+
 /*
  * VarLenPoolBasicTest() - This function allocates a series of memory
  *                         using an increasing sequence and then check
@@ -101,9 +109,1271 @@ void VarLenPoolThreadTest(int thread_num, int iter) {
 }
 
 
+/*
+ * VarLenPoolReclaimTest() - Single threaded test of chunk reclamation
+ *
+ * Chunks are only reclaimed after all allocations in them are freed and
+ * the epoch has advanced past the epoch they are retired
+ */
+void VarLenPoolReclaimTest() {
+  PrintTestName("VarLenPoolReclaimTest");
+  
+  VarLenPool::EMType *em = new VarLenPool::EMType{1};
+  VarLenPool *vlp = new VarLenPool{256, em, 0, nullptr, &single_node_topology};
+  
+  std::vector<void *> p_list{};
+  
+  em->AnnounceEnter(0);
+  for(int i = 0;i < 1000;i++) {
+    // 64 bytes each, and 208 bytes after the chunk object, so 3 
+    // allocations per chunk
+    p_list.push_back(vlp->Allocate(64));
+  }
+  
+  uint64_t chunk_count = vlp->GetChunkCount();
+  dbg_printf("Chunk count after allocation = %lu\n", chunk_count);
+  assert(chunk_count >= 1000 / 3);
+  
+  // Free all but the first allocation
+  for(int i = 1;i < 1000;i++) {
+    vlp->Free(p_list[i]);
+  }
+  
+  // The current thread is still in the epoch chunks are retired
+  assert(vlp->ReclaimChunks() == 0);
+  
+  em->GotoNextEpoch();
+  em->AnnounceEnter(0);
+  
+  uint64_t freed_count = vlp->ReclaimChunks();
+  dbg_printf("Chunks freed = %lu\n", freed_count);
+  
+  // The first chunk and the tail are still there
+  assert(vlp->GetChunkCount() == 2);
+  assert(freed_count == chunk_count - 2);
+  
+  vlp->Free(p_list[0]);
+  em->GotoNextEpoch();
+  em->AnnounceEnter(0);
+  
+  assert(vlp->ReclaimChunks() == 1);
+  assert(vlp->GetChunkCount() == 1);
+  
+  delete vlp;
+  
+  em->SignalExit();
+  delete em;
+  
+  return;
+}
+
+/*
+ * VarLenPoolReclaimThreadTest() - Threads keep allocating and freeing in
+ *                                 a sliding window with GC threads of both
+ *                                 the EM and the pool running
+ *
+ * The number of chunks must stay bounded by live data rather than the 
+ * total amount of memory ever allocated
+ */
+void VarLenPoolReclaimThreadTest(int thread_num, int iter, int window) {
+  PrintTestName("VarLenPoolReclaimThreadTest");
+  
+  VarLenPool::EMType *em = new VarLenPool::EMType{(uint64_t)thread_num};
+  em->SetGCInterval(1);
+  em->StartGCThread();
+  
+  VarLenPool *vlp = new VarLenPool{4096, em};
+  vlp->SetGCInterval(1);
+  vlp->StartGCThread();
+  
+  std::atomic<uint64_t> max_chunk_count;
+  max_chunk_count.store(0);
+  
+  auto f = [iter, window, em, vlp, &max_chunk_count](uint64_t id) {
+    std::vector<char *> p_list(window, nullptr);
+    
+    for(int i = 0;i < iter;i++) {
+      em->AnnounceEnter(id);
+      
+      int index = i % window;
+      if(p_list[index] != nullptr) {
+        // The content must not be overwritten
+        for(int j = 0;j < 32;j++) {
+          assert(p_list[index][j] == static_cast<char>(id));
+        }
+        
+        vlp->Free(p_list[index]);
+      }
+      
+      p_list[index] = reinterpret_cast<char *>(vlp->Allocate(32));
+      memset(p_list[index], static_cast<char>(id), 32);
+      
+      uint64_t chunk_count = vlp->GetChunkCount();
+      if(chunk_count > max_chunk_count.load()) {
+        max_chunk_count.store(chunk_count);
+      }
+    }
+    
+    for(int i = 0;i < window;i++) {
+      vlp->Free(p_list[i]);
+    }
+    
+    return;
+  };
+  
+  StartThreads(thread_num, f);
+  
+  dbg_printf("Max chunk count = %lu; Chunk count at the end = %lu\n",
+             max_chunk_count.load(),
+             vlp->GetChunkCount());
+  
+  // Without reclamation this would be (thread_num * iter * 32 / 4096)
+  assert(max_chunk_count.load() < (uint64_t)(thread_num * iter * 32 / 4096 / 2));
+  
+  delete vlp;
+  delete em;
+  
+  return;
+}
+
+/*
+ * VarLenPoolThreadSlotTest() - Single threaded test of allocation from
+ *                              chunks owned by thread slots
+ *
+ * Frees happen both before and after the owner seals a chunk
+ */
+void VarLenPoolThreadSlotTest() {
+  PrintTestName("VarLenPoolThreadSlotTest");
+  
+  VarLenPool::EMType *em = new VarLenPool::EMType{1};
+  VarLenPool *vlp = new VarLenPool{256, em, 2, nullptr, &single_node_topology};
+  
+  std::vector<char *> p_list{};
+  
+  em->AnnounceEnter(0);
+  for(int i = 0;i < 1000;i++) {
+    // 3 allocations per chunk as above, alternating slots
+    char *p = reinterpret_cast<char *>(vlp->Allocate(64, i % 2));
+    memset(p, static_cast<char>(i), 64);
+    
+    p_list.push_back(p);
+  }
+  
+  for(int i = 0;i < 1000;i++) {
+    for(int j = 0;j < 64;j++) {
+      assert(p_list[i][j] == static_cast<char>(i));
+    }
+  }
+  
+  // The first chunk of the shared list is never used
+  uint64_t chunk_count = vlp->GetChunkCount();
+  dbg_printf("Chunk count after allocation = %lu\n", chunk_count);
+  assert(chunk_count == 1 + 2 * ((500 + 2) / 3));
+  
+  // This frees memory in the current chunks of both slots before they
+  // are sealed
+  for(int i = 0;i < 1000;i++) {
+    vlp->Free(p_list[i]);
+  }
+  
+  em->GotoNextEpoch();
+  em->AnnounceEnter(0);
+  
+  // All but the heads of the two lists
+  uint64_t freed_count = vlp->ReclaimChunks();
+  dbg_printf("Chunks freed = %lu\n", freed_count);
+  assert(freed_count == chunk_count - 3);
+  
+  // Sealing chunks without live allocation retires them directly, but
+  // they are kept as list heads until new chunks are pushed
+  vlp->ReleaseThreadChunk(0);
+  vlp->ReleaseThreadChunk(1);
+  
+  void *p = vlp->Allocate(64, 0);
+  em->GotoNextEpoch();
+  em->AnnounceEnter(0);
+  
+  assert(vlp->ReclaimChunks() == 1);
+  assert(vlp->GetChunkCount() == 3);
+  
+  vlp->Free(p);
+  
+  delete vlp;
+  
+  em->SignalExit();
+  delete em;
+  
+  return;
+}
+
+/*
+ * VarLenPoolThreadSlotFreeTest() - Threads allocate from their own slots
+ *                                  and memory is freed by the next thread
+ *                                  with GC threads running
+ *
+ * Each thread passes its allocations to the next thread through a ring of
+ * mailboxes, such that most frees are from another thread. If sized is
+ * true the blocks are freed into the free list of the freeing thread
+ */
+void VarLenPoolThreadSlotFreeTest(int thread_num, int iter, bool sized) {
+  PrintTestName("VarLenPoolThreadSlotFreeTest");
+  
+  VarLenPool::EMType *em = new VarLenPool::EMType{(uint64_t)thread_num};
+  em->SetGCInterval(1);
+  em->StartGCThread();
+  
+  VarLenPool *vlp = new VarLenPool{4096, em, (uint64_t)thread_num};
+  vlp->SetGCInterval(1);
+  vlp->StartGCThread();
+  
+  std::vector<std::atomic<char *>> mailbox_list(thread_num);
+  for(int i = 0;i < thread_num;i++) {
+    mailbox_list[i].store(nullptr);
+  }
+  
+  std::atomic<uint64_t> max_chunk_count;
+  max_chunk_count.store(0);
+  
+  auto f = [thread_num, 
+            iter, 
+            em, 
+            vlp, 
+            sized,
+            &mailbox_list, 
+            &max_chunk_count](uint64_t id) {
+    for(int i = 0;i < iter;i++) {
+      em->AnnounceEnter(id);
+      
+      char *p = reinterpret_cast<char *>(vlp->Allocate(32, id));
+      memset(p, static_cast<char>(id), 32);
+      
+      // Whatever was in the mailbox of the next thread is freed here
+      p = mailbox_list[(id + 1) % thread_num].exchange(p);
+      if(p != nullptr) {
+        char c = p[0];
+        for(int j = 0;j < 32;j++) {
+          assert(p[j] == c);
+        }
+        (void)c;
+        
+        if(sized == true) {
+          vlp->Free(p, 32, id);
+        } else {
+          vlp->Free(p);
+        }
+      }
+      
+      uint64_t chunk_count = vlp->GetChunkCount();
+      if(chunk_count > max_chunk_count.load()) {
+        max_chunk_count.store(chunk_count);
+      }
+    }
+    
+    vlp->ReleaseThreadChunk(id);
+    
+    return;
+  };
+  
+  StartThreads(thread_num, f);
+  
+  for(int i = 0;i < thread_num;i++) {
+    char *p = mailbox_list[i].load();
+    if(p != nullptr) {
+      vlp->Free(p);
+    }
+  }
+  
+  dbg_printf("Max chunk count = %lu; Chunk count at the end = %lu\n",
+             max_chunk_count.load(),
+             vlp->GetChunkCount());
+  
+  // Without reclamation this would be (thread_num * iter * 32 / 4096)
+  assert(max_chunk_count.load() < (uint64_t)(thread_num * iter * 32 / 4096 / 2));
+  
+  delete vlp;
+  delete em;
+  
+  return;
+}
+
+/*
+ * VarLenPoolSizeClassTest() - Single threaded test of reusing freed blocks
+ *                             through size class free lists
+ *
+ * Blocks are not reused before the epoch they are freed in has passed, 
+ * and are reused in the order they are freed afterwards
+ */
+void VarLenPoolSizeClassTest() {
+  PrintTestName("VarLenPoolSizeClassTest");
+  
+  VarLenPool::EMType *em = new VarLenPool::EMType{1};
+  VarLenPool *vlp = new VarLenPool{1024, em, 1};
+  
+  em->AnnounceEnter(0);
+  
+  // 40 bytes is rounded up to the 48 byte class, so 20 blocks per chunk
+  std::vector<char *> p_list{};
+  for(int i = 0;i < 10;i++) {
+    p_list.push_back(reinterpret_cast<char *>(vlp->Allocate(40, 0)));
+    memset(p_list[i], static_cast<char>(i), 48);
+  }
+  
+  for(int i = 0;i < 10;i++) {
+    for(int j = 0;j < 48;j++) {
+      assert(p_list[i][j] == static_cast<char>(i));
+    }
+    
+    vlp->Free(p_list[i], 40, 0);
+  }
+  
+  // Still in the same epoch, so nothing is reused even when the chunk
+  // is exhausted
+  std::set<char *> freed_set{p_list.begin(), p_list.end()};
+  for(int i = 0;i < 20;i++) {
+    char *p = reinterpret_cast<char *>(vlp->Allocate(48, 0));
+    assert(freed_set.find(p) == freed_set.end());
+    (void)p;
+  }
+  
+  em->GotoNextEpoch();
+  em->AnnounceEnter(0);
+  
+  // Another class never takes blocks of the 48 byte class
+  for(int i = 0;i < 20;i++) {
+    char *p = reinterpret_cast<char *>(vlp->Allocate(64, 0));
+    assert(freed_set.find(p) == freed_set.end());
+    (void)p;
+  }
+  
+  // The chunk was exhausted above, so the minimum epoch is refreshed
+  for(int i = 0;i < 10;i++) {
+    char *p = reinterpret_cast<char *>(vlp->Allocate(41, 0));
+    assert(p == p_list[i]);
+    (void)p;
+  }
+  
+  // Larger than all classes
+  void *p = vlp->Allocate(1000, 0);
+  vlp->Free(p, 1000, 0);
+  
+  vlp->ReleaseThreadChunk(0);
+  
+  delete vlp;
+  
+  em->SignalExit();
+  delete em;
+  
+  return;
+}
+
+/*
+ * VarLenPoolFreeContentTest() - Tests that freeing a block into a free list
+ *                               does not write into the block
+ *
+ * A reader that entered before the blocks are freed still holds them, so
+ * their contents must stay intact until the epoch has passed. More blocks
+ * than the initial capacity of a free list are freed such that it grows
+ */
+void VarLenPoolFreeContentTest() {
+  PrintTestName("VarLenPoolFreeContentTest");
+  
+  VarLenPool::EMType *em = new VarLenPool::EMType{2};
+  VarLenPool *vlp = new VarLenPool{4096, em, 2};
+  
+  const int block_num = 200;
+  
+  em->AnnounceEnter(0);
+  
+  std::vector<char *> p_list{};
+  for(int i = 0;i < block_num;i++) {
+    p_list.push_back(reinterpret_cast<char *>(vlp->Allocate(32, 0)));
+    memset(p_list[i], static_cast<char>(i), 32);
+  }
+  
+  // The reader enters and keeps all blocks while the writer frees them
+  em->AnnounceEnter(1);
+  
+  for(int i = 0;i < block_num;i++) {
+    vlp->Free(p_list[i], 32, 0);
+  }
+  
+  for(int i = 0;i < block_num;i++) {
+    for(int j = 0;j < 32;j++) {
+      assert(p_list[i][j] == static_cast<char>(i));
+    }
+  }
+  
+  // Once both threads have left the epoch blocks are reused in order. The
+  // cached minimum epoch is refreshed after a few misses, and allocations
+  // before that are bump allocated
+  em->GotoNextEpoch();
+  em->AnnounceEnter(0);
+  em->AnnounceEnter(1);
+  
+  std::set<char *> freed_set{p_list.begin(), p_list.end()};
+  int reused_count = 0;
+  for(int i = 0;(i < 10000) && (reused_count < block_num);i++) {
+    char *p = reinterpret_cast<char *>(vlp->Allocate(32, 0));
+    if(freed_set.find(p) != freed_set.end()) {
+      assert(p == p_list[reused_count]);
+      reused_count++;
+    }
+  }
+  
+  assert(reused_count == block_num);
+  
+  vlp->ReleaseThreadChunk(0);
+  
+  delete vlp;
+  
+  em->SignalExit();
+  delete em;
+  
+  return;
+}
+
+/*
+ * VarLenPoolLargeTest() - Allocations larger than half of a chunk get
+ *                         dedicated chunks which are reclaimed after free
+ */
+void VarLenPoolLargeTest() {
+  PrintTestName("VarLenPoolLargeTest");
+  
+  VarLenPool::EMType *em = new VarLenPool::EMType{1};
+  VarLenPool *vlp = new VarLenPool{256, em, 1, nullptr, &single_node_topology};
+  
+  em->AnnounceEnter(0);
+  
+  std::vector<char *> p_list{};
+  for(int i = 0;i < 10;i++) {
+    char *p = nullptr;
+    if((i % 2) == 0) {
+      p = reinterpret_cast<char *>(vlp->Allocate(1000 + i));
+    } else {
+      p = reinterpret_cast<char *>(vlp->Allocate(1000 + i, 0));
+    }
+    
+    memset(p, static_cast<char>(i), 1000 + i);
+    p_list.push_back(p);
+  }
+  
+  // The first chunk of the shared list and the dedicated chunks
+  assert(vlp->GetChunkCount() == 1 + 10);
+  
+  for(int i = 0;i < 10;i++) {
+    for(int j = 0;j < 1000 + i;j++) {
+      assert(p_list[i][j] == static_cast<char>(i));
+    }
+    
+    vlp->Free(p_list[i]);
+  }
+  
+  em->GotoNextEpoch();
+  em->AnnounceEnter(0);
+  
+  // The most recent dedicated chunk is the head of the list
+  assert(vlp->ReclaimChunks() == 9);
+  assert(vlp->GetChunkCount() == 2);
+  
+  delete vlp;
+  
+  em->SignalExit();
+  delete em;
+  
+  return;
+}
+
+/*
+ * ChunkProviderTest() - Maps and decommits regions directly with the mmap
+ *                       based provider
+ */
+void ChunkProviderTest(MmapChunkProvider::HugePageMode mode) {
+  PrintTestName("ChunkProviderTest");
+  
+  MmapChunkProvider provider{mode};
+  
+  uint64_t region_count = 0;
+  for(size_t alignment = 64;alignment <= 1024 * 1024 * 8;alignment *= 8) {
+    region_count++;
+    size_t sz = alignment + 100;
+    char *p = reinterpret_cast<char *>(provider.Allocate(sz, alignment));
+    assert((reinterpret_cast<uint64_t>(p) % alignment) == 0);
+    
+    memset(p, 1, sz);
+    
+    // Anonymous memory reads as zero after being decommitted, unless the
+    // kernel does not decommit huge page pool mappings
+    uint64_t fail_count = provider.GetDecommitFailCount();
+    provider.Decommit(p, sz);
+    if(provider.GetDecommitFailCount() == fail_count) {
+      for(size_t i = 0;i < sz;i++) {
+        assert(p[i] == 0);
+      }
+    }
+    
+    // Still usable
+    memset(p, 2, sz);
+    provider.Free(p, sz);
+  }
+  
+  dbg_printf("HugeTLB count = %lu; Fallback count = %lu; "
+             "Decommit fail count = %lu\n",
+             provider.GetHugeTLBCount(),
+             provider.GetFallbackCount(),
+             provider.GetDecommitFailCount());
+  if(mode == MmapChunkProvider::HugePageMode::HUGETLB) {
+    assert(provider.GetHugeTLBCount() + provider.GetFallbackCount() == region_count);
+  }
+  
+  return;
+}
+
+/*
+ * VarLenPoolProviderTest() - Threads allocate from a pool whose chunks are
+ *                            mapped by the mmap based provider
+ */
+void VarLenPoolProviderTest(MmapChunkProvider::HugePageMode mode, 
+                            int thread_num, 
+                            int iter) {
+  PrintTestName("VarLenPoolProviderTest");
+  
+  MmapChunkProvider provider{mode};
+  
+  VarLenPool::EMType *em = new VarLenPool::EMType{(uint64_t)thread_num};
+  em->SetGCInterval(1);
+  em->StartGCThread();
+  
+  VarLenPool *vlp = new VarLenPool{MmapChunkProvider::HUGE_PAGE_SIZE, 
+                                   em, 
+                                   (uint64_t)thread_num, 
+                                   &provider};
+  vlp->SetGCInterval(1);
+  vlp->StartGCThread();
+  
+  auto f = [iter, em, vlp](uint64_t id) {
+    std::vector<char *> p_list(256, nullptr);
+    
+    for(int i = 0;i < iter;i++) {
+      em->AnnounceEnter(id);
+      
+      int index = i % 256;
+      if(p_list[index] != nullptr) {
+        for(int j = 0;j < 64;j++) {
+          assert(p_list[index][j] == static_cast<char>(id));
+        }
+        
+        vlp->Free(p_list[index], 64, id);
+      }
+      
+      // Some allocations are large and have dedicated chunks
+      if((i % 1000) == 0) {
+        void *p = vlp->Allocate(MmapChunkProvider::HUGE_PAGE_SIZE, id);
+        memset(p, 0, MmapChunkProvider::HUGE_PAGE_SIZE);
+        vlp->Free(p);
+      }
+      
+      p_list[index] = reinterpret_cast<char *>(vlp->Allocate(64, id));
+      memset(p_list[index], static_cast<char>(id), 64);
+    }
+    
+    for(int i = 0;i < 256;i++) {
+      vlp->Free(p_list[i]);
+    }
+    
+    vlp->ReleaseThreadChunk(id);
+    
+    return;
+  };
+  
+  StartThreads(thread_num, f);
+  
+  dbg_printf("Chunk count = %lu; HugeTLB count = %lu; Fallback count = %lu\n",
+             vlp->GetChunkCount(),
+             provider.GetHugeTLBCount(),
+             provider.GetFallbackCount());
+  
+  delete vlp;
+  delete em;
+  
+  return;
+}
+
+/*
+ * class CountingChunkProvider - Counts calls into the heap provider
+ */
+class CountingChunkProvider : public HeapChunkProvider {
+ public:
+  uint64_t allocate_count = 0;
+  uint64_t free_count = 0;
+  uint64_t decommit_count = 0;
+  
+  void *Allocate(size_t sz, size_t alignment) override {
+    allocate_count++;
+    
+    return HeapChunkProvider::Allocate(sz, alignment);
+  }
+  
+  void Free(void *p, size_t sz) override {
+    free_count++;
+    HeapChunkProvider::Free(p, sz);
+    
+    return;
+  }
+  
+  void Decommit(void *p, size_t sz) override {
+    decommit_count++;
+    HeapChunkProvider::Decommit(p, sz);
+    
+    return;
+  }
+};
+
+/*
+ * VarLenPoolChunkCacheTest() - Reclaimed chunks are reused before asking
+ *                              the provider, and decommitted after being
+ *                              idle for a number of rounds
+ */
+void VarLenPoolChunkCacheTest() {
+  PrintTestName("VarLenPoolChunkCacheTest");
+  
+  CountingChunkProvider provider{};
+  
+  VarLenPool::EMType *em = new VarLenPool::EMType{1};
+  VarLenPool *vlp = new VarLenPool{8192, 
+                                    em, 
+                                    0, 
+                                    &provider, 
+                                    &single_node_topology};
+  vlp->SetChunkCacheSize(8);
+  vlp->SetDecommitRound(3);
+  
+  em->AnnounceEnter(0);
+  
+  // 2 allocations per chunk, so 20 chunks
+  std::vector<void *> p_list{};
+  for(int i = 0;i < 40;i++) {
+    p_list.push_back(vlp->Allocate(4000));
+  }
+  
+  assert(vlp->GetChunkCount() == 20);
+  assert(provider.allocate_count == 20);
+  
+  for(void *p : p_list) {
+    vlp->Free(p);
+  }
+  
+  em->GotoNextEpoch();
+  em->AnnounceEnter(0);
+  
+  // All but the tail are reclaimed, and the cache takes 8 of them
+  assert(vlp->ReclaimChunks() == 19);
+  assert(vlp->GetCachedChunkCount() == 8);
+  assert(provider.free_count == 11);
+  
+  // Reusing cached chunks does not ask the provider
+  p_list.clear();
+  for(int i = 0;i < 10;i++) {
+    p_list.push_back(vlp->Allocate(4000));
+  }
+  
+  dbg_printf("Cached chunk count = %lu\n", vlp->GetCachedChunkCount());
+  assert(vlp->GetCachedChunkCount() == 8 - 5);
+  assert(provider.allocate_count == 20);
+  
+  // Idle chunks are decommitted after 3 rounds, and only once
+  for(int i = 0;i < 5;i++) {
+    vlp->ReclaimChunks();
+  }
+  
+  assert(vlp->GetDecommitCount() == 3);
+  assert(provider.decommit_count == 3);
+  
+  // Decommitted chunks are still usable
+  for(int i = 0;i < 10;i++) {
+    void *p = vlp->Allocate(4000);
+    memset(p, 0, 4000);
+    
+    p_list.push_back(p);
+  }
+  
+  assert(vlp->GetCachedChunkCount() == 0);
+  assert(provider.allocate_count == 20 + 2);
+  
+  for(void *p : p_list) {
+    vlp->Free(p);
+  }
+  
+  delete vlp;
+  
+  // Everything is given back to the provider in the end
+  assert(provider.free_count == provider.allocate_count);
+  
+  em->SignalExit();
+  delete em;
+  
+  return;
+}
+
+/*
+ * VarLenPoolNumaTest() - Allocations come from chunks of the node the
+ *                        caller runs on, which is simulated as node 
+ *                        expected_node out of two nodes
+ */
+void VarLenPoolNumaTest(uint64_t expected_node) {
+  PrintTestName("VarLenPoolNumaTest");
+  
+  // Put all CPUs on the expected node, and a CPU that does not exist on
+  // the other node such that there are two nodes
+  std::vector<uint64_t> cpu_to_node(GetCoreNum(), expected_node);
+  cpu_to_node.push_back(1 - expected_node);
+  
+  NumaTopology topology{cpu_to_node};
+  
+  VarLenPool::EMType *em = new VarLenPool::EMType{1};
+  VarLenPool *vlp = new VarLenPool{256, em, 1, nullptr, &topology};
+  
+  // Each node starts with a chunk of its own
+  assert(vlp->GetNodeNum() == 2);
+  assert(vlp->GetChunkCount() == 2);
+  
+  em->AnnounceEnter(0);
+  
+  // 3 allocations per chunk as in VarLenPoolReclaimTest()
+  std::vector<void *> p_list{};
+  for(int i = 0;i < 30;i++) {
+    void *p = vlp->Allocate(64);
+    assert(vlp->GetNode(p) == expected_node);
+    
+    p_list.push_back(p);
+  }
+  
+  // Only the list of the expected node grows
+  assert(vlp->GetChunkCount() == 2 + 9);
+  
+  // Owned and large chunks are placed on the node of the caller as well
+  void *owned_p = vlp->Allocate(64, 0);
+  void *large_p = vlp->Allocate(1000);
+  assert(vlp->GetNode(owned_p) == expected_node);
+  assert(vlp->GetNode(large_p) == expected_node);
+  
+  for(void *p : p_list) {
+    vlp->Free(p);
+  }
+  
+  em->GotoNextEpoch();
+  em->AnnounceEnter(0);
+  
+  // All but the tail of the node list are reclaimed
+  assert(vlp->ReclaimChunks() == 9);
+  assert(vlp->GetChunkCount() == 2 + 2);
+  
+  // The chunk cache gives chunks back to the same node
+  for(int i = 0;i < 30;i++) {
+    assert(vlp->GetNode(vlp->Allocate(64)) == expected_node);
+  }
+  
+  vlp->Free(owned_p);
+  vlp->Free(large_p);
+  
+  delete vlp;
+  
+  em->SignalExit();
+  delete em;
+  
+  return;
+}
+    
+/*
+ * NumaTopologySparseTest() - Reads a sysfs node directory where node 1 is
+ *                            offline, such that node IDs are not
+ *                            contiguous
+ */
+void NumaTopologySparseTest() {
+  PrintTestName("NumaTopologySparseTest");
+    
+  static const std::string node_path = "/tmp/numa_topology_test";
+    
+  mkdir(node_path.c_str(), 0755);
+  mkdir((node_path + "/node0").c_str(), 0755);
+  mkdir((node_path + "/node2").c_str(), 0755);
+  std::ofstream{node_path + "/online"} << "0,2\n";
+  std::ofstream{node_path + "/node0/cpulist"} << "0-1\n";
+  std::ofstream{node_path + "/node2/cpulist"} << "2-3,6\n";
+    
+  NumaTopology topology{node_path};
+  assert(topology.GetNodeNum() == 2);
+  assert(topology.GetNodeID(0) == 0);
+  assert(topology.GetNodeID(1) == 2);
+    
+  assert(topology.GetNode(1) == 0);
+  assert(topology.GetNode(2) == 1);
+  assert(topology.GetNode(6) == 1);
+  // CPUs not in any list are on the first node
+  assert(topology.GetNode(4) == 0);
+  assert(topology.GetNode(100) == 0);
+    
+  remove((node_path + "/node2/cpulist").c_str());
+  remove((node_path + "/node0/cpulist").c_str());
+  remove((node_path + "/online").c_str());
+  rmdir((node_path + "/node2").c_str());
+  rmdir((node_path + "/node0").c_str());
+  rmdir(node_path.c_str());
+    
+  // Without sysfs there is a single node
+  NumaTopology empty_topology{node_path};
+  assert(empty_topology.GetNodeNum() == 1);
+  assert(empty_topology.GetNodeID(0) == 0);
+  assert(empty_topology.GetNode(3) == 0);
+    
+  return;
+}
+    
+/*
+ * class AlignedCounter - An over-aligned object that counts constructions
+ *                        and destructions
+ */
+class alignas(64) AlignedCounter {
+ public:
+  static uint64_t construct_count;
+  static uint64_t destroy_count;
+  
+  uint64_t value;
+  
+  AlignedCounter(uint64_t p_value) :
+    value{p_value} {
+    construct_count++;
+    
+    return;
+  }
+  
+  ~AlignedCounter() {
+    destroy_count++;
+    
+    return;
+  }
+};
+    
+uint64_t AlignedCounter::construct_count = 0;
+uint64_t AlignedCounter::destroy_count = 0;
+    
+/*
+ * VarLenPoolAlignedTest() - Aligned allocations from all paths, and typed
+ *                           objects that are deleted or retired
+ */
+void VarLenPoolAlignedTest() {
+  PrintTestName("VarLenPoolAlignedTest");
+  
+  VarLenPool::EMType *em = new VarLenPool::EMType{1};
+  VarLenPool *vlp = new VarLenPool{1024, em, 1, nullptr, &single_node_topology};
+  
+  em->AnnounceEnter(0);
+  
+  std::vector<char *> p_list{};
+  for(int i = 0;i < 200;i++) {
+    size_t align = 16UL << (i % 4);
+    size_t sz = 8 + i;
+    
+    char *p = nullptr;
+    if((i % 2) == 0) {
+      p = reinterpret_cast<char *>(vlp->AllocateAligned(sz, align));
+    } else {
+      p = reinterpret_cast<char *>(vlp->AllocateAligned(sz, align, 0));
+    }
+    
+    assert((reinterpret_cast<uint64_t>(p) & (align - 1)) == 0);
+    
+    memset(p, static_cast<char>(i), sz);
+    p_list.push_back(p);
+  }
+  
+  // Too large for a shared chunk after padding
+  char *large_p = reinterpret_cast<char *>(vlp->AllocateAligned(400, 128));
+  assert((reinterpret_cast<uint64_t>(large_p) & 127) == 0);
+  memset(large_p, 0xff, 400);
+  
+  for(int i = 0;i < 200;i++) {
+    for(int j = 0;j < 8 + i;j++) {
+      assert(p_list[i][j] == static_cast<char>(i));
+    }
+    
+    vlp->Free(p_list[i]);
+  }
+  
+  vlp->Free(large_p);
+  
+  // Deleted objects are destroyed right away
+  AlignedCounter *counter_p = vlp->New<AlignedCounter>(1);
+  assert((reinterpret_cast<uint64_t>(counter_p) & 63) == 0);
+  assert(counter_p->value == 1);
+  assert(AlignedCounter::construct_count == 1);
+  
+  vlp->Delete(counter_p);
+  assert(AlignedCounter::destroy_count == 1);
+  
+  // Retired objects are destroyed after the epoch has passed
+  for(uint64_t i = 0;i < 10;i++) {
+    vlp->Retire(vlp->New<AlignedCounter>(i));
+  }
+  
+  vlp->ReclaimChunks();
+  assert(AlignedCounter::destroy_count == 1);
+  assert(vlp->GetRetiredCount() == 10);
+  
+  em->GotoNextEpoch();
+  em->AnnounceEnter(0);
+  
+  vlp->ReclaimChunks();
+  assert(AlignedCounter::destroy_count == 1 + 10);
+  assert(vlp->GetRetiredCount() == 0);
+  
+  // Objects retired before the pool is destroyed are destroyed with it
+  vlp->Retire(vlp->New<AlignedCounter>(100));
+  
+  delete vlp;
+  
+  assert(AlignedCounter::construct_count == 1 + 10 + 1);
+  assert(AlignedCounter::destroy_count == 1 + 10 + 1);
+  
+  em->SignalExit();
+  delete em;
+  
+  return;
+}
+    
+/*
+ * VarLenPoolRegionTest() - Region allocations are released in bulk either
+ *                          explicitly or by allocating in a later epoch
+ */
+void VarLenPoolRegionTest() {
+  PrintTestName("VarLenPoolRegionTest");
+  
+  VarLenPool::EMType *em = new VarLenPool::EMType{1};
+  VarLenPool *vlp = new VarLenPool{1024, em, 1, nullptr, &single_node_topology};
+  
+  em->AnnounceEnter(0);
+  
+  // 48 bytes each and 20 per chunk, so 5 chunks
+  std::vector<char *> p_list{};
+  for(int i = 0;i < 100;i++) {
+    char *p = reinterpret_cast<char *>(vlp->AllocateRegion(48, 0));
+    memset(p, static_cast<char>(i), 48);
+    
+    p_list.push_back(p);
+  }
+  
+  // A dedicated chunk in the same region
+  char *large_p = reinterpret_cast<char *>(vlp->AllocateRegion(600, 0));
+  memset(large_p, 0xff, 600);
+  
+  assert(vlp->GetChunkCount() == 1 + 5 + 1);
+  
+  for(int i = 0;i < 100;i++) {
+    for(int j = 0;j < 48;j++) {
+      assert(p_list[i][j] == static_cast<char>(i));
+    }
+  }
+  
+  // Nothing is reclaimed before the region is released
+  em->GotoNextEpoch();
+  em->AnnounceEnter(0);
+  assert(vlp->ReclaimChunks() == 0);
+  
+  vlp->ReleaseRegion(0);
+  
+  // The current thread is still in the epoch chunks are released
+  assert(vlp->ReclaimChunks() == 0);
+  
+  em->GotoNextEpoch();
+  em->AnnounceEnter(0);
+  
+  // The most recent retired chunk is the head of the slot list, and the
+  // chunk being bump allocated from is carried into the next region
+  assert(vlp->ReclaimChunks() == 4);
+  assert(vlp->GetChunkCount() == 1 + 1 + 1);
+  
+  // The carried chunk is full, so this takes a new chunk
+  vlp->AllocateRegion(48, 0);
+  assert(vlp->GetChunkCount() == 1 + 1 + 2);
+  
+  // Allocating in a later epoch releases the region of the earlier epoch
+  em->GotoNextEpoch();
+  em->AnnounceEnter(0);
+  vlp->AllocateRegion(48, 0);
+  
+  em->GotoNextEpoch();
+  em->AnnounceEnter(0);
+  assert(vlp->ReclaimChunks() == 1);
+  assert(vlp->GetChunkCount() == 1 + 1 + 1);
+  
+  // The current region is freed by the destructor
+  delete vlp;
+  
+  em->SignalExit();
+  delete em;
+  
+  return;
+}
+    
+/*
+ * VarLenPoolReallocateTest() - The most recent allocation is resized in 
+ *                              place, and others are moved when they grow
+ */
+void VarLenPoolReallocateTest() {
+  PrintTestName("VarLenPoolReallocateTest");
+  
+  VarLenPool::EMType *em = new VarLenPool::EMType{1};
+  VarLenPool *vlp = new VarLenPool{1024, em, 1, nullptr, &single_node_topology};
+  
+  em->AnnounceEnter(0);
+  
+  for(int slot_flag = 0;slot_flag <= 1;slot_flag++) {
+    auto allocate = [vlp, slot_flag](size_t sz) {
+                      if(slot_flag == 1) {
+                        return reinterpret_cast<char *>(vlp->Allocate(sz, 0));
+                      }
+                      
+                      return reinterpret_cast<char *>(vlp->Allocate(sz));
+                    };
+    
+    auto reallocate = [vlp, slot_flag](char *p, size_t old_sz, size_t new_sz) {
+                        void *new_p = nullptr;
+                        if(slot_flag == 1) {
+                          new_p = vlp->Reallocate(p, old_sz, new_sz, 0);
+                        } else {
+                          new_p = vlp->Reallocate(p, old_sz, new_sz);
+                        }
+                        
+                        return reinterpret_cast<char *>(new_p);
+                      };
+    
+    char *p = reallocate(nullptr, 0, 16);
+    memset(p, 1, 16);
+    
+    // Grows in place while it is the most recent allocation
+    assert(reallocate(p, 16, 100) == p);
+    memset(p + 16, 2, 84);
+    assert(reallocate(p, 100, 200) == p);
+    
+    // Another allocation is made after it, so it is moved
+    char *q = allocate(16);
+    char *new_p = reallocate(p, 200, 300);
+    assert(new_p != p);
+    
+    for(int i = 0;i < 100;i++) {
+      assert(new_p[i] == ((i < 16) ? 1 : 2));
+    }
+    
+    // Shrinking never moves, and gives back the tail if it is the most 
+    // recent allocation
+    assert(reallocate(q, 16, 8) == q);
+    
+    char *r = reallocate(allocate(64), 64, 16);
+    assert(allocate(16) == r + 16);
+    
+    // Growing beyond a chunk moves to a dedicated chunk
+    char *large_p = reallocate(new_p, 300, 800);
+    assert(large_p != new_p);
+    assert(large_p[0] == 1);
+    assert(large_p[99] == 2);
+    
+    vlp->Free(large_p);
+    
+    // An aligned block is rounded as Allocate(), so a small allocation
+    // right after it is not taken as its tail
+    char *aligned_p = nullptr;
+    if(slot_flag == 1) {
+      aligned_p = reinterpret_cast<char *>(vlp->AllocateAligned(72, 16, 0));
+    } else {
+      aligned_p = reinterpret_cast<char *>(vlp->AllocateAligned(72, 16));
+    }
+    
+    memset(aligned_p, 3, 72);
+    char *small_p = allocate(24);
+    memset(small_p, 4, 24);
+    
+    new_p = reallocate(aligned_p, 72, 200);
+    assert(new_p != aligned_p);
+    
+    for(int i = 0;i < 72;i++) {
+      assert(new_p[i] == 3);
+    }
+    
+    for(int i = 0;i < 24;i++) {
+      assert(small_p[i] == 4);
+    }
+    
+    // The most recent aligned block still grows in place
+    if(slot_flag == 1) {
+      aligned_p = reinterpret_cast<char *>(vlp->AllocateAligned(72, 16, 0));
+    } else {
+      aligned_p = reinterpret_cast<char *>(vlp->AllocateAligned(72, 16));
+    }
+    
+    assert(reallocate(aligned_p, 72, 120) == aligned_p);
+  }
+  
+  delete vlp;
+  
+  em->SignalExit();
+  delete em;
+  
+  return;
+}
+
+/*
+ * VarLenPoolStatsTest() - Counters of all allocation paths, and the state
+ *                         of chunks found by scanning
+ */
+void VarLenPoolStatsTest() {
+  PrintTestName("VarLenPoolStatsTest");
+  
+  VarLenPool::EMType *em = new VarLenPool::EMType{1};
+  VarLenPool *vlp = new VarLenPool{1024, 
+                                   em, 
+                                   1, 
+                                   nullptr, 
+                                   &single_node_topology, 
+                                   true};
+  
+  em->AnnounceEnter(0);
+  
+  // 24 byte class from the shared list
+  std::vector<void *> shared_list{};
+  for(int i = 0;i < 10;i++) {
+    shared_list.push_back(vlp->Allocate(20));
+  }
+  
+  // 128 byte class from the slot
+  std::vector<void *> slot_list{};
+  for(int i = 0;i < 5;i++) {
+    slot_list.push_back(vlp->Allocate(100, 0));
+  }
+  
+  // Regions round to 8 bytes only
+  for(int i = 0;i < 3;i++) {
+    vlp->AllocateRegion(40, 0);
+  }
+  
+  void *large_p = vlp->Allocate(600);
+  
+  VarLenPool::Stats stats = vlp->GetStats();
+  assert(stats.alloc_count == 10 + 5 + 3 + 1);
+  assert(stats.free_count == 0);
+  assert(stats.live_count == 19);
+  assert(stats.requested_bytes == 10 * 20 + 5 * 100 + 3 * 40 + 600);
+  assert(stats.allocated_bytes == 10 * 24 + 5 * 128 + 3 * 40 + 600);
+  assert(stats.class_count[1] == 10);
+  assert(stats.class_count[3] == 3);
+  assert(stats.class_count[6] == 5);
+  assert(stats.class_count[VarLenPool::CLASS_NUM] == 1);
+  
+  // The shared tail, the owned chunk, the region chunk and the large chunk
+  assert(stats.chunk_count == 4);
+  assert(stats.reserved_bytes > 3 * 1024 + 600);
+  assert(stats.reserved_bytes < 4 * 1024 + 600);
+  
+  for(int i = 0;i < 4;i++) {
+    vlp->Free(shared_list[i]);
+  }
+  
+  for(int i = 0;i < 2;i++) {
+    vlp->Free(slot_list[i], 100, 0);
+  }
+  
+  vlp->ReleaseRegion(0);
+  
+  stats = vlp->GetStats();
+  assert(stats.free_count == 4 + 2 + 3);
+  assert(stats.live_count == 19 - 9);
+  
+  // Chunks of the current region are not scanned, and owned chunks have
+  // no exact count before sealing
+  VarLenPool::ChunkStats chunk_stats = vlp->ScanChunks();
+  assert(chunk_stats.active_chunk_count == 2);
+  assert(chunk_stats.large_chunk_count == 1);
+  assert(chunk_stats.sealed_chunk_count == 0);
+  assert(chunk_stats.live_count == 6 + 1);
+  assert(chunk_stats.tail_used_bytes == 10 * 24);
+  
+  // 11 of these fill the tail, which is sealed with 17 live allocations,
+  // and the next two chunks are sealed with 15 each
+  for(int i = 0;i < 45;i++) {
+    shared_list.push_back(vlp->Allocate(64));
+  }
+  
+  chunk_stats = vlp->ScanChunks();
+  assert(chunk_stats.sealed_chunk_count == 3);
+  assert(chunk_stats.ref_count_histogram[3] == 2);
+  assert(chunk_stats.ref_count_histogram[4] == 1);
+  
+  for(size_t i = 4;i < shared_list.size();i++) {
+    vlp->Free(shared_list[i]);
+  }
+  
+  chunk_stats = vlp->ScanChunks();
+  assert(chunk_stats.sealed_chunk_count == 0);
+  assert(chunk_stats.retired_chunk_count == 3);
+  
+  vlp->Free(large_p);
+  for(int i = 2;i < 5;i++) {
+    vlp->Free(slot_list[i], 100, 0);
+  }
+  
+  stats = vlp->GetStats();
+  assert(stats.live_count == 0);
+  
+  delete vlp;
+  
+  // Without stats only chunks are counted
+  vlp = new VarLenPool{1024, em, 1, nullptr, &single_node_topology};
+  
+  void *shared_p = vlp->Allocate(20);
+  void *slot_p = vlp->Allocate(100, 0);
+  
+  stats = vlp->GetStats();
+  assert(stats.alloc_count == 0);
+  assert(stats.requested_bytes == 0);
+  assert(stats.chunk_count == 2);
+  
+  vlp->Free(shared_p);
+  vlp->Free(slot_p, 100, 0);
+  
+  stats = vlp->GetStats();
+  assert(stats.free_count == 0);
+  
+  delete vlp;
+  
+  em->SignalExit();
+  delete em;
+  
+  return;
+}
+
 int main() {
   VarLenPoolBasicTest();
   VarLenPoolThreadTest(10, 100);
+  VarLenPoolReclaimTest();
+  VarLenPoolReclaimThreadTest(8, 200000, 64);
+  VarLenPoolThreadSlotTest();
+  VarLenPoolThreadSlotFreeTest(8, 200000, false);
+  VarLenPoolSizeClassTest();
+  VarLenPoolFreeContentTest();
+  VarLenPoolLargeTest();
+  VarLenPoolChunkCacheTest();
+  VarLenPoolNumaTest(0);
+  VarLenPoolNumaTest(1);
+  NumaTopologySparseTest();
+  VarLenPoolAlignedTest();
+  VarLenPoolRegionTest();
+  VarLenPoolReallocateTest();
+  VarLenPoolStatsTest();
+  
+  ChunkProviderTest(MmapChunkProvider::HugePageMode::NONE);
+  ChunkProviderTest(MmapChunkProvider::HugePageMode::MADVISE);
+  ChunkProviderTest(MmapChunkProvider::HugePageMode::HUGETLB);
+  VarLenPoolProviderTest(MmapChunkProvider::HugePageMode::NONE, 4, 100000);
+  VarLenPoolProviderTest(MmapChunkProvider::HugePageMode::HUGETLB, 4, 100000);
+  VarLenPoolThreadSlotFreeTest(8, 200000, true);
   
   return 0;
 }
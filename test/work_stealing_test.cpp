@@ -0,0 +1,148 @@
+/*
+ * work_stealing_test.cpp - Tests Chase-Lev deque together with LocalWriteEM
+ *
+ * This file should be compiled with debugging flags turned on, and also
+ * without optimization
+ */
+
+#include "../src/WorkStealingDeque.h"
+#include "../src/LocalWriteEM.h"
+#include "test_suite.h"
+
+using namespace peloton;
+using namespace index;
+
+// Number of counters in the EM for single threaded tests
+static const uint64_t CoreNum = 8;
+
+using DequeType = WorkStealingDeque<uint64_t, LocalWriteEM>;
+using EM = typename DequeType::EMType;
+
+/*
+ * DequeBasicTest() - Owner only push and pop, which behaves like a stack
+ *
+ * The initial capacity is small such that the buffer grows several times
+ */
+void DequeBasicTest(uint64_t op_num) {
+  PrintTestName("DequeBasicTest");
+
+  EM *em = new EM{CoreNum};
+  DequeType *dq = new DequeType{em, 2};
+
+  for(uint64_t i = 0;i < op_num;i++) {
+    dq->Push(i);
+  }
+
+  dbg_printf("Size = %ld; Capacity = %ld\n",
+             dq->GetSize(),
+             dq->GetCapacity());
+  assert(dq->GetSize() == static_cast<int64_t>(op_num));
+
+  // Steal from the top and pop from the bottom alternatively
+  for(uint64_t i = 0;i < op_num / 2;i++) {
+    uint64_t value;
+    bool ret = dq->Steal(value);
+    assert(ret == true);
+    assert(value == i);
+
+    ret = dq->Pop(value);
+    assert(ret == true);
+    assert(value == op_num - 1 - i);
+    (void)ret;
+  }
+
+  uint64_t value;
+  assert(dq->Pop(value) == false);
+  assert(dq->Steal(value) == false);
+  (void)value;
+
+  delete dq;
+
+  // Since there is no GC thread
+  em->SignalExit();
+  delete em;
+
+  return;
+}
+
+/*
+ * DequeStealTest() - The owner pushes and pops while other threads keep
+ *                    stealing, with GC thread running
+ *
+ * Every element must be taken exactly once, either by the owner or by
+ * a thief
+ */
+void DequeStealTest(uint64_t thread_num, uint64_t op_num) {
+  PrintTestName("DequeStealTest");
+
+  EM *em = new EM{thread_num};
+  em->SetGCInterval(5);
+  em->StartGCThread();
+
+  DequeType *dq = new DequeType{em, 2};
+
+  // Number of times each element has been taken
+  std::vector<std::atomic<uint64_t>> taken_list(op_num);
+  for(uint64_t i = 0;i < op_num;i++) {
+    taken_list[i].store(0);
+  }
+
+  std::atomic<uint64_t> taken_count;
+  taken_count.store(0);
+
+  auto func = [dq, em, op_num, &taken_list, &taken_count](uint64_t id) {
+                uint64_t value;
+
+                if(id == 0) {
+                  // Push two and pop one such that the deque keeps growing
+                  for(uint64_t i = 0;i < op_num;i++) {
+                    dq->Push(i);
+
+                    if(((i % 2) == 1) && (dq->Pop(value) == true)) {
+                      taken_list[value].fetch_add(1);
+                      taken_count.fetch_add(1);
+                    }
+                  }
+
+                  while(dq->Pop(value) == true) {
+                    taken_list[value].fetch_add(1);
+                    taken_count.fetch_add(1);
+                  }
+
+                  return;
+                }
+
+                while(taken_count.load() < op_num) {
+                  em->AnnounceEnter(id);
+
+                  if(dq->Steal(value) == true) {
+                    taken_list[value].fetch_add(1);
+                    taken_count.fetch_add(1);
+                  }
+                }
+              };
+
+  StartThreads(thread_num, func);
+
+  for(uint64_t i = 0;i < op_num;i++) {
+    assert(taken_list[i].load() == 1);
+  }
+
+  dbg_printf("Taken = %lu; Capacity = %ld\n",
+             taken_count.load(),
+             dq->GetCapacity());
+
+  delete dq;
+  delete em;
+
+  return;
+}
+
+int main() {
+  DequeBasicTest(10000);
+
+  DequeStealTest(4, 1000000);
+  DequeStealTest(16, 100000);
+
+  return 0;
+}